@@ -27,7 +27,7 @@ using FileMap = FileDirectory::FileMap;
 //**********************************************************************
 
 DuneFembFinder::DuneFembFinder(string a_topdir)
-: m_topdir(gSystem->ExpandPathName(a_topdir.c_str())) {
+: m_topdir(gSystem->ExpandPathName((a_topdir.size() ? a_topdir : defaultTopdir()).c_str())) {
   const string myname = "DuneFembFinder::ctor: ";
   string ifname = topdir() + "/" + "fembjson.dat";
   ifstream fin(ifname);
@@ -118,6 +118,14 @@ DuneFembFinder::DuneFembFinder(string a_topdir)
 
 //**********************************************************************
 
+string DuneFembFinder::defaultTopdir() {
+  const char* pch = gSystem->Getenv("DUNEFEMB_DATA");
+  if ( pch != nullptr && *pch != '\0' ) return pch;
+  return "~/data/dune/femb";
+}
+
+//**********************************************************************
+
 RdrPtr DuneFembFinder::find(string dir, string fpat) {
   const string myname = "DuneFembFinder::find: ";
   string dsdir = topdir() + "/" + dir;
@@ -140,16 +148,15 @@ RdrPtr DuneFembFinder::find(string dir, string fpat) {
 
 //**********************************************************************
 
-RdrPtr DuneFembFinder::
-find(string ts, Index gain, Index shap, bool a_extPulse, bool a_extClock) {
-  const string myname = "DuneFembFinder::find: ";
+NameVector DuneFembFinder::timestampDirs(string ts) const {
+  const string myname = "DuneFembFinder::timestampDirs: ";
+  NameVector tsdirs;
   FileDirectory ftopdir(m_topdir);
   int ndir = ftopdir.select("wib");
   if ( ndir == 0 ) {
     cout << myname << "No wib directories found at " << m_topdir << endl;
-    return nullptr;
+    return tsdirs;
   }
-  vector<string> tsdirs;
   for ( auto& ent : ftopdir.files ) {
     string path = m_topdir + "/" + ent.first;
     FileDirectory fdir(path);
@@ -158,6 +165,15 @@ find(string ts, Index gain, Index shap, bool a_extPulse, bool a_extClock) {
       tsdirs.push_back(fdir.dirname + "/" + tsent.first);
     }
   }
+  return tsdirs;
+}
+
+//**********************************************************************
+
+RdrPtr DuneFembFinder::
+find(string ts, Index gain, Index shap, bool a_extPulse, bool a_extClock) {
+  const string myname = "DuneFembFinder::find: ";
+  NameVector tsdirs = timestampDirs(ts);
   if ( tsdirs.size() == 0 ) {
     cout << myname << "No match found for timestamp " << ts << endl;
     return nullptr;
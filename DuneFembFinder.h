@@ -27,7 +27,11 @@ public:
   using RdrPtr = std::unique_ptr<DuneFembReader>;
 
   // Ctor from topdir (where data is stored).
-  explicit DuneFembFinder(std::string a_topdir ="~/data/dune/femb");
+  // If blank, defaultTopdir() is used.
+  explicit DuneFembFinder(std::string a_topdir ="");
+
+  // Default topdir: $DUNEFEMB_DATA if set, otherwise ~/data/dune/femb.
+  static std::string defaultTopdir();
 
   // Find a sample specified by directory and file pattern in topdir.
   RdrPtr find(std::string dir, std::string fpat ="");
@@ -41,8 +45,12 @@ public:
   RdrPtr find(Index fembId, bool isCold, std::string ts,
               Index gain, Index shap, bool extPulse, bool extClock);
 
+  // Return the directories topdir/wib*/TS* matching a timestamp.
+  NameVector timestampDirs(std::string ts) const;
+
   // Getters.
   string topdir() const { return m_topdir; }
+  const FembMap& fembMap(bool isCold) const { return isCold ? m_coldFembMap : m_warmFembMap; }
 
 private:
 
@@ -1,6 +1,7 @@
 // DuneFembReader.cxx
 
 #include "DuneFembReader.h"
+#include "FembTraceRecorder.h"
 #include "dune/DuneInterface/AdcChannelData.h"
 #include "TFile.h"
 #include "TTree.h"
@@ -18,32 +19,13 @@ namespace {
 //**********************************************************************
 
 DuneFembReader::DuneFembReader(string fname, int a_run, int a_subrun, string a_label)
-: m_pfile(nullptr), m_ptree(nullptr),
+: m_fileName(fname), m_pfile(nullptr), m_ptree(nullptr),
   m_run(a_run), m_subrun(a_subrun), m_label(a_label),
   m_entry(badEntry()),
   m_event(badIndex()), m_chan(badIndex()), m_pwf(nullptr),
-  m_nChan(0) {
+  m_nChan(0), m_nReadError(0), m_nEntryIndexed(0), m_ptrace(nullptr) {
   const string myname = "DuneFembReader::ctor: ";
   clearMetadata();
-  m_pfile = TFile::Open(fname.c_str(), "READ");
-  if ( m_pfile == nullptr || ! m_pfile->IsOpen() ) {
-    cout << myname << "Unable to open file " << fname << endl;
-    if ( m_pfile != nullptr ) {
-      delete m_pfile;
-      m_pfile = nullptr;
-    }
-    return;
-  }
-  string tname = "femb_wfdata";
-  m_ptree = dynamic_cast<TTree*>(m_pfile->Get(tname.c_str()));
-  if ( m_ptree == nullptr ) {
-    cout << myname << "Tree " << tname << " not found in file " << fname << endl;
-    return;
-  }
-  m_ptree->SetBranchAddress("subrun", &m_event);
-  m_ptree->SetBranchAddress("chan",   &m_chan);
-  m_ptree->SetBranchAddress("wf",     &m_pwf);
-  m_pwf = nullptr;
   if ( m_label.size() == 0 ) {
     string::size_type jpos = fname.rfind("/");
     if ( jpos != string::npos && jpos != 0 ) {
@@ -58,28 +40,96 @@ DuneFembReader::DuneFembReader(string fname, int a_run, int a_subrun, string a_l
     }
   }
   if ( m_label.size() == 0 ) m_label = fname;
+  if ( openFile() ) return;
   cout << myname << "Fetching channel counts." << endl;
-  for ( SIndex ient=0; ient<m_ptree->GetEntries(); ++ient ) {
-    read(ient);
-    SIndex ievt = event();
-    SIndex nevt = ievt + 1;
-    SIndex ncha = channel() + 1;
-    if ( nevt > m_nChanPerEvent.size() ) m_nChanPerEvent.resize(nevt, 0);
-    if ( m_nChanPerEvent[ievt] <= ncha ) m_nChanPerEvent[ievt] = ncha;
-    if ( ncha >  m_nChan ) m_nChan = ncha;
-  }
+  indexEntries();
   cout << myname << "Done fetching channel counts." << endl;
 }
 
 //**********************************************************************
 
 DuneFembReader::~DuneFembReader() {
+  if ( m_pfile == nullptr ) return;
   m_pfile->Close();
   delete m_pfile;
 }
 
 //**********************************************************************
 
+Entry DuneFembReader::refresh(bool reopen) {
+  const string myname = "DuneFembReader::refresh: ";
+  if ( reopen && m_pfile != nullptr ) {
+    m_pfile->Close();
+    delete m_pfile;
+    m_pfile = nullptr;
+    m_ptree = nullptr;
+  }
+  if ( m_ptree == nullptr ) {
+    if ( m_pfile != nullptr ) {
+      delete m_pfile;
+      m_pfile = nullptr;
+    }
+    if ( openFile() ) return -1;
+  } else {
+    // Reread the tree header written by the other process.
+    m_ptree->Refresh();
+  }
+  // The entry counts are unchanged if the writer has not saved the tree.
+  if ( m_ptree->GetEntries() < m_nEntryIndexed ) {
+    cout << myname << "WARNING: Tree has fewer entries than were indexed." << endl;
+    return 0;
+  }
+  m_entry = badEntry();
+  return indexEntries();
+}
+
+//**********************************************************************
+
+int DuneFembReader::openFile() {
+  const string myname = "DuneFembReader::openFile: ";
+  m_pfile = TFile::Open(m_fileName.c_str(), "READ");
+  if ( m_pfile == nullptr || ! m_pfile->IsOpen() ) {
+    cout << myname << "Unable to open file " << m_fileName << endl;
+    if ( m_pfile != nullptr ) {
+      delete m_pfile;
+      m_pfile = nullptr;
+    }
+    return 1;
+  }
+  string tname = "femb_wfdata";
+  m_ptree = dynamic_cast<TTree*>(m_pfile->Get(tname.c_str()));
+  if ( m_ptree == nullptr ) {
+    cout << myname << "Tree " << tname << " not found in file " << m_fileName << endl;
+    return 2;
+  }
+  m_ptree->SetBranchAddress("subrun", &m_event);
+  m_ptree->SetBranchAddress("chan",   &m_chan);
+  m_ptree->SetBranchAddress("wf",     &m_pwf);
+  m_pwf = nullptr;
+  return 0;
+}
+
+//**********************************************************************
+
+Entry DuneFembReader::indexEntries() {
+  if ( tree() == nullptr ) return 0;
+  Entry nent = tree()->GetEntries();
+  Entry ent0 = m_nEntryIndexed;
+  for ( Entry ient=ent0; ient<nent; ++ient ) {
+    read(ient);
+    SIndex ievt = event();
+    SIndex nevt = ievt + 1;
+    SIndex ncha = channel() + 1;
+    if ( nevt > m_nChanPerEvent.size() ) m_nChanPerEvent.resize(nevt, 0);
+    if ( m_nChanPerEvent[ievt] <= ncha ) m_nChanPerEvent[ievt] = ncha;
+    if ( ncha >  m_nChan ) m_nChan = ncha;
+  }
+  if ( nent > ent0 ) m_nEntryIndexed = nent;
+  return nent > ent0 ? nent - ent0 : 0;
+}
+
+//**********************************************************************
+
 int DuneFembReader::read(Entry ient) {
   if ( tree() == nullptr ) return 1;
   if ( ient == badEntry() ) return 2;
@@ -98,7 +148,11 @@ readWaveform(Entry ient, AdcChannelData* pacd) {
   if ( ient == badEntry() ) return 2;
   m_entry = ient;
   tree()->SetBranchStatus("wf", true);
-  tree()->GetEntry(ient);
+  // A truncated or corrupt file gives a read error or no waveform.
+  if ( tree()->GetEntry(ient) <= 0 || m_pwf == nullptr ) {
+    ++m_nReadError;
+    return 3;
+  }
   if ( pacd != nullptr ) {
     if ( run() > 0 ) pacd->run = run();
     if ( subrun() > 0 ) pacd->subRun = subrun();
@@ -114,7 +168,9 @@ readWaveform(Entry ient, AdcChannelData* pacd) {
 
 Entry DuneFembReader::
 find(SIndex a_event, SIndex a_chan) {
+  if ( tree() == nullptr ) return badEntry();
   Entry nent = tree()->GetEntries();
+  if ( nent <= 0 ) return badEntry();
   Entry ent0 = m_entry==badEntry() ? 0 : (m_entry)%nent;
   Entry ient = ent0;
   bool first = true;
@@ -136,7 +192,13 @@ find(SIndex a_event, SIndex a_chan) {
 
 int DuneFembReader::
 read(SIndex a_event, SIndex a_chan, AdcChannelData* pacd) {
-  Entry ient = find(a_event, a_chan);
+  Entry ient = badEntry();
+  {
+    FembTraceRecorder::Span span(m_ptrace, "readFind", -1, a_chan, a_event);
+    ient = find(a_event, a_chan);
+  }
+  // The waveform is read and decompressed here.
+  FembTraceRecorder::Span span(m_ptrace, "readEntry", -1, a_chan, a_event);
   return readWaveform(ient, pacd);
 }
 
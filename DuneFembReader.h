@@ -9,6 +9,11 @@
 //
 // Note that the field "subrun" in the tree is used to assing the event
 // number here.
+//
+// The reader may follow a file that is still being written (online mode).
+// Each call to refresh picks up the entries appended since the last call
+// and adds them to the event and channel counts. The new entries are
+// those from the previous nEntry() up to the current one.
 
 #ifndef DuneFembReader_H
 #define DuneFembReader_H
@@ -16,6 +21,7 @@
 #include "dune/DuneInterface/AdcTypes.h"
 
 class AdcChannelData;
+class FembTraceRecorder;
 class TFile;
 class TTree;
 
@@ -43,9 +49,23 @@ public:
   // Dtor.
   ~DuneFembReader();
 
+  // Pick up entries appended to the file since it was opened or last
+  // refreshed. If the file or tree is not yet available, opening is tried
+  // again. If reopen is true, the file is closed and opened again instead
+  // of refreshing the tree in place, e.g. if the writer replaced the file.
+  // Returns the number of new entries or -1 if the tree is not available.
+  Entry refresh(bool reopen =false);
+
+  // Return the number of entries in the tree that have been indexed, i.e.
+  // included in the event and channel counts.
+  Entry nEntry() const { return m_nEntryIndexed; }
+
   // Set the label.
   void setLabel(std::string a_label) { m_label = a_label; }
 
+  // Set the recorder for trace spans. Null disables tracing.
+  void setTraceRecorder(FembTraceRecorder* prec) { m_ptrace = prec; }
+
   // Read the event/subrun and channel for one entry (waveform) in the tree.
   int read(Long64_t ient);
 
@@ -69,8 +89,13 @@ public:
   Index channel() const { return m_chan; }
   const Waveform* waveform() const { return m_pwf; }
   
-  // Return the file.
+  // Return the file and its name.
   TFile* file() const { return m_pfile; }
+  std::string fileName() const { return m_fileName; }
+
+  // Return the number of entries that could not be read, e.g. because the
+  // file is truncated or corrupt.
+  Entry readErrorCount() const { return m_nReadError; }
 
   // Return the tree.
   TTree* tree() const { return m_ptree; }
@@ -104,6 +129,13 @@ public:
 
 private:
 
+  // Open the file and tree. Returns 0 for success.
+  int openFile();
+
+  // Add the entries from nEntry() to the end of the tree to the event and
+  // channel counts. Returns the number of entries added.
+  Entry indexEntries();
+
   std::string m_fileName;
   TFile* m_pfile;
   TTree* m_ptree;
@@ -116,6 +148,9 @@ private:
   Waveform* m_pwf;
   Index m_nChan;
   vector<Index> m_nChanPerEvent;
+  Entry m_nReadError;
+  Entry m_nEntryIndexed;
+  FembTraceRecorder* m_ptrace;
 
   // Metadata.
   Index m_gainIndex;
@@ -1,17 +1,20 @@
 // DuneFembReport.cxx
 
 #include "DuneFembReport.h"
+#include "FembPlotRenderer.h"
 
 //**********************************************************************
 
 DuneFembReport::DuneFembReport(Index ifmb, Index igai, Index ishp, string spat)
-: m_ifmb(ifmb), m_igai(igai), m_ishp(ishp), m_spat(spat) { }
+: m_ifmb(ifmb), m_igai(igai), m_ishp(ishp), m_spat(spat),
+  m_combined(false), m_nproc(0), m_force(false) { }
 
 //**********************************************************************
 
 FembTestAnalyzer* DuneFembReport::ftaRaw() {
   if ( ! m_pftaRaw ) {
     m_pftaRaw.reset(new FembTestAnalyzer(10, femb(), gain(), shap()));
+    if ( combined() ) m_pftaRaw->setRetainChannelData(true);
   }
   return m_pftaRaw.get();
 };
@@ -21,6 +24,7 @@ FembTestAnalyzer* DuneFembReport::ftaRaw() {
 FembTestAnalyzer* DuneFembReport::ftaHeightCalib() {
   if ( ! m_pftaHeightCalib ) {
     m_pftaHeightCalib.reset(new FembTestAnalyzer(11, femb(), gain(), shap()));
+    if ( combined() && m_pftaHeightCalib->setRawSource(ftaRaw()) ) m_pftaHeightCalib.reset();
   }
   return m_pftaHeightCalib.get();
 };
@@ -32,14 +36,15 @@ int DuneFembReport::doRawHeightCalibration() {
   if ( pfta == nullptr ) return 1;
   DataMap res = pfta->processAll();
   if ( res.status() ) return 2;
+  pfta->writeCalibFcl();
+  FembPlotRenderer rdr(pfta);
+  rdr.setProcessCount(processCount());
+  rdr.setForce(force());
   // Femb plots.
   vector<string> names = {"pedlim", "gainh", "gaina", "csddh", "csdch"};
   for ( string name : names ) {
-    string fname = "rawf_" + name + ".png";
-    TPadManipulator* pman = pfta->draw(name);
-    pman->print(fname);
+    rdr.addFemb(name, "rawf_" + name + ".png");
   }
-  pfta->writeCalibFcl();
   // ADC plots for all events.
   vector<string> namesAdc = {"ped", "resph", "respresh"};
   for ( string name : namesAdc ) {
@@ -47,9 +52,7 @@ int DuneFembReport::doRawHeightCalibration() {
       ostringstream ssnum;
       ssnum << iadc;
       string sadc = ssnum.str();
-      string fname = "rawa_" + name + "_adc" + sadc + ".png";
-      TPadManipulator* pman = pfta->drawAdc(name, iadc);
-      pman->print(fname);
+      rdr.addAdc(name, iadc, -1, "rawa_" + name + "_adc" + sadc + ".png");
     }
   }
   // ADC plots for event 0.
@@ -60,12 +63,10 @@ int DuneFembReport::doRawHeightCalibration() {
       ostringstream ssnum;
       ssnum << iadc;
       string sadc = ssnum.str();
-      string fname = "rawev0_" + name + "_adc" + sadc + ".png";
-      TPadManipulator* pman = pfta->drawAdc(name, iadc, ievt);
-      pman->print(fname);
+      rdr.addAdc(name, iadc, ievt, "rawev0_" + name + "_adc" + sadc + ".png");
     }
   }
-  return 0;
+  return rdr.render() ? 3 : 0;
 }
 
 //**********************************************************************
@@ -75,13 +76,14 @@ int DuneFembReport::checkRawHeightCalibration() {
   if ( pfta == nullptr ) return 1;
   DataMap res = pfta->processAll();
   if ( res.status() ) return 2;
+  FembPlotRenderer rdr(pfta);
+  rdr.setProcessCount(processCount());
+  rdr.setForce(force());
   vector<string> names = {"gainh", "gaina", "rmsh", "dev"};
   for ( string name : names ) {
-    string fname = "cal_" + name + ".png";
-    TPadManipulator* pman = pfta->draw(name);
-    pman->print(fname);
+    rdr.addFemb(name, "cal_" + name + ".png");
   }
-  return 0;
+  return rdr.render() ? 3 : 0;
 }
 
 //**********************************************************************
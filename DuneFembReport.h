@@ -19,22 +19,41 @@ public:
   // Ctor.
   DuneFembReport(Index ifmb, Index igai, Index ishp, std::string spat);
 
+  // Combined mode. If set, the raw analyzer retains its channel data and the
+  // height calibration analyzer is derived from it in memory, i.e. the
+  // data are read, pedestals fit and ROIs found only once.
+  // Must be set before either analyzer is created.
+  bool setCombined(bool val) { return m_combined = val; }
+
+  // Number of processes used to render the plots (see FembPlotRenderer).
+  // Zero means the hardware concurrency.
+  Index setProcessCount(Index val) { return m_nproc = val; }
+
+  // Render every plot even if its inputs are unchanged since the last render.
+  bool setForce(bool val) { return m_force = val; }
+
   // Getters.
   Index femb() const { return m_ifmb; }
   Index gain() const { return m_igai; }
   Index shap() const { return m_ishp; }
+  bool combined() const { return m_combined; }
+  Index processCount() const { return m_nproc; }
+  bool force() const { return m_force; }
 
   // Analyzer that uses raw to do height calibration.
   FembTestAnalyzer* ftaRaw();
 
   // Analyzer that applies height calibratiion to raw.
   // It does anotehr height calibration an draws rsiduals.
+  // In combined mode, the raw calibration must be done first.
   FembTestAnalyzer* ftaHeightCalib();
 
-  // Do the raw height calibration.
+  // Do the raw height calibration and render its plots.
+  // Returns 3 if any plot could not be rendered.
   int doRawHeightCalibration();
 
-  // Check the height calibration.
+  // Check the height calibration and render its plots.
+  // Returns 3 if any plot could not be rendered.
   int checkRawHeightCalibration();
 
 private:
@@ -45,6 +64,9 @@ private:
   Index m_igai;
   Index m_ishp;
   std::string m_spat;
+  bool m_combined;
+  Index m_nproc;
+  bool m_force;
 
 };
 
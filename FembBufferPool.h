@@ -0,0 +1,76 @@
+// FembBufferPool.h
+//
+// Per-thread pool of reusable objects of type T.
+//
+// acquire() returns a handle to an object from the free list of the calling
+// thread, creating one only if that list is empty. The handle returns the
+// object to the free list of the thread that destroys it. Objects are not
+// reset, so buffers keep their capacity and the user clears what it needs.
+//
+// Example:
+//   FembBufferPool<AdcChannelData>::Handle pacd = FembBufferPool<AdcChannelData>::acquire();
+//   pacd->raw.clear();
+
+#ifndef FembBufferPool_H
+#define FembBufferPool_H
+
+#include <vector>
+#include <memory>
+
+template<typename T>
+class FembBufferPool {
+
+public:
+
+  using Index = unsigned int;
+  using Pointer = std::unique_ptr<T>;
+
+  // Handle to a pooled object.
+  class Handle {
+  public:
+    Handle() { }
+    explicit Handle(Pointer&& pobj) : m_pobj(std::move(pobj)) { }
+    Handle(Handle&& rhs) =default;
+    Handle& operator=(Handle&& rhs) { release(); m_pobj = std::move(rhs.m_pobj); return *this; }
+    ~Handle() { release(); }
+    T& operator*() const { return *m_pobj; }
+    T* operator->() const { return m_pobj.get(); }
+    T* get() const { return m_pobj.get(); }
+    void release() { if ( m_pobj ) freeList().push_back(std::move(m_pobj)); }
+  private:
+    Pointer m_pobj;
+  };
+
+  // Return an object from the pool for this thread.
+  static Handle acquire() {
+    std::vector<Pointer>& objs = freeList();
+    if ( objs.empty() ) {
+      ++createCount();
+      return Handle(Pointer(new T));
+    }
+    Handle hnd(std::move(objs.back()));
+    objs.pop_back();
+    return hnd;
+  }
+
+  // Number of objects created for this thread.
+  static Index allocationCount() { return createCount(); }
+
+  // Number of free objects for this thread.
+  static Index freeCount() { return freeList().size(); }
+
+private:
+
+  static std::vector<Pointer>& freeList() {
+    thread_local std::vector<Pointer> objs;
+    return objs;
+  }
+
+  static Index& createCount() {
+    thread_local Index count = 0;
+    return count;
+  }
+
+};
+
+#endif
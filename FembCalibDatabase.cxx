@@ -0,0 +1,409 @@
+// FembCalibDatabase.cxx
+
+#include "FembCalibDatabase.h"
+#include "FembCheckpoint.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::ofstream;
+using std::ostringstream;
+
+using Index = FembCalibDatabase::Index;
+using Name = FembCalibDatabase::Name;
+using Key = FembCalibDatabase::Key;
+using Header = FembCalibDatabase::Header;
+using TableRecord = FembCalibDatabase::TableRecord;
+
+namespace {
+
+const char* magicString() { return "FEMBCALD"; }
+
+static_assert(sizeof(Header) == 64, "Unexpected FembCalibDatabase header size.");
+static_assert(sizeof(TableRecord) == 48, "Unexpected FembCalibDatabase record size.");
+
+// Append the bytes of an array to a buffer.
+template<typename T>
+void append(string& buf, const T* pval, size_t nval) {
+  if ( nval ) buf.append(reinterpret_cast<const char*>(pval), nval*sizeof(T));
+}
+
+// Create a directory if needed. Returns 0 for success.
+int makeDir(const Name& dir) {
+  if ( mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST ) return 0;
+  return 1;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+uint32_t Key::code() const {
+  if ( femb < 0 || femb > 0xffff ) return badCode();
+  if ( gain < 0 || gain > 0xf ) return badCode();
+  if ( shap < 0 || shap > 0xf ) return badCode();
+  uint32_t val = uint32_t(femb) << 16;
+  val |= uint32_t(gain) << 12;
+  val |= uint32_t(shap) << 8;
+  if ( isCold ) val |= 4;
+  if ( extPulse ) val |= 2;
+  if ( extClock ) val |= 1;
+  return val;
+}
+
+//**********************************************************************
+
+Key Key::fromCode(uint32_t val) {
+  Key key;
+  key.femb = val >> 16;
+  key.gain = (val >> 12) & 0xf;
+  key.shap = (val >> 8) & 0xf;
+  key.isCold = val & 4;
+  key.extPulse = val & 2;
+  key.extClock = val & 1;
+  return key;
+}
+
+//**********************************************************************
+
+Name Key::fclDirName() const {
+  ostringstream ssnam;
+  ssnam << "calibFromFemb_g" << gain << "s" << shap;
+  if ( ! isCold ) ssnam << "_warm";
+  if ( ! extPulse ) ssnam << "_intPulse";
+  if ( ! extClock ) ssnam << "_intClock";
+  return ssnam.str();
+}
+
+//**********************************************************************
+
+Name Key::fclToolName() const {
+  ostringstream ssnam;
+  ssnam << fclDirName() << "_femb" << femb;
+  return ssnam.str();
+}
+
+//**********************************************************************
+
+FembCalibDatabase::FembCalibDatabase()
+: m_pmap(nullptr), m_mapSize(0), m_pheader(nullptr),
+  m_ptables(nullptr), m_pfloats(nullptr), m_pints(nullptr) { }
+
+//**********************************************************************
+
+FembCalibDatabase::FembCalibDatabase(Name fname) : FembCalibDatabase() {
+  open(fname);
+}
+
+//**********************************************************************
+
+FembCalibDatabase::~FembCalibDatabase() {
+  close();
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::add(const Key& key, const FembCalibTable& cal) {
+  const string myname = "FembCalibDatabase::add: ";
+  uint32_t code = key.code();
+  if ( code == badCode() ) {
+    cout << myname << "Invalid key " << key.fclToolName() << endl;
+    return 1;
+  }
+  if ( ! cal.isValid() ) {
+    cout << myname << "Invalid calibration for " << key.fclToolName() << endl;
+    return 2;
+  }
+  if ( cal.units().size() >= sizeof(TableRecord::units) ) {
+    cout << myname << "Units name is too long: " << cal.units() << endl;
+    return 3;
+  }
+  m_added[code] = cal;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::addFile(Name fname) {
+  const string myname = "FembCalibDatabase::addFile: ";
+  FembCalibDatabase src;
+  if ( src.open(fname) ) return 1;
+  for ( Index itab=0; itab<src.size(); ++itab ) {
+    FembCalibTable cal;
+    if ( src.table(itab, cal) || add(src.key(itab), cal) ) {
+      cout << myname << "Unable to add table " << itab << " from " << fname << endl;
+      return 2;
+    }
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::write(Name fname) const {
+  const string myname = "FembCalibDatabase::write: ";
+  std::vector<TableRecord> recs;
+  std::vector<float> floats;
+  std::vector<int32_t> mins;
+  std::vector<int32_t> maxs;
+  for ( const auto& ent : m_added ) {
+    const FembCalibTable& cal = ent.second;
+    TableRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.code = ent.first;
+    rec.femb = cal.femb();
+    strncpy(rec.units, cal.units().c_str(), sizeof(rec.units) - 1);
+    rec.adcMin = cal.adcMin();
+    rec.adcMax = cal.adcMax();
+    rec.nGain = cal.gains().size();
+    rec.gainOffset = floats.size();
+    floats.insert(floats.end(), cal.gains().begin(), cal.gains().end());
+    rec.nAdcMin = cal.adcMins().size();
+    rec.adcMinOffset = mins.size();
+    mins.insert(mins.end(), cal.adcMins().begin(), cal.adcMins().end());
+    rec.nAdcMax = cal.adcMaxs().size();
+    rec.adcMaxOffset = maxs.size();
+    maxs.insert(maxs.end(), cal.adcMaxs().begin(), cal.adcMaxs().end());
+    recs.push_back(rec);
+  }
+  // The maximums follow the minimums in the int array.
+  for ( TableRecord& rec : recs ) rec.adcMaxOffset += mins.size();
+  Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, magicString(), sizeof(hdr.magic));
+  hdr.version = version();
+  hdr.headerSize = sizeof(Header);
+  hdr.nTable = recs.size();
+  hdr.nFloat = floats.size();
+  hdr.nInt = mins.size() + maxs.size();
+  hdr.tableOffset = sizeof(Header);
+  hdr.floatOffset = hdr.tableOffset + recs.size()*sizeof(TableRecord);
+  hdr.intOffset = hdr.floatOffset + floats.size()*sizeof(float);
+  hdr.fileSize = hdr.intOffset + hdr.nInt*sizeof(int32_t);
+  string buf;
+  buf.reserve(hdr.fileSize);
+  append(buf, &hdr, 1);
+  append(buf, recs.data(), recs.size());
+  append(buf, floats.data(), floats.size());
+  append(buf, mins.data(), mins.size());
+  append(buf, maxs.data(), maxs.size());
+  if ( FembCheckpoint::writeAtomic(fname, buf) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
+  cout << myname << "Wrote " << recs.size() << " tables to " << fname << endl;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::open(Name fname) {
+  const string myname = "FembCalibDatabase::open: ";
+  close();
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if ( fd < 0 ) {
+    cout << myname << "Unable to open " << fname << endl;
+    return 1;
+  }
+  struct stat sbuf;
+  if ( fstat(fd, &sbuf) || size_t(sbuf.st_size) < sizeof(Header) ) {
+    cout << myname << "File is too short: " << fname << endl;
+    ::close(fd);
+    return 2;
+  }
+  size_t mapSize = sbuf.st_size;
+  void* pmap = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if ( pmap == MAP_FAILED ) {
+    cout << myname << "Unable to map " << fname << endl;
+    return 3;
+  }
+  const Header* phdr = static_cast<const Header*>(pmap);
+  bool bad = memcmp(phdr->magic, magicString(), sizeof(phdr->magic)) != 0;
+  if ( bad ) {
+    cout << myname << "File is not a calibration database: " << fname << endl;
+  } else if ( phdr->version != version() || phdr->headerSize != sizeof(Header) ) {
+    cout << myname << "Unsupported version " << phdr->version << " in " << fname << endl;
+    bad = true;
+  } else if ( phdr->fileSize != mapSize ||
+              phdr->tableOffset + uint64_t(phdr->nTable)*sizeof(TableRecord) > phdr->floatOffset ||
+              phdr->floatOffset + uint64_t(phdr->nFloat)*sizeof(float) > phdr->intOffset ||
+              phdr->intOffset + uint64_t(phdr->nInt)*sizeof(int32_t) > mapSize ) {
+    cout << myname << "Inconsistent sizes in " << fname << endl;
+    bad = true;
+  }
+  const char* pbase = static_cast<const char*>(pmap);
+  const TableRecord* ptables = bad ? nullptr
+                             : reinterpret_cast<const TableRecord*>(pbase + phdr->tableOffset);
+  for ( Index itab=0; !bad && itab<phdr->nTable; ++itab ) {
+    const TableRecord& rec = ptables[itab];
+    if ( (itab > 0 && rec.code <= ptables[itab-1].code) ||
+         uint64_t(rec.gainOffset) + rec.nGain > phdr->nFloat ||
+         uint64_t(rec.adcMinOffset) + rec.nAdcMin > phdr->nInt ||
+         uint64_t(rec.adcMaxOffset) + rec.nAdcMax > phdr->nInt ) {
+      cout << myname << "Invalid table " << itab << " in " << fname << endl;
+      bad = true;
+    }
+  }
+  if ( bad ) {
+    munmap(pmap, mapSize);
+    return 4;
+  }
+  m_fileName = fname;
+  m_pmap = pmap;
+  m_mapSize = mapSize;
+  m_pheader = phdr;
+  m_ptables = ptables;
+  m_pfloats = reinterpret_cast<const float*>(pbase + phdr->floatOffset);
+  m_pints = reinterpret_cast<const int32_t*>(pbase + phdr->intOffset);
+  return 0;
+}
+
+//**********************************************************************
+
+void FembCalibDatabase::close() {
+  if ( m_pmap != nullptr ) munmap(m_pmap, m_mapSize);
+  m_fileName.clear();
+  m_pmap = nullptr;
+  m_mapSize = 0;
+  m_pheader = nullptr;
+  m_ptables = nullptr;
+  m_pfloats = nullptr;
+  m_pints = nullptr;
+}
+
+//**********************************************************************
+
+Index FembCalibDatabase::size() const {
+  return isOpen() ? m_pheader->nTable : 0;
+}
+
+//**********************************************************************
+
+Key FembCalibDatabase::key(Index itab) const {
+  const TableRecord* prec = record(itab);
+  if ( prec == nullptr ) return Key();
+  return Key::fromCode(prec->code);
+}
+
+//**********************************************************************
+
+Index FembCalibDatabase::find(const Key& key) const {
+  uint32_t code = key.code();
+  if ( code == badCode() || ! isOpen() ) return badIndex();
+  const TableRecord* pbeg = m_ptables;
+  const TableRecord* pend = m_ptables + size();
+  const TableRecord* prec = std::lower_bound(pbeg, pend, code,
+    [](const TableRecord& rec, uint32_t val) { return rec.code < val; });
+  if ( prec == pend || prec->code != code ) return badIndex();
+  return prec - pbeg;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::
+lookup(const Key& key, Index icha, float& gain, int& adcMin, int& adcMax) const {
+  const TableRecord* prec = record(find(key));
+  if ( prec == nullptr ) return 1;
+  if ( icha >= prec->nGain ) return 2;
+  gain = m_pfloats[prec->gainOffset + icha];
+  adcMin = icha < prec->nAdcMin ? m_pints[prec->adcMinOffset + icha] : prec->adcMin;
+  adcMax = icha < prec->nAdcMax ? m_pints[prec->adcMaxOffset + icha] : prec->adcMax;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::table(const Key& key, FembCalibTable& cal) const {
+  return table(find(key), cal);
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::table(Index itab, FembCalibTable& cal) const {
+  const TableRecord* prec = record(itab);
+  if ( prec == nullptr ) return 1;
+  const float* pgain = m_pfloats + prec->gainOffset;
+  const int32_t* pmin = m_pints + prec->adcMinOffset;
+  const int32_t* pmax = m_pints + prec->adcMaxOffset;
+  cal = FembCalibTable();
+  cal.setFemb(prec->femb);
+  cal.setUnits(string(prec->units, strnlen(prec->units, sizeof(prec->units))));
+  cal.setAdcRange(prec->adcMin, prec->adcMax);
+  cal.setGains(FembCalibTable::FloatVector(pgain, pgain + prec->nGain));
+  cal.setAdcMins(FembCalibTable::IntVector(pmin, pmin + prec->nAdcMin));
+  cal.setAdcMaxs(FembCalibTable::IntVector(pmax, pmax + prec->nAdcMax));
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCalibDatabase::writeFcl(const Key& key, Name topdir) const {
+  const string myname = "FembCalibDatabase::writeFcl: ";
+  FembCalibTable cal;
+  if ( table(key, cal) ) {
+    cout << myname << "Table not found: " << key.fclToolName() << endl;
+    return 1;
+  }
+  Name dirName = topdir + "/" + key.fclDirName();
+  if ( makeDir(topdir) || makeDir(dirName) ) {
+    cout << myname << "Unable to create directory " << dirName << endl;
+    return 2;
+  }
+  Name fclName = dirName + "/" + key.fclToolName() + ".fcl";
+  ofstream fout(fclName.c_str());
+  fout << cal.fclText(key.fclToolName());
+  if ( ! fout ) {
+    cout << myname << "Unable to write " << fclName << endl;
+    return 3;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+Index FembCalibDatabase::writeAllFcl(Name topdir) const {
+  Index nfail = 0;
+  for ( Index itab=0; itab<size(); ++itab ) {
+    if ( writeFcl(key(itab), topdir) ) ++nfail;
+  }
+  return nfail;
+}
+
+//**********************************************************************
+
+void FembCalibDatabase::print() const {
+  cout << "FEMB calibration database";
+  if ( ! isOpen() ) {
+    cout << " is not open." << endl;
+    return;
+  }
+  cout << " " << m_fileName << " version " << m_pheader->version
+       << " with " << size() << " tables." << endl;
+  for ( Index itab=0; itab<size(); ++itab ) {
+    const TableRecord* prec = record(itab);
+    cout << setw(6) << itab << "  " << key(itab).fclToolName()
+         << " " << prec->nGain << " channels" << endl;
+  }
+}
+
+//**********************************************************************
+
+const TableRecord* FembCalibDatabase::record(Index itab) const {
+  if ( itab >= size() ) return nullptr;
+  return m_ptables + itab;
+}
+
+//**********************************************************************
@@ -0,0 +1,185 @@
+// FembCalibDatabase.h
+//
+// Binary database of FEMB linear calibrations, i.e. FembCalibTable for
+// many FEMBs and configurations in one file.
+//
+// Tables are indexed by the key (FEMB, gain, shaping, temperature, pulse,
+// clock) and the channel calibration by table and channel. The file is
+// memory mapped so opening is cheap and a lookup is a binary search over
+// the table keys.
+//
+// File layout (version 1, native byte order, 4-byte aligned):
+//   Header        magic "FEMBCALD", version, counts and section offsets
+//   TableRecord[] sorted by key code
+//   float[]       gains for all tables
+//   int32[]       AdcMins and then AdcMaxs for all tables
+// Readers reject files with another magic, version or header size.
+//
+// A database is built with add (or addFile to start from an existing
+// file) and written with write. Lookups use the file opened with open.
+// Both may be used on one object.
+//
+// writeFcl exports tables in the format of FembTestAnalyzer::writeCalibFcl
+// for jobs that still read the FCL files.
+
+#ifndef FembCalibDatabase_H
+#define FembCalibDatabase_H
+
+#include "FembCalibTable.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+class FembCalibDatabase {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+
+  // Table key.
+  struct Key {
+    int femb = 0;
+    int gain = 0;
+    int shap = 0;
+    bool isCold = true;
+    bool extPulse = true;
+    bool extClock = true;
+    // Packed code: femb (16 bits), gain and shaping (4 bits each) and flags.
+    // Returns badCode() if a field is out of range.
+    uint32_t code() const;
+    static Key fromCode(uint32_t code);
+    // FCL directory and tool names used by FembTestAnalyzer::writeCalibFcl, e.g.
+    // calibFromFemb_g2s3_warm and calibFromFemb_g2s3_warm_femb12.
+    Name fclDirName() const;
+    Name fclToolName() const;
+  };
+
+  // File format version.
+  static uint32_t version() { return 1; }
+
+  // Code returned for an invalid key.
+  static uint32_t badCode() { return uint32_t(-1); }
+
+  // Index returned for a missing table.
+  static Index badIndex() { return Index(-1); }
+
+  // Default ctor.
+  FembCalibDatabase();
+
+  // Ctor opening a file.
+  explicit FembCalibDatabase(Name fname);
+
+  // Dtor.
+  ~FembCalibDatabase();
+
+  // Delete copy and assignment.
+  FembCalibDatabase(const FembCalibDatabase&) =delete;
+  FembCalibDatabase& operator=(const FembCalibDatabase&) =delete;
+
+  // Add a table to the build list, replacing any with the same key.
+  // Returns 0 for success.
+  int add(const Key& key, const FembCalibTable& cal);
+
+  // Add all tables from a database file. Returns 0 for success.
+  int addFile(Name fname);
+
+  // Write the build list to a file. The file is replaced atomically.
+  // Returns 0 for success.
+  int write(Name fname) const;
+
+  // Number of tables in the build list.
+  Index addedSize() const { return m_added.size(); }
+
+  // Clear the build list.
+  void clearAdded() { m_added.clear(); }
+
+  // Open (map) a database file. Returns 0 for success.
+  int open(Name fname);
+
+  // Unmap the file.
+  void close();
+
+  // Return if a file is open.
+  bool isOpen() const { return m_pheader != nullptr; }
+
+  // Name of the open file.
+  Name fileName() const { return m_fileName; }
+
+  // Number of tables in the open file.
+  Index size() const;
+
+  // Key for a table.
+  Key key(Index itab) const;
+
+  // Return the index of the table for a key or badIndex().
+  Index find(const Key& key) const;
+
+  // Return the calibration for a channel. Per-channel AdcMin and AdcMax
+  // fall back to the table values as in FembCalibTable.
+  // Returns 0 for success.
+  int lookup(const Key& key, Index icha, float& gain, int& adcMin, int& adcMax) const;
+
+  // Fill the calibration table for a key or table index. Returns 0 for success.
+  int table(const Key& key, FembCalibTable& cal) const;
+  int table(Index itab, FembCalibTable& cal) const;
+
+  // Write the FCL for a table to TOPDIR/DIRNAME/TOOLNAME.fcl.
+  // Returns 0 for success.
+  int writeFcl(const Key& key, Name topdir =".") const;
+
+  // Write the FCL for all tables. Returns the number of failures.
+  Index writeAllFcl(Name topdir =".") const;
+
+  // Display the tables.
+  void print() const;
+
+public:
+
+  // File header.
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t nTable;
+    uint32_t nFloat;
+    uint32_t nInt;
+    uint32_t reserved;
+    uint64_t tableOffset;
+    uint64_t floatOffset;
+    uint64_t intOffset;
+    uint64_t fileSize;
+  };
+
+  // Record for one table. Offsets are indices into the float or int array.
+  struct TableRecord {
+    uint32_t code;
+    uint32_t femb;
+    char units[8];
+    int32_t adcMin;
+    int32_t adcMax;
+    uint32_t nGain;
+    uint32_t gainOffset;
+    uint32_t nAdcMin;
+    uint32_t adcMinOffset;
+    uint32_t nAdcMax;
+    uint32_t adcMaxOffset;
+  };
+
+private:
+
+  const TableRecord* record(Index itab) const;
+
+  std::map<uint32_t, FembCalibTable> m_added;
+  Name m_fileName;
+  void* m_pmap;
+  size_t m_mapSize;
+  const Header* m_pheader;
+  const TableRecord* m_ptables;
+  const float* m_pfloats;
+  const int32_t* m_pints;
+
+};
+
+#endif
@@ -0,0 +1,109 @@
+// FembCalibTable.cxx
+
+#include "FembCalibTable.h"
+#include "fhiclcpp/ParameterSet.h"
+#include "fhiclcpp/make_ParameterSet.h"
+#include "cetlib/filepath_maker.h"
+#include <iostream>
+#include <sstream>
+#include <exception>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::ostringstream;
+
+namespace {
+
+// Write a list with ten values per line.
+template<typename T>
+void writeList(ostringstream& ssout, const std::vector<T>& vals) {
+  ssout << "[";
+  for ( unsigned int ival=0; ival<vals.size(); ++ival ) {
+    if ( ival ) ssout << ",";
+    if ( 10*(ival/10) == ival ) ssout << "\n    ";
+    else ssout << " ";
+    ssout << vals[ival];
+  }
+  if ( vals.size() ) ssout << "\n  ";
+  ssout << "]\n";
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembCalibTable::FembCalibTable()
+: m_femb(0), m_units("ke"), m_adcMin(0), m_adcMax(4095) { }
+
+//**********************************************************************
+
+int FembCalibTable::readFcl(string fname, string toolName) {
+  const string myname = "FembCalibTable::readFcl: ";
+  fhicl::ParameterSet psTop;
+  try {
+    cet::filepath_lookup policy("FHICL_FILE_PATH");
+    fhicl::make_ParameterSet(fname, policy, psTop);
+  } catch ( std::exception& exc ) {
+    cout << myname << "Unable to read " << fname << ": " << exc.what() << endl;
+    return 1;
+  }
+  fhicl::ParameterSet psTools;
+  if ( ! psTop.get_if_present<fhicl::ParameterSet>("tools", psTools) ) {
+    cout << myname << "No tools found in " << fname << endl;
+    return 2;
+  }
+  if ( toolName.size() == 0 ) {
+    std::vector<string> names = psTools.get_pset_names();
+    if ( names.size() == 0 ) {
+      cout << myname << "No tools found in " << fname << endl;
+      return 2;
+    }
+    toolName = names[0];
+  }
+  fhicl::ParameterSet ps;
+  if ( ! psTools.get_if_present<fhicl::ParameterSet>(toolName, ps) ) {
+    cout << myname << "Tool " << toolName << " not found in " << fname << endl;
+    return 3;
+  }
+  string toolType = ps.get<string>("tool_type", "");
+  if ( toolType != "FembLinearCalibration" ) {
+    cout << myname << "Tool " << toolName << " has unexpected type " << toolType << endl;
+    return 4;
+  }
+  m_femb    = ps.get<Index>("FembID", 0);
+  m_units   = ps.get<string>("Units", "");
+  m_gains   = ps.get<FloatVector>("Gains", FloatVector());
+  m_adcMin  = ps.get<int>("AdcMin", 0);
+  m_adcMax  = ps.get<int>("AdcMax", 4095);
+  m_adcMins = ps.get<IntVector>("AdcMins", IntVector());
+  m_adcMaxs = ps.get<IntVector>("AdcMaxs", IntVector());
+  if ( m_gains.size() == 0 ) {
+    cout << myname << "Tool " << toolName << " has no gains." << endl;
+    return 5;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+string FembCalibTable::fclText(string toolName) const {
+  ostringstream ssout;
+  ssout << "tools." << toolName << ": {\n";
+  ssout << "  tool_type: FembLinearCalibration\n";
+  ssout << "  LogLevel: 0\n";
+  ssout << "  Units: " << m_units << "\n";
+  ssout << "  FembID: " << m_femb << "\n";
+  ssout << "  Gains: ";
+  writeList(ssout, m_gains);
+  ssout << "  AdcMin: " << m_adcMin << "\n";
+  ssout << "  AdcMins: ";
+  writeList(ssout, m_adcMins);
+  ssout << "  AdcMax: " << m_adcMax << "\n";
+  ssout << "  AdcMaxs: ";
+  writeList(ssout, m_adcMaxs);
+  ssout << "}\n";
+  return ssout.str();
+}
+
+//**********************************************************************
@@ -0,0 +1,74 @@
+// FembCalibTable.h
+//
+// Linear calibration for the channels of one FEMB, i.e. the content of a
+// FembLinearCalibration tool configuration such as those written by
+// FembTestAnalyzer::writeCalibFcl:
+//
+//     gain - Calibrated signal per ADC count, e.g. [ke/ADC]
+//   adcMin - Raw ADC values at or below this are flagged as underflow
+//   adcMax - Raw ADC values at or above this are flagged as overflow
+//
+// If the per-channel min or max is not defined, the FEMB value is used.
+
+#ifndef FembCalibTable_H
+#define FembCalibTable_H
+
+#include <string>
+#include <vector>
+
+class FembCalibTable {
+
+public:
+
+  using Index = unsigned int;
+  using FloatVector = std::vector<float>;
+  using IntVector = std::vector<int>;
+
+  // Default ctor.
+  FembCalibTable();
+
+  // Read a FembLinearCalibration configuration from an FCL file.
+  // The file is found using FHICL_FILE_PATH.
+  // If toolName is blank, the first tool in the file is used.
+  // Returns 0 for success.
+  int readFcl(std::string fname, std::string toolName ="");
+
+  // Return the FCL configuration for a FembLinearCalibration tool with
+  // this calibration, i.e. what readFcl reads.
+  std::string fclText(std::string toolName) const;
+
+  // Getters.
+  bool isValid() const { return m_gains.size() > 0; }
+  Index femb() const { return m_femb; }
+  std::string units() const { return m_units; }
+  Index size() const { return m_gains.size(); }
+  const FloatVector& gains() const { return m_gains; }
+  const IntVector& adcMins() const { return m_adcMins; }
+  const IntVector& adcMaxs() const { return m_adcMaxs; }
+  float gain(Index icha) const { return icha < m_gains.size() ? m_gains[icha] : 0.0; }
+  int adcMin(Index icha) const { return icha < m_adcMins.size() ? m_adcMins[icha] : m_adcMin; }
+  int adcMax(Index icha) const { return icha < m_adcMaxs.size() ? m_adcMaxs[icha] : m_adcMax; }
+  int adcMin() const { return m_adcMin; }
+  int adcMax() const { return m_adcMax; }
+
+  // Setters.
+  void setFemb(Index val) { m_femb = val; }
+  void setUnits(std::string val) { m_units = val; }
+  void setAdcRange(int amin, int amax) { m_adcMin = amin; m_adcMax = amax; }
+  void setGains(const FloatVector& vals) { m_gains = vals; }
+  void setAdcMins(const IntVector& vals) { m_adcMins = vals; }
+  void setAdcMaxs(const IntVector& vals) { m_adcMaxs = vals; }
+
+private:
+
+  Index m_femb;
+  std::string m_units;
+  FloatVector m_gains;
+  int m_adcMin;
+  int m_adcMax;
+  IntVector m_adcMins;
+  IntVector m_adcMaxs;
+
+};
+
+#endif
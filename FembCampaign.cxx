@@ -0,0 +1,527 @@
+// FembCampaign.cxx
+
+#include "FembCampaign.h"
+#include "FembTestAnalyzer.h"
+#include "FembWorkStealingPool.h"
+#include "FembSummaryExporter.h"
+#include "DuneFembFinder.h"
+#include "dunesupport/FileDirectory.h"
+#include "TH1.h"
+#include "TROOT.h"
+#include "TSystem.h"
+#include "Math/MinimizerOptions.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::setfill;
+using std::ostringstream;
+using std::lock_guard;
+using std::mutex;
+
+using Index = FembCampaign::Index;
+using Name = FembCampaign::Name;
+using IndexVector = FembCampaign::IndexVector;
+using NameVector = std::vector<Name>;
+using FileMap = FileDirectory::FileMap;
+
+namespace {
+
+// Return if a value is selected by a list.
+bool isSelected(const IndexVector& sel, Index val) {
+  if ( sel.size() == 0 ) return true;
+  for ( Index selval : sel ) if ( selval == val ) return true;
+  return false;
+}
+
+// Fill the configuration of a dataset from its directory name, e.g.
+// fembTest_gainenc_test_g2_s3_extpulse_intclock. Returns 0 for success.
+int parseDatasetDir(const Name& dir, FembCampaign::Dataset& ds) {
+  const Name prefix = "fembTest_gainenc_test_g";
+  if ( dir.compare(0, prefix.size(), prefix) != 0 ) return 1;
+  unsigned int gain = 0;
+  unsigned int shap = 0;
+  char spulse[16];
+  if ( sscanf(dir.c_str() + prefix.size(), "%u_s%u_%15[a-z]", &gain, &shap, spulse) != 3 ) return 2;
+  Name pulse = spulse;
+  if ( pulse != "extpulse" && pulse != "intpulse" ) return 3;
+  ds.gain = gain;
+  ds.shap = shap;
+  ds.extPulse = pulse == "extpulse";
+  ds.extClock = dir.find("_intclock") == Name::npos;
+  return 0;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+Name FembCampaign::Dataset::name() const {
+  ostringstream ssnam;
+  ssnam << "femb" << setw(2) << setfill('0') << femb << setfill(' ')
+        << (isCold ? "_cold" : "_warm")
+        << "_g" << gain << "s" << shap
+        << "_" << (extPulse ? "ext" : "int") << "P"
+        << "_" << (extClock ? "ext" : "int") << "C"
+        << "_" << ts;
+  return ssnam.str();
+}
+
+//**********************************************************************
+
+FembCalibDatabase::Key FembCampaign::Dataset::calibKey() const {
+  FembCalibDatabase::Key key;
+  key.femb = femb;
+  key.gain = gain;
+  key.shap = shap;
+  key.isCold = isCold;
+  key.extPulse = extPulse;
+  key.extClock = extClock;
+  return key;
+}
+
+//**********************************************************************
+
+FembCampaign::FembCampaign(Name checkpointDir, Name topdir)
+: m_checkpoint(checkpointDir), m_topdir(topdir), m_plotDir("campaign"),
+  m_memoryFactor(4.0), m_nrunning(0), m_maxMemory(0.0), m_usedMemory(0.0) { }
+
+//**********************************************************************
+
+FembCampaign::~FembCampaign() { }
+
+//**********************************************************************
+
+Index FembCampaign::findDatasets() {
+  const string myname = "FembCampaign::findDatasets: ";
+  std::vector<Dataset> dss = scanDatasets(m_topdir, m_selFembs, m_selGains, m_selShaps);
+  for ( Dataset& ds : dss ) {
+    ds.memory *= m_memoryFactor;
+    addDataset(ds);
+  }
+  Index nds = dss.size();
+  cout << myname << "Found " << nds << " dataset" << (nds == 1 ? "" : "s") << "." << endl;
+  return nds;
+}
+
+//**********************************************************************
+
+std::vector<FembCampaign::Dataset>
+FembCampaign::scanDatasets(Name topdir, const IndexVector& fembs,
+                           const IndexVector& gains, const IndexVector& shaps) {
+  const string myname = "FembCampaign::scanDatasets: ";
+  std::vector<Dataset> dss;
+  DuneFembFinder fdr(topdir);
+  for ( bool isCold : {false, true} ) {
+    for ( const auto& ent : fdr.fembMap(isCold) ) {
+      Index ifmb = ent.first;
+      if ( ! isSelected(fembs, ifmb) ) continue;
+      for ( const Name& ts : ent.second ) {
+        NameVector tsdirs = fdr.timestampDirs(ts);
+        if ( tsdirs.size() != 1 ) {
+          cout << myname << "Skipping timestamp " << ts << " with " << tsdirs.size()
+               << " directories." << endl;
+          continue;
+        }
+        FileDirectory tsdir(tsdirs[0]);
+        FileMap dsdirs = tsdir.find("fembTest_gainenc_test_g");
+        for ( const auto& dsent : dsdirs ) {
+          Dataset ds;
+          ds.femb = ifmb;
+          ds.isCold = isCold;
+          ds.ts = ts;
+          if ( parseDatasetDir(dsent.first, ds) ) continue;
+          if ( ! isSelected(gains, ds.gain) ) continue;
+          if ( ! isSelected(shaps, ds.shap) ) continue;
+          FileDirectory dsdir(tsdir.dirname + "/" + dsent.first);
+          FileMap dsfiles = dsdir.find("parseBinaryFile.root");
+          if ( dsfiles.size() == 0 ) {
+            cout << myname << "Binary file not found in " << dsdir.dirname << endl;
+            continue;
+          }
+          string path = dsdir.dirname + "/" + dsfiles.begin()->first;
+          struct stat sbuf;
+          double size = stat(path.c_str(), &sbuf) == 0 ? double(sbuf.st_size) : 0.0;
+          ds.memory = 1.e-6*size;
+          ds.path = path;
+          dss.push_back(ds);
+        }
+      }
+    }
+  }
+  return dss;
+}
+
+//**********************************************************************
+
+Index FembCampaign::addDataset(const Dataset& ds) {
+  Index ids = m_datasets.size();
+  m_datasets.push_back(ds);
+  m_analyzers.emplace_back();
+  Name dsname = ds.name();
+  Index jpro = addJob(dsname + "_process", ids, [this, ids]() { return processDataset(ids); });
+  Index jcal = addJob(dsname + "_calib", ids, [this, ids]() { return writeCalib(ids); }, {jpro});
+  Index jsum = addJob(dsname + "_summary", ids, [this, ids]() { return writeSummary(ids); }, {jcal});
+  addJob(dsname + "_report", ids, [this, ids]() { return writeReport(ids); }, {jsum});
+  return ids;
+}
+
+//**********************************************************************
+
+Index FembCampaign::addJob(Name name, Index ids, Action action, const IndexVector& deps) {
+  const string myname = "FembCampaign::addJob: ";
+  Index ijob = m_jobs.size();
+  if ( ids >= m_datasets.size() ) {
+    cout << myname << "Invalid dataset index " << ids << " for job " << name << endl;
+    return badIndex();
+  }
+  for ( Index jjob : deps ) {
+    if ( jjob >= ijob ) {
+      cout << myname << "Invalid dependency " << jjob << " for job " << name << endl;
+      return badIndex();
+    }
+  }
+  Job job;
+  job.name = name;
+  job.dataset = ids;
+  job.deps = deps;
+  job.action = action;
+  m_jobs.push_back(job);
+  m_dependents.emplace_back();
+  for ( Index jjob : deps ) m_dependents[jjob].push_back(ijob);
+  return ijob;
+}
+
+//**********************************************************************
+
+Index FembCampaign::run(Index nthread, double maxMemory) {
+  const string myname = "FembCampaign::run: ";
+  Index njob = m_jobs.size();
+  Index nds = m_datasets.size();
+  if ( ! m_checkpoint.isValid() ) {
+    cout << myname << "Checkpoint " << m_checkpoint.dirName() << " is not usable." << endl;
+    return njob;
+  }
+  // Jobs of quarantined datasets and jobs that have failed too often are
+  // not run.
+  for ( Job& job : m_jobs ) {
+    job.time = 0.0;
+    job.status = Pending;
+    Name dsname = m_datasets[job.dataset].name();
+    if ( m_checkpoint.entry(dsname).status == FembCheckpoint::Quarantined ) {
+      job.status = Quarantined;
+      continue;
+    }
+    FembCheckpoint::Entry ent = m_checkpoint.entry(job.name);
+    if ( ent.status == FembCheckpoint::Failed && ent.attempts >= m_checkpoint.maxAttempts() ) {
+      cout << myname << "Job " << job.name << " is not retried after " << ent.attempts
+           << " failed attempts." << endl;
+      job.status = Failed;
+    }
+  }
+  // Skip jobs that succeeded earlier if none of their dependents will run
+  // and block jobs whose dependencies cannot succeed. Skipping is repeated
+  // after blocking so a job is not rerun for dependents that are blocked.
+  for ( Index ipass=0; ipass<2; ++ipass ) {
+    for ( Index ijob=njob; ijob>0; --ijob ) {
+      Job& job = m_jobs[ijob-1];
+      if ( job.status != Pending ) continue;
+      bool skip = m_checkpoint.isDone(job.name);
+      for ( Index jjob : m_dependents[ijob-1] ) if ( m_jobs[jjob].status == Pending ) skip = false;
+      if ( skip ) job.status = Skipped;
+    }
+    if ( ipass ) break;
+    for ( Job& job : m_jobs ) {
+      if ( job.status != Pending ) continue;
+      for ( Index jjob : job.deps ) {
+        Status jstat = m_jobs[jjob].status;
+        if ( jstat != Pending && jstat != Skipped ) job.status = Blocked;
+      }
+    }
+  }
+  m_ready.clear();
+  m_nwait.assign(njob, 0);
+  m_nleft.assign(nds, 0);
+  m_reserved.assign(nds, false);
+  m_nrunning = 0;
+  m_maxMemory = maxMemory;
+  m_usedMemory = 0.0;
+  Index nrun = 0;
+  for ( Index ijob=0; ijob<njob; ++ijob ) {
+    Job& job = m_jobs[ijob];
+    if ( job.status != Pending ) continue;
+    ++nrun;
+    ++m_nleft[job.dataset];
+    for ( Index jjob : job.deps ) if ( m_jobs[jjob].status == Pending ) ++m_nwait[ijob];
+    if ( m_nwait[ijob] == 0 ) m_ready.push_back(ijob);
+  }
+  cout << myname << "Running " << nrun << " of " << njob << " jobs." << endl;
+  if ( nrun == 0 ) return 0;
+  m_calibDb.clearAdded();
+  if ( m_calibDbName.size() && ! gSystem->AccessPathName(m_calibDbName.c_str()) ) {
+    m_calibDb.addFile(m_calibDbName);
+  }
+  // As in FembTestAnalyzer::processResponses, fits use Minuit2 and
+  // histograms are kept out of gDirectory so analyzers can run concurrently.
+  ROOT::EnableThreadSafety();
+  string minimizerSave = ROOT::Math::MinimizerOptions::DefaultMinimizerType();
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+  bool addDirSave = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(false);
+  {
+    FembWorkStealingPool pool(nthread);
+    cout << myname << "Using " << pool.size() << " thread" << (pool.size() == 1 ? "" : "s");
+    if ( maxMemory > 0.0 ) cout << " and " << maxMemory << " MB";
+    cout << "." << endl;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      dispatch(pool);
+    }
+    pool.wait();
+  }
+  TH1::AddDirectory(addDirSave);
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer(minimizerSave.c_str());
+  if ( m_calibDbName.size() && m_calibDb.addedSize() ) m_calibDb.write(m_calibDbName);
+  Index nfail = 0;
+  Index ndone = 0;
+  for ( const Job& job : m_jobs ) {
+    if ( job.status == Done ) ++ndone;
+    if ( job.status == Failed || job.status == Blocked || job.status == Quarantined ) ++nfail;
+  }
+  cout << myname << "Jobs done: " << ndone << ", failed, blocked or quarantined: " << nfail << endl;
+  NameVector sumNames;
+  for ( Index ids=0; ids<m_datasets.size(); ++ids ) {
+    Name sumName = summaryFileName(ids);
+    if ( ! gSystem->AccessPathName(sumName.c_str()) ) sumNames.push_back(sumName);
+  }
+  if ( sumNames.size() ) FembSummaryExporter::writeHtml(m_plotDir + "/summary.html", sumNames, "FEMB campaign summary");
+  return nfail;
+}
+
+//**********************************************************************
+
+void FembCampaign::print() const {
+  cout << "FEMB campaign with " << m_datasets.size() << " datasets and "
+       << m_jobs.size() << " jobs." << endl;
+  std::streamsize precSave = cout.precision();
+  Index wnam = 4;
+  for ( const Job& job : m_jobs ) if ( job.name.size() > wnam ) wnam = job.name.size();
+  for ( Index ijob=0; ijob<m_jobs.size(); ++ijob ) {
+    const Job& job = m_jobs[ijob];
+    cout << setw(6) << ijob << "  " << std::left << setw(wnam) << job.name << std::right
+         << setw(12) << statusName(job.status)
+         << setw(10) << std::fixed << std::setprecision(1) << job.time << " s"
+         << setw(10) << m_datasets[job.dataset].memory << " MB" << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+  cout.precision(precSave);
+}
+
+//**********************************************************************
+
+FembTestAnalyzer* FembCampaign::analyzer(Index ids) const {
+  if ( ids >= m_analyzers.size() ) return nullptr;
+  return m_analyzers[ids].get();
+}
+
+//**********************************************************************
+
+Name FembCampaign::statusName(Status val) {
+  if ( val == Pending ) return "Pending";
+  if ( val == Running ) return "Running";
+  if ( val == Done    ) return "Done";
+  if ( val == Failed  ) return "Failed";
+  if ( val == Blocked ) return "Blocked";
+  if ( val == Skipped ) return "Skipped";
+  if ( val == Quarantined ) return "Quarantined";
+  return "Unknown";
+}
+
+//**********************************************************************
+
+int FembCampaign::processDataset(Index ids) {
+  const string myname = "FembCampaign::processDataset: ";
+  const Dataset& ds = m_datasets[ids];
+  std::unique_ptr<FembTestAnalyzer> pfta;
+  {
+    lock_guard<mutex> lock(m_rootMutex);
+    pfta.reset(new FembTestAnalyzer(10, ds.femb, ds.gain, ds.shap, ds.ts,
+                                    ds.isCold, ds.extPulse, ds.extClock));
+  }
+  const DuneFembReader* prdr = pfta->reader();
+  if ( prdr == nullptr ) {
+    cout << myname << "No reader found for " << ds.name() << endl;
+    return 1;
+  }
+  if ( prdr->tree() == nullptr || prdr->nChannel() == 0 || prdr->nEvent() == 0 ) {
+    cout << myname << "Input for " << ds.name() << " is corrupt or empty." << endl;
+    return badInputStatus();
+  }
+  if ( ! pfta->haveTools() ) {
+    cout << myname << "Tools not found for " << ds.name() << endl;
+    return 2;
+  }
+  pfta->setCheckpoint(&m_checkpoint, ds.name());
+  const DataMap& res = pfta->processAll();
+  if ( prdr->readErrorCount() ) {
+    cout << myname << "Input for " << ds.name() << " has " << prdr->readErrorCount()
+         << " unreadable entries." << endl;
+    return badInputStatus();
+  }
+  if ( res.status() ) {
+    cout << myname << "Processing " << ds.name() << " returned status " << res.status() << endl;
+    return 3;
+  }
+  m_analyzers[ids] = std::move(pfta);
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCampaign::writeCalib(Index ids) {
+  FembTestAnalyzer* pfta = analyzer(ids);
+  if ( pfta == nullptr ) return 1;
+  int rstat = pfta->writeCalibFcl();
+  if ( rstat || m_calibDbName.size() == 0 ) return rstat;
+  FembCalibTable cal;
+  if ( pfta->calibTable(cal) ) return 2;
+  lock_guard<mutex> lock(m_mutex);
+  return m_calibDb.add(m_datasets[ids].calibKey(), cal) ? 3 : 0;
+}
+
+//**********************************************************************
+
+int FembCampaign::writeSummary(Index ids) {
+  FembTestAnalyzer* pfta = analyzer(ids);
+  if ( pfta == nullptr ) return 1;
+  {
+    lock_guard<mutex> lock(m_rootMutex);
+    if ( gSystem->AccessPathName(m_plotDir.c_str()) ) gSystem->mkdir(m_plotDir.c_str(), true);
+  }
+  FembSummaryExporter sumexp(pfta);
+  return sumexp.writeJson(summaryFileName(ids)) ? 2 : 0;
+}
+
+//**********************************************************************
+
+Name FembCampaign::summaryFileName(Index ids) const {
+  return m_plotDir + "/" + m_datasets[ids].name() + "_summary.json";
+}
+
+//**********************************************************************
+
+int FembCampaign::writeReport(Index ids) {
+  const string myname = "FembCampaign::writeReport: ";
+  FembTestAnalyzer* pfta = analyzer(ids);
+  if ( pfta == nullptr ) return 1;
+  lock_guard<mutex> lock(m_rootMutex);
+  if ( gSystem->AccessPathName(m_plotDir.c_str()) ) gSystem->mkdir(m_plotDir.c_str(), true);
+  Name dsname = m_datasets[ids].name();
+  NameVector names = {"pedlim", "gainh", "gaina", "csddh", "csdch"};
+  for ( Name name : names ) {
+    TPadManipulator* pman = pfta->draw(name);
+    if ( pman == nullptr ) {
+      cout << myname << "Unable to draw " << name << " for " << dsname << endl;
+      return 2;
+    }
+    pman->print(m_plotDir + "/" + dsname + "_" + name + ".png");
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+void FembCampaign::dispatch(FembWorkStealingPool& pool) {
+  std::deque<Index>::iterator iready = m_ready.begin();
+  while ( iready != m_ready.end() ) {
+    Index ijob = *iready;
+    Index ids = m_jobs[ijob].dataset;
+    if ( ! m_reserved[ids] ) {
+      double mem = m_datasets[ids].memory;
+      bool fits = m_maxMemory <= 0.0 || m_usedMemory + mem <= m_maxMemory;
+      if ( ! fits && m_nrunning > 0 ) {
+        ++iready;
+        continue;
+      }
+      m_reserved[ids] = true;
+      m_usedMemory += mem;
+    }
+    iready = m_ready.erase(iready);
+    m_jobs[ijob].status = Running;
+    ++m_nrunning;
+    pool.submit([this, &pool, ijob]() { runJob(pool, ijob); });
+  }
+}
+
+//**********************************************************************
+
+void FembCampaign::runJob(FembWorkStealingPool& pool, Index ijob) {
+  const string myname = "FembCampaign::runJob: ";
+  Job& job = m_jobs[ijob];
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int rstat = 0;
+  // Catch here so the job is always finished.
+  try {
+    if ( job.action ) rstat = job.action();
+  } catch ( ... ) {
+    cout << myname << "ERROR: Job " << job.name << " raised an exception." << endl;
+    rstat = -1;
+  }
+  double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  lock_guard<mutex> lock(m_mutex);
+  job.time += dt;
+  --m_nrunning;
+  if ( rstat == 0 ) {
+    m_checkpoint.setDone(job.name);
+    finish(ijob, Done);
+  } else if ( rstat == badInputStatus() ) {
+    const Dataset& ds = m_datasets[job.dataset];
+    m_checkpoint.setQuarantined(ds.name(), rstat, ds.path);
+    finish(ijob, Quarantined);
+  } else {
+    cout << myname << "Job " << job.name << " failed with status " << rstat << endl;
+    m_checkpoint.setFailed(job.name, rstat);
+    if ( m_checkpoint.shouldRun(job.name) ) {
+      // Retry. The dataset keeps its memory reservation.
+      cout << myname << "Retrying job " << job.name << endl;
+      job.status = Pending;
+      m_ready.push_back(ijob);
+    } else {
+      finish(ijob, Failed);
+    }
+  }
+  dispatch(pool);
+}
+
+//**********************************************************************
+
+void FembCampaign::finish(Index ijob, Status stat) {
+  Job& job = m_jobs[ijob];
+  job.status = stat;
+  Index ids = job.dataset;
+  if ( --m_nleft[ids] == 0 ) {
+    if ( m_reserved[ids] ) m_usedMemory -= m_datasets[ids].memory;
+    m_reserved[ids] = false;
+    m_analyzers[ids].reset();
+  }
+  for ( Index jjob : m_dependents[ijob] ) {
+    Status jstat = m_jobs[jjob].status;
+    // Only pending dependents are counted in m_nwait and m_nleft.
+    if ( jstat != Pending ) continue;
+    if ( stat == Done ) {
+      // Dependents go first so datasets complete and release their memory.
+      if ( --m_nwait[jjob] == 0 ) m_ready.push_front(jjob);
+    } else {
+      finish(jjob, Blocked);
+    }
+  }
+}
+
+//**********************************************************************
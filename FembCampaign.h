@@ -0,0 +1,213 @@
+// FembCampaign.h
+//
+// Runs the FEMB test analysis for a campaign of datasets, i.e. the FEMBs
+// and configurations (temperature, gain, shaping, pulse and clock) found
+// in fembjson.dat and the data tree.
+//
+// Each dataset has a chain of jobs:
+//   DATASET_process - processAll for a raw (uncalibrated) analyzer
+//   DATASET_calib   - write the calibration FCL and add it to the database
+//   DATASET_summary - write the JSON summary PLOTDIR/DATASET_summary.json
+//   DATASET_report  - print the FEMB plots
+// Other jobs may be added with addJob. At the end of run, the summaries of
+// all datasets are shown in PLOTDIR/summary.html (see FembSummaryExporter).
+//
+// Jobs run on a work-stealing pool. A job is started when the jobs it
+// depends on have succeeded. Jobs of a dataset share its analyzer and the
+// dataset memory estimate is reserved from the start of its first job to
+// the end of its last. A dataset is only started if its estimate fits in
+// the memory limit or if no other job is running.
+//
+// Progress is recorded in a FembCheckpoint directory. The manifest is
+// updated atomically when a job finishes, so a campaign resumes job by job:
+// a process job that did not finish is run again for all channels because
+// the summary and report need the full channel results. The process job
+// also checkpoints the values of each channel, which FembTestAnalyzer::
+// channelValue and calibTable (e.g. FembShardCoordinator) read back.
+// When the campaign is run again:
+//   - a job that succeeded is skipped if the jobs that depend on it are
+//     also skipped,
+//   - a job that failed is run again until it has failed maxAttempts
+//     times, counting the attempts of earlier runs,
+//   - a dataset whose input file is corrupt (missing tree, no channels or
+//     unreadable entries) is quarantined: its jobs are not run again and
+//     the file is listed in the quarantine file of the checkpoint.
+// A failed job is also retried within a run until it reaches maxAttempts.
+//
+// Each analyzer is single threaded; the concurrency is across datasets.
+// Analyzer creation and drawing are serialized because the tool manager
+// and ROOT graphics are not thread safe.
+
+#ifndef FembCampaign_H
+#define FembCampaign_H
+
+#include "FembCheckpoint.h"
+#include "FembCalibDatabase.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <deque>
+
+class FembTestAnalyzer;
+class FembWorkStealingPool;
+
+class FembCampaign {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using IndexVector = std::vector<Index>;
+  using Action = std::function<int()>;
+
+  // A dataset, i.e. one FEMB test sample.
+  struct Dataset {
+    Index femb = 0;
+    bool isCold = true;
+    Name ts;
+    Index gain = 0;
+    Index shap = 0;
+    bool extPulse = true;
+    bool extClock = true;
+    double memory = 0.0;  // Memory estimate [MB]
+    Name path;            // Data file, if known
+    Name name() const;
+    FembCalibDatabase::Key calibKey() const;
+  };
+
+  enum Status { Pending, Running, Done, Failed, Blocked, Skipped, Quarantined };
+
+  // A job.
+  struct Job {
+    Name name;
+    Index dataset;
+    IndexVector deps;
+    Action action;
+    Status status = Pending;
+    double time = 0.0;    // Run time [sec]
+  };
+
+  // Ctor from the checkpoint directory and the data directory.
+  // A blank topdir means DuneFembFinder::defaultTopdir(), which is also
+  // where the analyzers look for the data.
+  explicit FembCampaign(Name checkpointDir ="campaign_checkpoint",
+                        Name topdir ="");
+
+  // Dtor.
+  ~FembCampaign();
+
+  // Delete copy and assignment.
+  FembCampaign(const FembCampaign&) =delete;
+  FembCampaign& operator=(const FembCampaign&) =delete;
+
+  // Selection used by findDatasets. An empty list selects all values.
+  void setFembs(const IndexVector& vals) { m_selFembs = vals; }
+  void setGains(const IndexVector& vals) { m_selGains = vals; }
+  void setShapings(const IndexVector& vals) { m_selShaps = vals; }
+
+  // Memory estimate for a dataset is this factor times the size of its data file.
+  void setMemoryFactor(double val) { m_memoryFactor = val; }
+
+  // Directory for the report plots.
+  void setPlotDir(Name val) { m_plotDir = val; }
+
+  // Calibration database written at the end of run. Tables from an existing
+  // file are kept unless replaced. A blank name disables the database.
+  void setCalibDatabaseName(Name val) { m_calibDbName = val; }
+
+  // Maximum number of attempts for a job, including those of earlier runs.
+  void setMaxAttempts(Index val) { m_checkpoint.setMaxAttempts(val); }
+
+  // Add all selected datasets found in fembjson.dat and the data tree with
+  // their standard jobs. Returns the number of datasets added.
+  Index findDatasets();
+
+  // Return the selected datasets found in fembjson.dat and the data tree
+  // under topdir. The memory of each is the size of its data file [MB].
+  static std::vector<Dataset> scanDatasets(Name topdir, const IndexVector& fembs,
+                                           const IndexVector& gains, const IndexVector& shaps);
+
+  // Add a dataset and its standard jobs. Returns the dataset index.
+  Index addDataset(const Dataset& ds);
+
+  // Add a job. Dependencies must already have been added.
+  // Returns the job index.
+  Index addJob(Name name, Index ids, Action action, const IndexVector& deps =IndexVector());
+
+  // Run the jobs with nthread threads (zero for the hardware concurrency)
+  // and a memory limit in MB (zero for no limit).
+  // Returns the number of jobs that failed or were blocked.
+  Index run(Index nthread =0, double maxMemory =0.0);
+
+  // Display the datasets and jobs.
+  void print() const;
+
+  // Getters.
+  const std::vector<Dataset>& datasets() const { return m_datasets; }
+  const std::vector<Job>& jobs() const { return m_jobs; }
+  const FembCheckpoint& checkpoint() const { return m_checkpoint; }
+  Name calibDatabaseName() const { return m_calibDbName; }
+  FembTestAnalyzer* analyzer(Index ids) const;
+
+  // Status name.
+  static Name statusName(Status val);
+
+  // Index returned for an invalid job.
+  static Index badIndex() { return Index(-1); }
+
+  // Status returned by a job action if the dataset input is corrupt.
+  // The dataset is then quarantined.
+  static int badInputStatus() { return 100; }
+
+private:
+
+  // Standard job actions.
+  int processDataset(Index ids);
+  int writeCalib(Index ids);
+  int writeSummary(Index ids);
+  int writeReport(Index ids);
+
+  // Name of the JSON summary for a dataset.
+  Name summaryFileName(Index ids) const;
+
+  // Start the ready jobs for which memory is available.
+  // Called with m_mutex held.
+  void dispatch(FembWorkStealingPool& pool);
+
+  // Run a job and start those that depend on it.
+  void runJob(FembWorkStealingPool& pool, Index ijob);
+
+  // Mark a job and those that depend on it as finished.
+  // Called with m_mutex held.
+  void finish(Index ijob, Status stat);
+
+  FembCheckpoint m_checkpoint;
+  Name m_topdir;
+  Name m_plotDir;
+  Name m_calibDbName;
+  double m_memoryFactor;
+  IndexVector m_selFembs;
+  IndexVector m_selGains;
+  IndexVector m_selShaps;
+  std::vector<Dataset> m_datasets;
+  std::vector<Job> m_jobs;
+  std::vector<IndexVector> m_dependents;   // [ijob]
+  std::vector<std::unique_ptr<FembTestAnalyzer>> m_analyzers;
+
+  // Run state.
+  std::mutex m_mutex;               // Guards the run state.
+  std::mutex m_rootMutex;           // Serializes tool creation and drawing.
+  std::deque<Index> m_ready;
+  IndexVector m_nwait;              // [ijob] Unfinished dependencies.
+  IndexVector m_nleft;              // [ids] Unfinished jobs.
+  std::vector<bool> m_reserved;     // [ids]
+  Index m_nrunning;                 // Jobs submitted and not finished.
+  double m_maxMemory;
+  double m_usedMemory;
+  FembCalibDatabase m_calibDb;      // Guarded by m_mutex.
+
+};
+
+#endif
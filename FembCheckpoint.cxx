@@ -0,0 +1,244 @@
+// FembCheckpoint.cxx
+
+#include "FembCheckpoint.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::ifstream;
+using std::ostringstream;
+using std::lock_guard;
+using std::mutex;
+
+using Index = FembCheckpoint::Index;
+using Name = FembCheckpoint::Name;
+using Entry = FembCheckpoint::Entry;
+
+namespace {
+
+// Create a directory if it does not exist. Returns 0 for success.
+int makeDir(const Name& dir) {
+  if ( mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST ) return 0;
+  return 1;
+}
+
+// Sync the directory holding a file so a rename is durable.
+void syncDir(const Name& fname) {
+  Name::size_type ipos = fname.rfind('/');
+  Name dir = ipos == Name::npos ? "." : fname.substr(0, ipos);
+  int fd = open(dir.c_str(), O_RDONLY);
+  if ( fd < 0 ) return;
+  fsync(fd);
+  close(fd);
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembCheckpoint::FembCheckpoint(Name dir, Index maxAttempts)
+: m_dir(dir), m_maxAttempts(maxAttempts), m_valid(false) {
+  const string myname = "FembCheckpoint::ctor: ";
+  if ( makeDir(m_dir) || makeDir(m_dir + "/records") ) {
+    cout << myname << "Unable to create checkpoint directory " << m_dir << endl;
+    return;
+  }
+  if ( readManifest() ) {
+    cout << myname << "Unable to read manifest " << manifestName() << endl;
+    return;
+  }
+  m_valid = true;
+}
+
+//**********************************************************************
+
+Entry FembCheckpoint::entry(Name job) const {
+  lock_guard<mutex> lock(m_mutex);
+  std::map<Name, Entry>::const_iterator ient = m_entries.find(job);
+  if ( ient == m_entries.end() ) return Entry();
+  return ient->second;
+}
+
+//**********************************************************************
+
+bool FembCheckpoint::shouldRun(Name job) const {
+  Entry ent = entry(job);
+  if ( ent.status == Done || ent.status == Quarantined ) return false;
+  return ent.attempts < m_maxAttempts;
+}
+
+//**********************************************************************
+
+int FembCheckpoint::setDone(Name job) {
+  lock_guard<mutex> lock(m_mutex);
+  m_entries[job].status = Done;
+  return writeManifest();
+}
+
+//**********************************************************************
+
+int FembCheckpoint::setFailed(Name job, int error) {
+  lock_guard<mutex> lock(m_mutex);
+  Entry& ent = m_entries[job];
+  ent.status = Failed;
+  ++ent.attempts;
+  ent.error = error;
+  return writeManifest();
+}
+
+//**********************************************************************
+
+int FembCheckpoint::setQuarantined(Name job, int error, Name path) {
+  const string myname = "FembCheckpoint::setQuarantined: ";
+  lock_guard<mutex> lock(m_mutex);
+  Entry& ent = m_entries[job];
+  ent.status = Quarantined;
+  ++ent.attempts;
+  ent.error = error;
+  m_quarantine[job] = path.size() ? path : "-";
+  ostringstream ssout;
+  for ( const auto& qent : m_quarantine ) ssout << qent.first << " " << qent.second << "\n";
+  if ( writeAtomic(quarantineName(), ssout.str()) ) {
+    cout << myname << "Unable to write " << quarantineName() << endl;
+  }
+  cout << myname << "Quarantined " << job << " with error " << error;
+  if ( path.size() ) cout << ": " << path;
+  cout << endl;
+  return writeManifest();
+}
+
+//**********************************************************************
+
+int FembCheckpoint::writeRecord(Name name, const Name& text) const {
+  return writeAtomic(recordName(name), text);
+}
+
+//**********************************************************************
+
+int FembCheckpoint::readRecord(Name name, Name& text) const {
+  text.clear();
+  ifstream fin(recordName(name).c_str(), std::ios_base::binary);
+  if ( ! fin ) return 1;
+  ostringstream ssin;
+  ssin << fin.rdbuf();
+  text = ssin.str();
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCheckpoint::writeAtomic(Name fname, const Name& text) {
+  ostringstream sstmp;
+  sstmp << fname << ".tmp" << getpid();
+  Name tmpName = sstmp.str();
+  int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if ( fd < 0 ) return 1;
+  const char* buf = text.data();
+  size_t nbyte = text.size();
+  while ( nbyte ) {
+    ssize_t nwrit = write(fd, buf, nbyte);
+    if ( nwrit < 0 ) {
+      if ( errno == EINTR ) continue;
+      close(fd);
+      unlink(tmpName.c_str());
+      return 2;
+    }
+    buf += nwrit;
+    nbyte -= nwrit;
+  }
+  if ( fsync(fd) || close(fd) ) {
+    unlink(tmpName.c_str());
+    return 3;
+  }
+  if ( rename(tmpName.c_str(), fname.c_str()) ) {
+    unlink(tmpName.c_str());
+    return 4;
+  }
+  syncDir(fname);
+  return 0;
+}
+
+//**********************************************************************
+
+void FembCheckpoint::print() const {
+  lock_guard<mutex> lock(m_mutex);
+  cout << "Checkpoint " << m_dir << " with " << m_entries.size() << " jobs." << endl;
+  Index wnam = 4;
+  for ( const auto& ent : m_entries ) if ( ent.first.size() > wnam ) wnam = ent.first.size();
+  for ( const auto& ent : m_entries ) {
+    cout << "  " << std::left << setw(wnam) << ent.first << std::right
+         << setw(13) << statusName(ent.second.status)
+         << setw(4) << ent.second.attempts
+         << setw(6) << ent.second.error << endl;
+  }
+}
+
+//**********************************************************************
+
+Name FembCheckpoint::recordName(Name name) const {
+  for ( char& ch : name ) if ( ch == '/' || ch == ' ' ) ch = '_';
+  return m_dir + "/records/" + name + ".txt";
+}
+
+//**********************************************************************
+
+Name FembCheckpoint::statusName(Status val) {
+  if ( val == Missing     ) return "Missing";
+  if ( val == Done        ) return "Done";
+  if ( val == Failed      ) return "Failed";
+  if ( val == Quarantined ) return "Quarantined";
+  return "Unknown";
+}
+
+//**********************************************************************
+
+int FembCheckpoint::readManifest() {
+  lock_guard<mutex> lock(m_mutex);
+  m_entries.clear();
+  m_quarantine.clear();
+  ifstream fin(manifestName().c_str());
+  if ( fin ) {
+    Name name;
+    Name sstat;
+    Entry ent;
+    while ( fin >> name >> sstat >> ent.attempts >> ent.error ) {
+      if      ( sstat == statusName(Done) ) ent.status = Done;
+      else if ( sstat == statusName(Failed) ) ent.status = Failed;
+      else if ( sstat == statusName(Quarantined) ) ent.status = Quarantined;
+      else continue;
+      m_entries[name] = ent;
+    }
+    if ( ! fin.eof() ) return 1;
+  }
+  ifstream qin(quarantineName().c_str());
+  Name name;
+  Name path;
+  while ( qin >> name >> path ) m_quarantine[name] = path;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembCheckpoint::writeManifest() const {
+  const string myname = "FembCheckpoint::writeManifest: ";
+  ostringstream ssout;
+  for ( const auto& ent : m_entries ) {
+    ssout << ent.first << " " << statusName(ent.second.status) << " "
+          << ent.second.attempts << " " << ent.second.error << "\n";
+  }
+  int rstat = writeAtomic(manifestName(), ssout.str());
+  if ( rstat ) cout << myname << "Unable to write " << manifestName() << endl;
+  return rstat;
+}
+
+//**********************************************************************
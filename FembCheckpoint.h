@@ -0,0 +1,107 @@
+// FembCheckpoint.h
+//
+// Durable progress record for long FEMB processing runs.
+//
+// The checkpoint is a directory holding
+//   manifest.txt   - one line for each job: NAME STATUS ATTEMPTS ERROR
+//   quarantine.txt - inputs that were found to be corrupt: NAME PATH
+//   records/       - result records, one text file for each record name
+//
+// Every file is written atomically: the text goes to a temporary file which
+// is synced and then renamed over the old file. A crash leaves either the
+// old or the new content, never a partial file. The manifest is rewritten
+// for each update, so it always holds the last status of every job.
+//
+// A job should be run if it is not done, not quarantined and has failed
+// fewer than maxAttempts times. Jobs with corrupt input are quarantined
+// and are not retried until they are removed from the manifest.
+//
+// Updates are thread safe. The records of different names may be written
+// from different processes but the manifest must only be updated by one.
+
+#ifndef FembCheckpoint_H
+#define FembCheckpoint_H
+
+#include <string>
+#include <map>
+#include <mutex>
+
+class FembCheckpoint {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+
+  enum Status { Missing, Done, Failed, Quarantined };
+
+  // Manifest entry for a job.
+  struct Entry {
+    Status status = Missing;
+    Index attempts = 0;     // Number of failed attempts
+    int error = 0;          // Status returned by the last failed attempt
+  };
+
+  // Ctor from the checkpoint directory, which is created if needed.
+  // An existing manifest is read.
+  explicit FembCheckpoint(Name dir ="checkpoint", Index maxAttempts =3);
+
+  // Set the maximum number of attempts for a job.
+  void setMaxAttempts(Index val) { m_maxAttempts = val; }
+
+  // Return if the directory and manifest are usable.
+  bool isValid() const { return m_valid; }
+
+  // Manifest entry for a job.
+  Entry entry(Name job) const;
+
+  // Return if a job is done.
+  bool isDone(Name job) const { return entry(job).status == Done; }
+
+  // Return if a job should be run: not done or quarantined and with
+  // fewer than maxAttempts failures.
+  bool shouldRun(Name job) const;
+
+  // Record the result of a job. Return 0 for success.
+  int setDone(Name job);
+  int setFailed(Name job, int error);
+  int setQuarantined(Name job, int error, Name path ="");
+
+  // Write or read a result record. Return 0 for success.
+  int writeRecord(Name name, const Name& text) const;
+  int readRecord(Name name, Name& text) const;
+
+  // Write a file atomically. Returns 0 for success.
+  static int writeAtomic(Name fname, const Name& text);
+
+  // Display the manifest.
+  void print() const;
+
+  // Getters.
+  Name dirName() const { return m_dir; }
+  Name manifestName() const { return m_dir + "/manifest.txt"; }
+  Name quarantineName() const { return m_dir + "/quarantine.txt"; }
+  Name recordName(Name name) const;
+  Index maxAttempts() const { return m_maxAttempts; }
+
+  // Status name.
+  static Name statusName(Status val);
+
+private:
+
+  // Read the manifest. Returns 0 for success.
+  int readManifest();
+
+  // Write the manifest. Called with m_mutex held.
+  int writeManifest() const;
+
+  Name m_dir;
+  Index m_maxAttempts;
+  bool m_valid;
+  mutable std::mutex m_mutex;
+  std::map<Name, Entry> m_entries;
+  std::map<Name, Name> m_quarantine;
+
+};
+
+#endif
@@ -0,0 +1,264 @@
+// FembColumnReader.cxx
+
+#include "FembColumnReader.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstring>
+#include <zlib.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::ifstream;
+
+using Index = FembColumnReader::Index;
+using Name = FembColumnReader::Name;
+using OffsetVector = FembColumnReader::OffsetVector;
+using FileHeader = FembColumnWriter::FileHeader;
+using FooterHeader = FembColumnWriter::FooterHeader;
+using Trailer = FembColumnWriter::Trailer;
+
+//**********************************************************************
+
+FembColumnReader::FembColumnReader(Name fname)
+: m_fileName(fname), m_valid(false), m_nrow(0) {
+  const string myname = "FembColumnReader::ctor: ";
+  int rstat = readFooter();
+  if ( rstat ) {
+    cout << myname << "Unable to open " << fname << " (error " << rstat << ")" << endl;
+    m_cols.clear();
+    m_groupRows.clear();
+    m_blocks.clear();
+    m_nrow = 0;
+    return;
+  }
+  m_valid = true;
+}
+
+//**********************************************************************
+
+Name FembColumnReader::columnName(Index icol) const {
+  return icol < m_cols.size() ? Name(m_cols[icol].name) : "";
+}
+
+//**********************************************************************
+
+uint32_t FembColumnReader::columnType(Index icol) const {
+  return icol < m_cols.size() ? m_cols[icol].type : 0;
+}
+
+//**********************************************************************
+
+bool FembColumnReader::isJagged(Index icol) const {
+  return icol < m_cols.size() && m_cols[icol].jagged;
+}
+
+//**********************************************************************
+
+Index FembColumnReader::find(Name name) const {
+  for ( Index icol=0; icol<m_cols.size(); ++icol ) {
+    if ( name == m_cols[icol].name ) return icol;
+  }
+  return FembColumnWriter::badIndex();
+}
+
+//**********************************************************************
+
+int FembColumnReader::read(Name name, vector<int>& vals, OffsetVector* poffs) const {
+  return readTyped(name, FembColumnWriter::Int32, vals, poffs);
+}
+
+int FembColumnReader::read(Name name, vector<unsigned int>& vals, OffsetVector* poffs) const {
+  return readTyped(name, FembColumnWriter::UInt32, vals, poffs);
+}
+
+int FembColumnReader::read(Name name, vector<float>& vals, OffsetVector* poffs) const {
+  return readTyped(name, FembColumnWriter::Float32, vals, poffs);
+}
+
+int FembColumnReader::read(Name name, vector<short>& vals, OffsetVector* poffs) const {
+  return readTyped(name, FembColumnWriter::Int16, vals, poffs);
+}
+
+int FembColumnReader::read(Name name, vector<unsigned char>& vals, OffsetVector* poffs) const {
+  return readTyped(name, FembColumnWriter::Bool8, vals, poffs);
+}
+
+//**********************************************************************
+
+void FembColumnReader::print() const {
+  cout << "Column file " << m_fileName;
+  if ( ! isOpen() ) {
+    cout << " is not open." << endl;
+    return;
+  }
+  cout << " has " << m_nrow << " rows in " << groupCount() << " groups." << endl;
+  Index ncol = columnCount();
+  for ( Index icol=0; icol<ncol; ++icol ) {
+    uint64_t nraw = 0;
+    uint64_t nzip = 0;
+    for ( Index igrp=0; igrp<groupCount(); ++igrp ) {
+      for ( Index iblk=0; iblk<2; ++iblk ) {
+        const BlockRecord& rec = m_blocks[2*(igrp*ncol + icol) + iblk];
+        nraw += rec.rawSize;
+        nzip += rec.size;
+      }
+    }
+    cout << setw(4) << icol << ": " << std::left << setw(8) << columnName(icol)
+         << setw(6) << FembColumnWriter::typeName(columnType(icol)) << std::right
+         << (isJagged(icol) ? " []" : "   ")
+         << setw(12) << nraw << " bytes" << setw(12) << nzip << " stored" << endl;
+  }
+}
+
+//**********************************************************************
+
+int FembColumnReader::readFooter() {
+  ifstream fin(m_fileName.c_str(), std::ios_base::binary);
+  if ( ! fin ) return 1;
+  fin.seekg(0, std::ios_base::end);
+  uint64_t fileSize = fin.tellg();
+  if ( fileSize < sizeof(FileHeader) + sizeof(FooterHeader) + sizeof(Trailer) ) return 2;
+  FileHeader hdr;
+  fin.seekg(0);
+  fin.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+  if ( ! fin ) return 3;
+  if ( memcmp(hdr.magic, "FEMBCOLS", 8) ) return 4;
+  if ( hdr.version != FembColumnWriter::version() ) return 5;
+  if ( hdr.headerSize != sizeof(FileHeader) ) return 6;
+  Trailer trl;
+  fin.seekg(fileSize - sizeof(Trailer));
+  fin.read(reinterpret_cast<char*>(&trl), sizeof(trl));
+  if ( ! fin ) return 7;
+  if ( memcmp(trl.magic, "FEMBCOLF", 8) ) return 8;
+  if ( trl.version != FembColumnWriter::version() ) return 9;
+  if ( trl.footerOffset < sizeof(FileHeader) ) return 10;
+  if ( trl.footerOffset + trl.footerSize + sizeof(Trailer) != fileSize ) return 10;
+  FooterHeader fhdr;
+  fin.seekg(trl.footerOffset);
+  fin.read(reinterpret_cast<char*>(&fhdr), sizeof(fhdr));
+  if ( ! fin ) return 11;
+  uint64_t expSize = sizeof(FooterHeader) + uint64_t(fhdr.ncol)*sizeof(ColumnRecord) +
+                     uint64_t(fhdr.ngroup)*sizeof(uint64_t) +
+                     2*uint64_t(fhdr.ngroup)*fhdr.ncol*sizeof(BlockRecord);
+  if ( trl.footerSize != expSize ) return 12;
+  m_cols.resize(fhdr.ncol);
+  m_groupRows.resize(fhdr.ngroup);
+  m_blocks.resize(2*uint64_t(fhdr.ngroup)*fhdr.ncol);
+  fin.read(reinterpret_cast<char*>(m_cols.data()), m_cols.size()*sizeof(ColumnRecord));
+  fin.read(reinterpret_cast<char*>(m_groupRows.data()), m_groupRows.size()*sizeof(uint64_t));
+  fin.read(reinterpret_cast<char*>(m_blocks.data()), m_blocks.size()*sizeof(BlockRecord));
+  if ( ! fin ) return 13;
+  for ( ColumnRecord& col : m_cols ) {
+    col.name[sizeof(col.name) - 1] = '\0';
+    if ( FembColumnWriter::typeSize(col.type) == 0 ) return 14;
+  }
+  m_nrow = 0;
+  for ( uint64_t nrow : m_groupRows ) m_nrow += nrow;
+  if ( m_nrow != fhdr.nrow ) return 15;
+  for ( const BlockRecord& rec : m_blocks ) {
+    if ( rec.size == 0 ) continue;
+    if ( rec.offset < sizeof(FileHeader) ) return 16;
+    if ( rec.offset + rec.size > trl.footerOffset ) return 16;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+int FembColumnReader::readBlock(const BlockRecord& rec, vector<char>& buf) const {
+  buf.resize(rec.rawSize);
+  if ( rec.rawSize == 0 ) return 0;
+  ifstream fin(m_fileName.c_str(), std::ios_base::binary);
+  if ( ! fin ) return 1;
+  fin.seekg(rec.offset);
+  if ( rec.codec == FembColumnWriter::NoCodec ) {
+    if ( rec.size != rec.rawSize ) return 2;
+    fin.read(buf.data(), rec.size);
+    return fin ? 0 : 3;
+  }
+  if ( rec.codec != FembColumnWriter::Zlib ) return 4;
+  vector<char> zbuf(rec.size);
+  fin.read(zbuf.data(), rec.size);
+  if ( ! fin ) return 3;
+  uLongf nout = rec.rawSize;
+  int zstat = uncompress(reinterpret_cast<Bytef*>(buf.data()), &nout,
+                         reinterpret_cast<const Bytef*>(zbuf.data()), rec.size);
+  if ( zstat != Z_OK || nout != rec.rawSize ) return 5;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembColumnReader::
+readColumn(Name name, uint32_t type, vector<char>& bytes, OffsetVector* poffs) const {
+  const string myname = "FembColumnReader::read: ";
+  bytes.clear();
+  if ( poffs != nullptr ) poffs->clear();
+  if ( ! isOpen() ) return 1;
+  Index icol = find(name);
+  if ( icol == FembColumnWriter::badIndex() ) {
+    cout << myname << "Column not found: " << name << endl;
+    return 2;
+  }
+  const ColumnRecord& col = m_cols[icol];
+  if ( col.type != type ) {
+    cout << myname << "Column " << name << " has type "
+         << FembColumnWriter::typeName(col.type) << endl;
+    return 3;
+  }
+  if ( col.jagged && poffs == nullptr ) {
+    cout << myname << "Offsets are required for jagged column " << name << endl;
+    return 4;
+  }
+  Index tsiz = FembColumnWriter::typeSize(type);
+  Index ncol = columnCount();
+  vector<char> buf;
+  if ( col.jagged ) poffs->push_back(0);
+  for ( Index igrp=0; igrp<groupCount(); ++igrp ) {
+    const BlockRecord& vrec = m_blocks[2*(igrp*ncol + icol)];
+    const BlockRecord& orec = m_blocks[2*(igrp*ncol + icol) + 1];
+    if ( readBlock(vrec, buf) || buf.size() != uint64_t(vrec.count)*tsiz ) {
+      cout << myname << "Unable to read group " << igrp << " of column " << name << endl;
+      return 5;
+    }
+    uint64_t nvalPrev = bytes.size()/tsiz;
+    bytes.insert(bytes.end(), buf.begin(), buf.end());
+    if ( col.jagged ) {
+      uint64_t nrow = m_groupRows[igrp];
+      if ( readBlock(orec, buf) || orec.count != nrow + 1 ||
+           buf.size() != (nrow + 1)*sizeof(uint32_t) ) {
+        cout << myname << "Unable to read offsets for group " << igrp << " of column " << name << endl;
+        return 6;
+      }
+      const uint32_t* poff = reinterpret_cast<const uint32_t*>(buf.data());
+      if ( poff[0] != 0 || poff[nrow] != vrec.count ) return 7;
+      for ( uint64_t irow=1; irow<=nrow; ++irow ) {
+        if ( poff[irow] < poff[irow-1] ) return 7;
+        poffs->push_back(nvalPrev + poff[irow]);
+      }
+    } else if ( vrec.count != m_groupRows[igrp] ) {
+      return 8;
+    }
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+template<typename T>
+int FembColumnReader::
+readTyped(Name name, uint32_t type, vector<T>& vals, OffsetVector* poffs) const {
+  vals.clear();
+  vector<char> bytes;
+  int rstat = readColumn(name, type, bytes, poffs);
+  if ( rstat ) return rstat;
+  vals.resize(bytes.size()/sizeof(T));
+  if ( bytes.size() ) memcpy(vals.data(), bytes.data(), bytes.size());
+  return 0;
+}
+
+//**********************************************************************
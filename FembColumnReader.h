@@ -0,0 +1,85 @@
+// FembColumnReader.h
+//
+// Reads a columnar file written with FembColumnWriter.
+//
+// Only the footer is read when the file is opened. Reading a column reads
+// and decompresses just the blocks for that column, so a scan of a few
+// columns does not touch the others.
+//
+// Columns are read whole. For a jagged column, offsets has one more entry
+// than the number of rows and the values for row irow are
+// vals[offsets[irow]] ... vals[offsets[irow+1]-1].
+
+#ifndef FembColumnReader_H
+#define FembColumnReader_H
+
+#include "FembColumnWriter.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class FembColumnReader {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using OffsetVector = std::vector<uint64_t>;
+
+  // Ctor from file name.
+  explicit FembColumnReader(Name fname);
+
+  // Return if the file was opened and its footer is valid.
+  bool isOpen() const { return m_valid; }
+
+  // Getters.
+  Name fileName() const { return m_fileName; }
+  uint64_t size() const { return m_nrow; }
+  Index columnCount() const { return m_cols.size(); }
+  Index groupCount() const { return m_groupRows.size(); }
+  Name columnName(Index icol) const;
+  uint32_t columnType(Index icol) const;
+  bool isJagged(Index icol) const;
+
+  // Return the index of a column or FembColumnWriter::badIndex().
+  Index find(Name name) const;
+
+  // Read a column. The value type must match the column type (bool columns
+  // are read as unsigned char). For jagged columns, poffs must be supplied
+  // and is filled with the row offsets. Returns 0 for success.
+  int read(Name name, std::vector<int>& vals, OffsetVector* poffs =nullptr) const;
+  int read(Name name, std::vector<unsigned int>& vals, OffsetVector* poffs =nullptr) const;
+  int read(Name name, std::vector<float>& vals, OffsetVector* poffs =nullptr) const;
+  int read(Name name, std::vector<short>& vals, OffsetVector* poffs =nullptr) const;
+  int read(Name name, std::vector<unsigned char>& vals, OffsetVector* poffs =nullptr) const;
+
+  // Display the columns and sizes.
+  void print() const;
+
+private:
+
+  using ColumnRecord = FembColumnWriter::ColumnRecord;
+  using BlockRecord = FembColumnWriter::BlockRecord;
+
+  // Read the footer. Returns 0 for success.
+  int readFooter();
+
+  // Read and decompress a block into buf. Returns 0 for success.
+  int readBlock(const BlockRecord& rec, std::vector<char>& buf) const;
+
+  // Read all values of a column as bytes. Returns 0 for success.
+  int readColumn(Name name, uint32_t type, std::vector<char>& bytes, OffsetVector* poffs) const;
+
+  template<typename T>
+  int readTyped(Name name, uint32_t type, std::vector<T>& vals, OffsetVector* poffs) const;
+
+  Name m_fileName;
+  bool m_valid;
+  uint64_t m_nrow;
+  std::vector<ColumnRecord> m_cols;
+  std::vector<uint64_t> m_groupRows;
+  std::vector<BlockRecord> m_blocks;
+
+};
+
+#endif
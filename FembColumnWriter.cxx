@@ -0,0 +1,306 @@
+// FembColumnWriter.cxx
+
+#include "FembColumnWriter.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <zlib.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using std::ostringstream;
+
+using Index = FembColumnWriter::Index;
+using Name = FembColumnWriter::Name;
+using FileHeader = FembColumnWriter::FileHeader;
+using FooterHeader = FembColumnWriter::FooterHeader;
+using ColumnRecord = FembColumnWriter::ColumnRecord;
+using BlockRecord = FembColumnWriter::BlockRecord;
+using Trailer = FembColumnWriter::Trailer;
+
+static_assert(sizeof(FileHeader) == 16, "Unexpected FembColumnWriter header size.");
+static_assert(sizeof(ColumnRecord) == 32, "Unexpected FembColumnWriter column record size.");
+static_assert(sizeof(BlockRecord) == 32, "Unexpected FembColumnWriter block record size.");
+static_assert(sizeof(Trailer) == 32, "Unexpected FembColumnWriter trailer size.");
+
+//**********************************************************************
+
+Index FembColumnWriter::typeSize(uint32_t type) {
+  if ( type == Int32 ) return 4;
+  if ( type == UInt32 ) return 4;
+  if ( type == Float32 ) return 4;
+  if ( type == Int16 ) return 2;
+  if ( type == Bool8 ) return 1;
+  return 0;
+}
+
+//**********************************************************************
+
+Name FembColumnWriter::typeName(uint32_t type) {
+  if ( type == Int32 ) return "int";
+  if ( type == UInt32 ) return "uint";
+  if ( type == Float32 ) return "float";
+  if ( type == Int16 ) return "short";
+  if ( type == Bool8 ) return "bool";
+  return "invalid";
+}
+
+//**********************************************************************
+
+FembColumnWriter::FembColumnWriter(Name fname, Index groupSize, int level)
+: m_fileName(fname), m_groupSize(groupSize), m_level(level),
+  m_nrow(0), m_nrowGroup(0), m_nerr(0) {
+  const string myname = "FembColumnWriter::ctor: ";
+  if ( m_groupSize == 0 ) m_groupSize = 1;
+  ostringstream sstmp;
+  sstmp << fname << ".tmp" << getpid();
+  m_tmpName = sstmp.str();
+  m_fout.open(m_tmpName.c_str(), std::ios_base::binary | std::ios_base::trunc);
+  if ( ! m_fout ) {
+    cout << myname << "Unable to open " << m_tmpName << endl;
+    return;
+  }
+  FileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "FEMBCOLS", 8);
+  hdr.version = version();
+  hdr.headerSize = sizeof(FileHeader);
+  m_fout.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+}
+
+//**********************************************************************
+
+FembColumnWriter::~FembColumnWriter() {
+  if ( isOpen() ) close();
+}
+
+//**********************************************************************
+
+Index FembColumnWriter::addColumn(Name name, Type type, bool jagged) {
+  const string myname = "FembColumnWriter::addColumn: ";
+  if ( size() || m_groupRows.size() ) {
+    cout << myname << "Columns cannot be added after the first row." << endl;
+    return badIndex();
+  }
+  if ( name.size() == 0 || name.size() >= sizeof(ColumnRecord::name) ) {
+    cout << myname << "Invalid column name: " << name << endl;
+    return badIndex();
+  }
+  if ( typeSize(type) == 0 ) {
+    cout << myname << "Invalid type for column " << name << endl;
+    return badIndex();
+  }
+  for ( const Column& col : m_cols ) {
+    if ( col.name == name ) {
+      cout << myname << "Duplicate column name: " << name << endl;
+      return badIndex();
+    }
+  }
+  Column col;
+  col.name = name;
+  col.type = type;
+  col.jagged = jagged;
+  col.isSet = false;
+  if ( jagged ) col.offsets.push_back(0);
+  m_cols.push_back(col);
+  return m_cols.size() - 1;
+}
+
+//**********************************************************************
+
+int FembColumnWriter::set(Index icol, int val) {
+  return append(icol, Int32, false, &val, 1);
+}
+
+int FembColumnWriter::set(Index icol, unsigned int val) {
+  return append(icol, UInt32, false, &val, 1);
+}
+
+int FembColumnWriter::set(Index icol, float val) {
+  return append(icol, Float32, false, &val, 1);
+}
+
+int FembColumnWriter::set(Index icol, bool val) {
+  uint8_t bval = val;
+  return append(icol, Bool8, false, &bval, 1);
+}
+
+int FembColumnWriter::set(Index icol, const vector<float>& vals) {
+  return append(icol, Float32, true, vals.data(), vals.size());
+}
+
+int FembColumnWriter::set(Index icol, const vector<short>& vals) {
+  return append(icol, Int16, true, vals.data(), vals.size());
+}
+
+//**********************************************************************
+
+int FembColumnWriter::endRow() {
+  const string myname = "FembColumnWriter::endRow: ";
+  if ( ! isOpen() ) return 1;
+  for ( const Column& col : m_cols ) {
+    if ( ! col.isSet ) {
+      cout << myname << "Column " << col.name << " was not set. Row is dropped." << endl;
+      ++m_nerr;
+      discardRow();
+      return 2;
+    }
+  }
+  for ( Column& col : m_cols ) {
+    if ( col.jagged ) col.offsets.push_back(col.values.size()/typeSize(col.type));
+    col.isSet = false;
+  }
+  ++m_nrowGroup;
+  if ( m_nrowGroup >= m_groupSize ) return flush();
+  return 0;
+}
+
+//**********************************************************************
+
+int FembColumnWriter::flush() {
+  const string myname = "FembColumnWriter::flush: ";
+  if ( ! isOpen() ) return 1;
+  if ( m_nrowGroup == 0 ) return 0;
+  for ( Column& col : m_cols ) {
+    BlockRecord vrec;
+    BlockRecord orec;
+    memset(&orec, 0, sizeof(orec));
+    uint32_t nval = col.values.size()/typeSize(col.type);
+    if ( writeBlock(col.values.data(), col.values.size(), nval, vrec) ) {
+      cout << myname << "Error writing column " << col.name << endl;
+      ++m_nerr;
+      return 2;
+    }
+    if ( col.jagged ) {
+      const char* poff = reinterpret_cast<const char*>(col.offsets.data());
+      if ( writeBlock(poff, col.offsets.size()*sizeof(uint32_t), col.offsets.size(), orec) ) {
+        cout << myname << "Error writing offsets for column " << col.name << endl;
+        ++m_nerr;
+        return 3;
+      }
+    }
+    m_blocks.push_back(vrec);
+    m_blocks.push_back(orec);
+    col.values.clear();
+    col.offsets.clear();
+    if ( col.jagged ) col.offsets.push_back(0);
+    col.isSet = false;
+  }
+  m_groupRows.push_back(m_nrowGroup);
+  m_nrow += m_nrowGroup;
+  m_nrowGroup = 0;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembColumnWriter::close() {
+  const string myname = "FembColumnWriter::close: ";
+  if ( ! isOpen() ) return 1;
+  int rstat = flush();
+  FooterHeader fhdr;
+  fhdr.ncol = m_cols.size();
+  fhdr.ngroup = m_groupRows.size();
+  fhdr.nrow = m_nrow;
+  Trailer trl;
+  memset(&trl, 0, sizeof(trl));
+  trl.footerOffset = m_fout.tellp();
+  m_fout.write(reinterpret_cast<const char*>(&fhdr), sizeof(fhdr));
+  for ( const Column& col : m_cols ) {
+    ColumnRecord crec;
+    memset(&crec, 0, sizeof(crec));
+    strncpy(crec.name, col.name.c_str(), sizeof(crec.name) - 1);
+    crec.type = col.type;
+    crec.jagged = col.jagged;
+    m_fout.write(reinterpret_cast<const char*>(&crec), sizeof(crec));
+  }
+  m_fout.write(reinterpret_cast<const char*>(m_groupRows.data()),
+               m_groupRows.size()*sizeof(uint64_t));
+  m_fout.write(reinterpret_cast<const char*>(m_blocks.data()),
+               m_blocks.size()*sizeof(BlockRecord));
+  trl.footerSize = uint64_t(m_fout.tellp()) - trl.footerOffset;
+  trl.version = version();
+  memcpy(trl.magic, "FEMBCOLF", 8);
+  m_fout.write(reinterpret_cast<const char*>(&trl), sizeof(trl));
+  m_fout.close();
+  if ( rstat == 0 && ! m_fout.fail() ) {
+    if ( rename(m_tmpName.c_str(), m_fileName.c_str()) == 0 ) {
+      cout << myname << "Wrote " << m_nrow << " rows to " << m_fileName << endl;
+      return 0;
+    }
+    rstat = 4;
+  } else if ( rstat == 0 ) {
+    rstat = 5;
+  }
+  cout << myname << "Unable to write " << m_fileName << endl;
+  unlink(m_tmpName.c_str());
+  return rstat;
+}
+
+//**********************************************************************
+
+int FembColumnWriter::
+append(Index icol, Type type, bool jagged, const void* pval, Index nval) {
+  const string myname = "FembColumnWriter::set: ";
+  if ( icol >= m_cols.size() ) {
+    cout << myname << "Invalid column index: " << icol << endl;
+    ++m_nerr;
+    return 1;
+  }
+  Column& col = m_cols[icol];
+  if ( col.type != type || col.jagged != jagged ) {
+    cout << myname << "Value does not match column " << col.name << endl;
+    ++m_nerr;
+    return 2;
+  }
+  if ( col.isSet ) {
+    cout << myname << "Column " << col.name << " is already set in this row." << endl;
+    ++m_nerr;
+    return 3;
+  }
+  const char* pdat = static_cast<const char*>(pval);
+  if ( nval ) col.values.insert(col.values.end(), pdat, pdat + nval*typeSize(type));
+  col.isSet = true;
+  return 0;
+}
+
+//**********************************************************************
+
+void FembColumnWriter::discardRow() {
+  for ( Column& col : m_cols ) {
+    Index nval = col.jagged ? col.offsets.back() : m_nrowGroup;
+    col.values.resize(nval*typeSize(col.type));
+    col.isSet = false;
+  }
+}
+
+//**********************************************************************
+
+int FembColumnWriter::
+writeBlock(const char* pdat, uint64_t nbyte, uint32_t count, BlockRecord& rec) {
+  rec.offset = m_fout.tellp();
+  rec.rawSize = nbyte;
+  rec.count = count;
+  rec.codec = NoCodec;
+  rec.size = nbyte;
+  if ( m_level > 0 && nbyte > 0 ) {
+    uLongf nzip = compressBound(nbyte);
+    vector<Bytef> zbuf(nzip);
+    int zstat = compress2(zbuf.data(), &nzip, reinterpret_cast<const Bytef*>(pdat),
+                          nbyte, m_level);
+    if ( zstat == Z_OK && nzip < nbyte ) {
+      rec.codec = Zlib;
+      rec.size = nzip;
+      m_fout.write(reinterpret_cast<const char*>(zbuf.data()), nzip);
+      return m_fout.fail() ? 1 : 0;
+    }
+  }
+  if ( nbyte ) m_fout.write(pdat, nbyte);
+  return m_fout.fail() ? 1 : 0;
+}
+
+//**********************************************************************
@@ -0,0 +1,173 @@
+// FembColumnWriter.h
+//
+// Writes a flat columnar file: a table with one row for each entry and a
+// fixed set of named columns. It is used to export the pulse and tickmod
+// trees so that per-channel aggregates can be computed by reading only
+// the needed columns. Files are read with FembColumnReader.
+//
+// Each column holds scalars of one type or, if jagged, a variable-length
+// array of that type in each row. A jagged column is stored as row offsets
+// and the concatenated values.
+//
+// Rows are buffered and written in groups of groupSize rows. In each group,
+// every column has a value block and jagged columns also have an offset
+// block. Blocks are compressed independently with zlib (unless that does
+// not reduce the size) so a reader can decompress just the columns it uses.
+//
+// File layout (version 1, native byte order):
+//   FileHeader     magic "FEMBCOLS", version, header size
+//   blocks         value and offset blocks for each group and column
+//   footer         FooterHeader, ColumnRecord[ncol], uint64 rows[ngroup],
+//                  BlockRecord[ngroup][ncol][2] (values, offsets)
+//   Trailer        footer offset and size, version, magic "FEMBCOLF"
+// Jagged offsets in a block are uint32 counted from the start of the group.
+//
+// The file is written under a temporary name and renamed when it is
+// closed, so an existing file of that name is only replaced by a complete
+// one.
+
+#ifndef FembColumnWriter_H
+#define FembColumnWriter_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+class FembColumnWriter {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+
+  // Column value types.
+  enum Type { Int32 =1, UInt32 =2, Float32 =3, Int16 =4, Bool8 =5 };
+
+  // Block compression.
+  enum Codec { NoCodec =0, Zlib =1 };
+
+  // File format version.
+  static uint32_t version() { return 1; }
+
+  // Index returned for an invalid column.
+  static Index badIndex() { return Index(-1); }
+
+  // Size in bytes and name of a type. Size is 0 for an invalid type.
+  static Index typeSize(uint32_t type);
+  static Name typeName(uint32_t type);
+
+  // Ctor from file name.
+  //   groupSize - number of rows in each group
+  //   level - zlib compression level (0 for no compression)
+  FembColumnWriter(Name fname, Index groupSize =65536, int level =1);
+
+  // Dtor. Closes the file.
+  ~FembColumnWriter();
+
+  // Delete copy and assignment.
+  FembColumnWriter(const FembColumnWriter&) =delete;
+  FembColumnWriter& operator=(const FembColumnWriter&) =delete;
+
+  // Add a column. All columns must be added before the first row.
+  // Returns the column index or badIndex().
+  Index addColumn(Name name, Type type, bool jagged =false);
+
+  // Set the value of a column in the current row. The value must match the
+  // column type and jaggedness. Returns 0 for success.
+  int set(Index icol, int val);
+  int set(Index icol, unsigned int val);
+  int set(Index icol, float val);
+  int set(Index icol, bool val);
+  int set(Index icol, const std::vector<float>& vals);
+  int set(Index icol, const std::vector<short>& vals);
+
+  // End the current row. Every column must have been set. Otherwise the
+  // row is dropped and an error is returned. Returns 0 for success.
+  int endRow();
+
+  // Write the buffered rows as a group. Returns 0 for success.
+  int flush();
+
+  // Write the remaining rows and footer and rename the file.
+  // Returns 0 for success.
+  int close();
+
+  // Getters.
+  bool isOpen() const { return m_fout.is_open(); }
+  Name fileName() const { return m_fileName; }
+  Index columnCount() const { return m_cols.size(); }
+  uint64_t size() const { return m_nrow + m_nrowGroup; }
+  Index errorCount() const { return m_nerr; }    // # rejected values and rows
+
+public:
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+  };
+
+  struct FooterHeader {
+    uint32_t ncol;
+    uint32_t ngroup;
+    uint64_t nrow;
+  };
+
+  struct ColumnRecord {
+    char name[24];
+    uint32_t type;
+    uint32_t jagged;
+  };
+
+  struct BlockRecord {
+    uint64_t offset;     // Position in the file
+    uint64_t size;       // Size in the file
+    uint64_t rawSize;    // Size after decompression
+    uint32_t codec;
+    uint32_t count;      // Number of values
+  };
+
+  struct Trailer {
+    uint64_t footerOffset;
+    uint64_t footerSize;
+    uint32_t version;
+    uint32_t reserved;
+    char magic[8];
+  };
+
+private:
+
+  struct Column {
+    Name name;
+    Type type;
+    bool jagged;
+    bool isSet;
+    std::vector<char> values;
+    std::vector<uint32_t> offsets;
+  };
+
+  // Append values to a column in the current row.
+  int append(Index icol, Type type, bool jagged, const void* pval, Index nval);
+
+  // Drop the values set in the current row.
+  void discardRow();
+
+  // Write a block and return its record.
+  int writeBlock(const char* pdat, uint64_t nbyte, uint32_t count, BlockRecord& rec);
+
+  Name m_fileName;
+  Name m_tmpName;
+  std::ofstream m_fout;
+  Index m_groupSize;
+  int m_level;
+  std::vector<Column> m_cols;
+  std::vector<uint64_t> m_groupRows;
+  std::vector<BlockRecord> m_blocks;
+  uint64_t m_nrow;
+  Index m_nrowGroup;
+  Index m_nerr;
+
+};
+
+#endif
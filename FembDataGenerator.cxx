@@ -0,0 +1,260 @@
+// FembDataGenerator.cxx
+
+#include "FembDataGenerator.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TDirectory.h"
+#include "TSystem.h"
+#include "TRandom3.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::setfill;
+using std::ofstream;
+using std::ostringstream;
+using std::vector;
+
+using Index = FembDataGenerator::Index;
+using Name = FembDataGenerator::Name;
+using Dataset = FembDataGenerator::Dataset;
+
+//**********************************************************************
+
+FembDataGenerator::FembDataGenerator(const Config& cfg) : m_cfg(cfg) { }
+
+//**********************************************************************
+
+int FembDataGenerator::writeFile(Name fname, const Dataset& ds) const {
+  const string myname = "FembDataGenerator::writeFile: ";
+  const Config& cfg = m_cfg;
+  if ( cfg.nChannel == 0 || cfg.nEvent == 0 || cfg.nTick == 0 || cfg.period < 2 ) {
+    cout << myname << "Invalid configuration." << endl;
+    return 1;
+  }
+  if ( cfg.nChannel > 0xffff || cfg.nEvent > 0xffff ) {
+    cout << myname << "Too many channels or events." << endl;
+    return 1;
+  }
+  TRandom3 rng(seed(ds));
+  // Channel pedestals and gains.
+  Index ncha = cfg.nChannel;
+  vector<float> peds(ncha);
+  vector<float> gains(ncha);
+  for ( Index icha=0; icha<ncha; ++icha ) {
+    peds[icha] = cfg.pedestal + cfg.pedestalSpread*rng.Gaus();
+    gains[icha] = adcPerFc(ds.gain)*(1.0 + cfg.gainSpread*rng.Gaus());
+  }
+  // Pulse shape for one period.
+  Index per = cfg.period;
+  Index perHalf = per/2;
+  double tp = peakingTicks(ds.shap);
+  vector<float> shape(per, 0.0);
+  for ( Index itck=0; itck<per; ++itck ) {
+    double x = itck/tp;
+    shape[itck] = pow(x, 4)*exp(4.0*(1.0 - x));
+  }
+  TDirectory* pdirSave = gDirectory;
+  TFile* pfile = TFile::Open(fname.c_str(), "RECREATE");
+  if ( pfile == nullptr || ! pfile->IsOpen() ) {
+    cout << myname << "Unable to open " << fname << endl;
+    delete pfile;
+    if ( pdirSave != nullptr ) pdirSave->cd();
+    return 2;
+  }
+  pfile->cd();
+  TTree* ptree = new TTree("femb_wfdata", "Synthetic FEMB waveforms");
+  UShort_t subrun = 0;
+  UShort_t chan = 0;
+  vector<unsigned short> wf(cfg.nTick);
+  ptree->Branch("subrun", &subrun, "subrun/s");
+  ptree->Branch("chan", &chan, "chan/s");
+  ptree->Branch("wf", &wf);
+  vector<float> sig(cfg.nTick);
+  for ( Index ievt=0; ievt<cfg.nEvent; ++ievt ) {
+    double qfc = 0.0;
+    if ( ievt >= cfg.firstPulseEvent ) qfc = (ievt - cfg.firstPulseEvent + 1)*cfg.chargeStep;
+    // Unit-gain signal for this event.
+    for ( Index itck=0; itck<cfg.nTick; ++itck ) {
+      Index iph = (itck + per - cfg.pulseOffset%per)%per;
+      Index iphNeg = (iph + per - perHalf)%per;
+      sig[itck] = qfc*(shape[iph] - shape[iphNeg]);
+    }
+    for ( Index icha=0; icha<ncha; ++icha ) {
+      subrun = ievt;
+      chan = icha;
+      bool dead = isDead(icha);
+      for ( Index itck=0; itck<cfg.nTick; ++itck ) {
+        float adc = peds[icha];
+        if ( ! dead ) {
+          float sigadc = gains[icha]*sig[itck];
+          if ( cfg.signalMax > 0.0 ) {
+            if ( sigadc > cfg.signalMax ) sigadc = cfg.signalMax;
+            if ( sigadc < -cfg.signalMax ) sigadc = -cfg.signalMax;
+          }
+          adc += sigadc + cfg.noise*rng.Gaus();
+        }
+        int iadc = std::lround(adc);
+        if ( ! dead && cfg.stickyFraction > 0.0 ) {
+          int mod = iadc%64;
+          int dlo = mod;
+          int dhi = 63 - mod;
+          if ( (dlo > 0 && dlo <= int(cfg.stickyRange)) || (dhi > 0 && dhi <= int(cfg.stickyRange)) ) {
+            if ( rng.Rndm() < cfg.stickyFraction ) iadc += dlo <= dhi ? -dlo : dhi;
+          }
+        }
+        if ( iadc < 0 ) iadc = 0;
+        if ( iadc > cfg.adcMax ) iadc = cfg.adcMax;
+        wf[itck] = iadc;
+      }
+      ptree->Fill();
+    }
+  }
+  pfile->Write();
+  pfile->Close();
+  delete pfile;
+  if ( pdirSave != nullptr ) pdirSave->cd();
+  return 0;
+}
+
+//**********************************************************************
+
+int FembDataGenerator::writeDataset(Name tsdir, const Dataset& ds) const {
+  const string myname = "FembDataGenerator::writeDataset: ";
+  Name dsdir = tsdir + "/" + datasetDirName(ds);
+  gSystem->mkdir(dsdir.c_str(), true);
+  Name fname = dsdir + "/" + datasetFileName(ds);
+  int rstat = writeFile(fname, ds);
+  if ( rstat == 0 ) cout << myname << "Wrote " << fname << endl;
+  return rstat;
+}
+
+//**********************************************************************
+
+Index FembDataGenerator::
+writeCampaign(Name topdir, const IndexVector& fembs,
+              const IndexVector& gains, const IndexVector& shaps,
+              bool doWarm, bool doCold, bool doExtPulse, bool doIntPulse,
+              Name wibdir) const {
+  const string myname = "FembDataGenerator::writeCampaign: ";
+  if ( gSystem->mkdir(topdir.c_str(), true) && gSystem->AccessPathName(topdir.c_str()) ) {
+    cout << myname << "Unable to create " << topdir << endl;
+    return 1;
+  }
+  vector<bool> temps;
+  if ( doWarm ) temps.push_back(false);
+  if ( doCold ) temps.push_back(true);
+  vector<bool> pulses;
+  if ( doExtPulse ) pulses.push_back(true);
+  if ( doIntPulse ) pulses.push_back(false);
+  Index nerr = 0;
+  ostringstream ssmap;
+  ssmap << " IDX              TS FEMB  AMB  MMB"
+        << "                                                ADCs  TEMP\n";
+  Index imap = 0;
+  for ( Index femb : fembs ) {
+    for ( bool isCold : temps ) {
+      Name ts = timestamp(femb, isCold);
+      Name tsdir = topdir + "/" + wibdir + "/" + ts;
+      for ( Index gain : gains ) {
+        for ( Index shap : shaps ) {
+          for ( bool extPulse : pulses ) {
+            Dataset ds;
+            ds.femb = femb;
+            ds.gain = gain;
+            ds.shap = shap;
+            ds.extPulse = extPulse;
+            ds.extClock = true;
+            ds.isCold = isCold;
+            if ( writeDataset(tsdir, ds) ) ++nerr;
+          }
+        }
+      }
+      ++imap;
+      ssmap << setw(3) << imap << "." << setw(16) << ts << setw(5) << femb
+            << setw(5) << 0 << setw(5) << 0 << "  [";
+      for ( Index iadc=0; iadc<8; ++iadc ) ssmap << setw(6) << 0;
+      ssmap << "]" << setw(6) << (isCold ? "cold" : "warm") << "\n";
+    }
+  }
+  Name mapName = topdir + "/fembjson.dat";
+  ofstream fout(mapName.c_str());
+  fout << ssmap.str();
+  if ( ! fout ) {
+    cout << myname << "Unable to write " << mapName << endl;
+    ++nerr;
+  }
+  return nerr;
+}
+
+//**********************************************************************
+
+Name FembDataGenerator::datasetDirName(const Dataset& ds) {
+  ostringstream ssdir;
+  ssdir << "fembTest_gainenc_test_g" << ds.gain << "_s" << ds.shap
+        << "_" << (ds.extPulse ? "extpulse" : "intpulse")
+        << (ds.extClock ? "" : "_intclock");
+  return ssdir.str();
+}
+
+//**********************************************************************
+
+Name FembDataGenerator::datasetFileName(const Dataset& ds) {
+  ostringstream ssnam;
+  ssnam << "gainMeasurement_femb_" << ds.femb << "-parseBinaryFile.root";
+  return ssnam.str();
+}
+
+//**********************************************************************
+
+Name FembDataGenerator::timestamp(Index femb, bool isCold) {
+  ostringstream ssts;
+  ssts << setfill('0') << "2018" << setw(2) << 1 + (femb/28)%12
+       << setw(2) << 1 + femb%28 << "T" << setw(2) << (isCold ? 14 : 10) << "0000";
+  return ssts.str();
+}
+
+//**********************************************************************
+
+double FembDataGenerator::adcPerFc(Index gain) {
+  // Preamp gain [mV/fC] as in FembTestAnalyzer::preampGain times 3 ADC/mV.
+  double gmv = gain==0 ?  4.7 :
+               gain==1 ?  7.8 :
+               gain==2 ? 14.0 :
+               gain==3 ? 25.0 : 0.0;
+  return 3.0*gmv;
+}
+
+//**********************************************************************
+
+double FembDataGenerator::peakingTicks(Index shap) {
+  // Shaping time [us] as in FembTestAnalyzer::shapingTime with 0.5 us ticks.
+  double tus = shap==0 ? 0.5 : shap < 4 ? shap : 1.0;
+  return 2.0*tus;
+}
+
+//**********************************************************************
+
+bool FembDataGenerator::isDead(Index icha) const {
+  const IndexVector& dead = m_cfg.deadChannels;
+  return std::find(dead.begin(), dead.end(), icha) != dead.end();
+}
+
+//**********************************************************************
+
+unsigned int FembDataGenerator::seed(const Dataset& ds) const {
+  unsigned int val = m_cfg.seed;
+  val = 1000003*val + ds.femb;
+  val = 1000003*val + 16*ds.gain + ds.shap;
+  val = 1000003*val + 4*ds.isCold + 2*ds.extPulse + ds.extClock;
+  return val;
+}
+
+//**********************************************************************
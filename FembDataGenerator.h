@@ -0,0 +1,126 @@
+// FembDataGenerator.h
+//
+// Writes synthetic FEMB gain test data in the format read by DuneFembReader
+// and found by DuneFembFinder so the analysis can be tested and
+// benchmarked without the test-stand data.
+//
+// Each dataset is a file with the tree femb_wfdata holding one entry for
+// each event (subrun) and channel in that order with branches
+//   subrun - event index
+//   chan   - channel
+//   wf     - raw ADC waveform
+//
+// In each event, the pulser charge is (ievt - firstPulseEvent + 1)*chargeStep
+// (zero for earlier events). Each period holds a positive pulse at
+// pulseOffset and a negative pulse half a period later with the shape
+// (t/tp)^4 exp(4(1 - t/tp)), where tp is the peaking time. The pulse
+// height in ADC counts is the charge times the nominal preamp gain
+// (FembTestAnalyzer::preampGain), the ADC gain (3 ADC/mV) and a channel
+// gain factor. The defaults match the internal pulser; the external
+// pulser is close to chargeStep = 3.47 fC with firstPulseEvent = 2.
+//
+// Pedestals vary by channel and Gaussian noise is added to each sample.
+// Sticky codes are emulated by moving samples whose code%64 is within
+// stickyRange of 0 or 63 to that code with probability stickyFraction.
+// Signals may be clipped at signalMax above pedestal (preamp saturation)
+// and samples are clipped to the ADC range. Dead channels have a constant
+// pedestal with no noise or signal.
+//
+// writeCampaign writes a directory tree that DuneFembFinder can search:
+//   TOPDIR/fembjson.dat
+//   TOPDIR/WIBDIR/TS/fembTest_gainenc_test_gG_sS_{ext,int}pulse[_intclock]/
+//     gainMeasurement_femb_F-parseBinaryFile.root
+// Output is reproducible for a given configuration and seed.
+
+#ifndef FembDataGenerator_H
+#define FembDataGenerator_H
+
+#include <string>
+#include <vector>
+
+class FembDataGenerator {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using IndexVector = std::vector<Index>;
+
+  // Configuration.
+  struct Config {
+    Index nChannel =128;
+    Index nEvent =20;
+    Index nTick =19499;
+    Index period =497;           // Pulse period [tick]
+    Index pulseOffset =50;       // Tick of the first positive pulse
+    double chargeStep =3.431;    // Charge step between events [fC]
+    Index firstPulseEvent =1;    // First event with a pulse
+    float pedestal =800.0;       // Mean pedestal [ADC]
+    float pedestalSpread =50.0;  // Channel-to-channel pedestal RMS [ADC]
+    float noise =3.0;            // Sample noise RMS [ADC]
+    float gainSpread =0.05;      // Channel-to-channel relative gain RMS
+    float signalMax =0.0;        // Max signal above pedestal [ADC] (0 for no limit)
+    float stickyFraction =0.0;   // Probability a sample near code%64 = 0/63 sticks
+    Index stickyRange =2;        // Distance in codes from 0/63 that may stick
+    int adcMax =4095;
+    IndexVector deadChannels;
+    unsigned int seed =12345;
+  };
+
+  // Dataset parameters.
+  struct Dataset {
+    Index femb =1;
+    Index gain =2;
+    Index shap =2;
+    bool extPulse =false;
+    bool extClock =true;
+    bool isCold =false;
+  };
+
+  // Ctor from configuration.
+  explicit FembDataGenerator(const Config& cfg);
+
+  // Write one dataset to a file. Returns 0 for success.
+  int writeFile(Name fname, const Dataset& ds) const;
+
+  // Write the dataset file in the finder layout under tsdir.
+  // Returns 0 for success.
+  int writeDataset(Name tsdir, const Dataset& ds) const;
+
+  // Write datasets for each FEMB, temperature, gain, shaping and pulser
+  // and the matching fembjson.dat. Returns the number of failures.
+  Index writeCampaign(Name topdir, const IndexVector& fembs,
+                      const IndexVector& gains, const IndexVector& shaps,
+                      bool doWarm =true, bool doCold =false,
+                      bool doExtPulse =false, bool doIntPulse =true,
+                      Name wibdir ="wib_synthetic") const;
+
+  // Names used by the test stand.
+  static Name datasetDirName(const Dataset& ds);
+  static Name datasetFileName(const Dataset& ds);
+
+  // Timestamp for a FEMB and temperature in a campaign.
+  static Name timestamp(Index femb, bool isCold);
+
+  // Pulse height per unit charge [ADC/fC] for nominal gain.
+  static double adcPerFc(Index gain);
+
+  // Pulse peaking time [tick] for a shaping index.
+  static double peakingTicks(Index shap);
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+
+  // Return if a channel is dead.
+  bool isDead(Index icha) const;
+
+private:
+
+  // Seed for a dataset.
+  unsigned int seed(const Dataset& ds) const;
+
+  Config m_cfg;
+
+};
+
+#endif
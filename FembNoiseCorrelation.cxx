@@ -0,0 +1,320 @@
+// FembNoiseCorrelation.cxx
+
+#include "FembNoiseCorrelation.h"
+#include "FembPedestalSurvey.h"
+#include "FembCheckpoint.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::ostringstream;
+using std::vector;
+
+using Index = FembNoiseCorrelation::Index;
+using Name = FembNoiseCorrelation::Name;
+using IndexVector = FembNoiseCorrelation::IndexVector;
+using WaveformVector = FembNoiseCorrelation::WaveformVector;
+
+namespace {
+
+// Tile size and # ticks summed in float before adding to the double sums.
+const Index ntile = 16;
+const Index ntickTile = 512;
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembNoiseCorrelation::FembNoiseCorrelation(Index nchan, Index nchanPerAdc)
+: m_ncha(nchan), m_nchaPerAdc(nchanPerAdc),
+  m_npad((nchan + ntile - 1)/ntile*ntile), m_nevt(0) {
+  clear();
+}
+
+//**********************************************************************
+
+int FembNoiseCorrelation::addEvent(const WaveformVector& wfs) {
+  const string myname = "FembNoiseCorrelation::addEvent: ";
+  Index ntick = 0;
+  bool first = true;
+  for ( Index icha=0; icha<wfs.size() && icha<m_ncha; ++icha ) {
+    Index nwf = wfs[icha].size();
+    if ( nwf == 0 ) continue;
+    if ( first || nwf < ntick ) ntick = nwf;
+    first = false;
+  }
+  if ( ntick == 0 ) {
+    cout << myname << "Event has no samples." << endl;
+    return 1;
+  }
+  // Fill the tick-major block with the pedestal-subtracted samples.
+  m_block.assign(size_t(ntick)*m_npad, 0.0);
+  for ( Index icha=0; icha<wfs.size() && icha<m_ncha; ++icha ) {
+    const Waveform& wf = wfs[icha];
+    if ( wf.size() == 0 ) continue;
+    double sum = 0.0;
+    for ( Index itck=0; itck<ntick; ++itck ) sum += wf[itck];
+    float ped = sum/ntick;
+    float* pout = m_block.data() + icha;
+    for ( Index itck=0; itck<ntick; ++itck ) pout[size_t(itck)*m_npad] = wf[itck] - ped;
+    m_ntick[icha] += ntick;
+  }
+  accumulate(ntick);
+  ++m_nevt;
+  return 0;
+}
+
+//**********************************************************************
+
+int FembNoiseCorrelation::process(DuneFembReader& rdr, const IndexVector& events) {
+  const string myname = "FembNoiseCorrelation::process: ";
+  if ( rdr.tree() == nullptr ) {
+    cout << myname << "Tree not found in " << rdr.fileName() << endl;
+    return 1;
+  }
+  // Collect the waveforms of the requested events in one pass. Each event
+  // has one slot, so a repeated event is added once.
+  Index nevt = rdr.nEvent();
+  Index nslot = 0;
+  Index nbad = 0;
+  IndexVector slots(nevt, events.size());
+  for ( Index ievt : events ) {
+    if ( ievt >= nevt ) ++nbad;
+    else if ( slots[ievt] == events.size() ) slots[ievt] = nslot++;
+  }
+  vector<WaveformVector> evtwfs(nslot, WaveformVector(m_ncha));
+  Index nerr = 0;
+  for ( DuneFembReader::Entry ient=0; ient<rdr.nEntry(); ++ient ) {
+    if ( rdr.read(ient) ) {
+      ++nerr;
+      continue;
+    }
+    Index ievt = rdr.event();
+    Index icha = rdr.channel();
+    if ( ievt >= nevt || slots[ievt] >= events.size() || icha >= m_ncha ) continue;
+    if ( rdr.readWaveform(ient, nullptr) ) {
+      ++nerr;
+      continue;
+    }
+    evtwfs[slots[ievt]][icha] = *rdr.waveform();
+  }
+  int rstat = 0;
+  if ( nbad ) {
+    cout << myname << "Ignoring " << nbad << " invalid event" << (nbad == 1 ? "" : "s") << endl;
+    rstat = 2;
+  }
+  for ( const WaveformVector& wfs : evtwfs ) {
+    if ( addEvent(wfs) ) rstat = 2;
+  }
+  if ( nerr ) {
+    cout << myname << "Unable to read " << nerr << " entries from " << rdr.fileName() << endl;
+    return 3;
+  }
+  return rstat;
+}
+
+//**********************************************************************
+
+int FembNoiseCorrelation::processNoPulse(DuneFembReader& rdr, bool extPulse) {
+  IndexVector events;
+  for ( Index ievt=0; ievt<rdr.nEvent(); ++ievt ) {
+    if ( FembPedestalSurvey::isNoPulseEvent(ievt, extPulse) ) events.push_back(ievt);
+  }
+  return process(rdr, events);
+}
+
+//**********************************************************************
+
+void FembNoiseCorrelation::clear() {
+  m_sum.assign(size_t(m_npad)*m_npad, 0.0);
+  m_ntick.assign(m_ncha, 0);
+  m_nevt = 0;
+}
+
+//**********************************************************************
+
+double FembNoiseCorrelation::covariance(Index icha, Index jcha) const {
+  if ( icha >= m_ncha || jcha >= m_ncha ) return 0.0;
+  if ( jcha < icha ) std::swap(icha, jcha);
+  Index ntick = std::min(m_ntick[icha], m_ntick[jcha]);
+  if ( ntick == 0 ) return 0.0;
+  return m_sum[size_t(icha)*m_npad + jcha]/ntick;
+}
+
+//**********************************************************************
+
+double FembNoiseCorrelation::correlation(Index icha, Index jcha) const {
+  double den = covariance(icha, icha)*covariance(jcha, jcha);
+  if ( den <= 0.0 ) return 0.0;
+  return covariance(icha, jcha)/sqrt(den);
+}
+
+//**********************************************************************
+
+double FembNoiseCorrelation::cmsNoise(Index icha, Index groupSize) const {
+  if ( icha >= m_ncha || groupSize == 0 ) return 0.0;
+  Index jcha1 = icha/groupSize*groupSize;
+  Index jcha2 = std::min(m_ncha, jcha1 + groupSize);
+  double rowSum = 0.0;
+  double allSum = 0.0;
+  Index n = 0;
+  for ( Index jcha=jcha1; jcha<jcha2; ++jcha ) {
+    if ( m_ntick[jcha] == 0 ) continue;
+    ++n;
+    rowSum += covariance(icha, jcha);
+    for ( Index kcha=jcha1; kcha<jcha2; ++kcha ) {
+      if ( m_ntick[kcha] ) allSum += covariance(jcha, kcha);
+    }
+  }
+  if ( n == 0 || m_ntick[icha] == 0 ) return 0.0;
+  double var = covariance(icha, icha) - 2.0*rowSum/n + allSum/(double(n)*n);
+  return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+//**********************************************************************
+
+DataMap FembNoiseCorrelation::groupResult(Index icha1, Index icha2) const {
+  DataMap res;
+  if ( icha2 > m_ncha ) icha2 = m_ncha;
+  double sumVar = 0.0;
+  double sumCov = 0.0;
+  double sumCor = 0.0;
+  Index n = 0;
+  for ( Index icha=icha1; icha<icha2; ++icha ) {
+    if ( m_ntick[icha] == 0 ) continue;
+    ++n;
+    sumVar += covariance(icha, icha);
+    for ( Index jcha=icha+1; jcha<icha2; ++jcha ) {
+      if ( m_ntick[jcha] == 0 ) continue;
+      sumCov += covariance(icha, jcha);
+      sumCor += correlation(icha, jcha);
+    }
+  }
+  if ( n < 2 ) return res.setStatus(1);
+  double npair = 0.5*n*(n - 1);
+  double meanVar = sumVar/n;
+  double meanCov = sumCov/npair;
+  res.setInt("nChannel", n);
+  res.setFloat("noise", sqrt(meanVar));
+  res.setFloat("coherentRms", meanCov > 0.0 ? sqrt(meanCov) : 0.0);
+  res.setFloat("coherentFraction", meanVar > 0.0 ? meanCov/meanVar : 0.0);
+  res.setFloat("meanCorrelation", sumCor/npair);
+  return res;
+}
+
+//**********************************************************************
+
+DataMap FembNoiseCorrelation::adcResult(Index iadc) const {
+  if ( iadc >= nAdc() ) return DataMap(1);
+  return groupResult(iadc*m_nchaPerAdc, (iadc + 1)*m_nchaPerAdc);
+}
+
+//**********************************************************************
+
+DataMap FembNoiseCorrelation::fembResult() const {
+  return groupResult(0, m_ncha);
+}
+
+//**********************************************************************
+
+DataMap FembNoiseCorrelation::channelResult(Index icha) const {
+  DataMap res;
+  if ( icha >= m_ncha || m_ntick[icha] == 0 ) return res.setStatus(1);
+  res.setFloat("noise", sqrt(covariance(icha, icha)));
+  res.setFloat("adcCmsNoise", cmsNoise(icha, m_nchaPerAdc));
+  res.setFloat("fembCmsNoise", cmsNoise(icha, m_ncha));
+  double sumCor = 0.0;
+  Index ncor = 0;
+  if ( m_nchaPerAdc ) {
+    Index jcha1 = icha/m_nchaPerAdc*m_nchaPerAdc;
+    for ( Index jcha=jcha1; jcha<jcha1+m_nchaPerAdc && jcha<m_ncha; ++jcha ) {
+      if ( jcha == icha || m_ntick[jcha] == 0 ) continue;
+      sumCor += correlation(icha, jcha);
+      ++ncor;
+    }
+  }
+  res.setFloat("adcMeanCorrelation", ncor ? sumCor/ncor : 0.0);
+  return res;
+}
+
+//**********************************************************************
+
+int FembNoiseCorrelation::write(Name fname) const {
+  const string myname = "FembNoiseCorrelation::write: ";
+  ostringstream ssout;
+  ssout << "# Correlation matrix for " << m_ncha << " channels and " << m_nevt << " events\n";
+  ssout << fixed << setprecision(4);
+  for ( Index icha=0; icha<m_ncha; ++icha ) {
+    for ( Index jcha=0; jcha<m_ncha; ++jcha ) {
+      if ( jcha ) ssout << " ";
+      ssout << correlation(icha, jcha);
+    }
+    ssout << "\n";
+  }
+  if ( FembCheckpoint::writeAtomic(fname, ssout.str()) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+void FembNoiseCorrelation::print() const {
+  cout << "Noise correlation for " << m_nevt << " event" << (m_nevt == 1 ? "" : "s") << endl;
+  cout << "   Group  nchan   noise  cohRms  cohFrac  meanCor" << endl;
+  for ( Index igrp=0; igrp<=nAdc(); ++igrp ) {
+    bool isFemb = igrp == nAdc();
+    DataMap res = isFemb ? fembResult() : adcResult(igrp);
+    if ( res.status() ) continue;
+    ostringstream ssnam;
+    if ( isFemb ) ssnam << "FEMB";
+    else ssnam << "ADC " << igrp;
+    cout << setw(8) << ssnam.str() << setw(7) << res.getInt("nChannel") << fixed
+         << setprecision(3) << setw(8) << res.getFloat("noise")
+         << setw(8) << res.getFloat("coherentRms")
+         << setw(9) << res.getFloat("coherentFraction")
+         << setw(9) << res.getFloat("meanCorrelation") << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+  cout << setprecision(6);
+}
+
+//**********************************************************************
+
+void FembNoiseCorrelation::accumulate(Index ntick) {
+  const float* pblk = m_block.data();
+  float tile[ntile][ntile];
+  for ( Index icha0=0; icha0<m_npad; icha0+=ntile ) {
+    for ( Index jcha0=icha0; jcha0<m_npad; jcha0+=ntile ) {
+      for ( Index itck0=0; itck0<ntick; itck0+=ntickTile ) {
+        Index itck1 = std::min(ntick, itck0 + ntickTile);
+        for ( Index i=0; i<ntile; ++i ) for ( Index j=0; j<ntile; ++j ) tile[i][j] = 0.0;
+        for ( Index itck=itck0; itck<itck1; ++itck ) {
+          const float* prow = pblk + size_t(itck)*m_npad;
+          const float* pi = prow + icha0;
+          const float* pj = prow + jcha0;
+          for ( Index i=0; i<ntile; ++i ) {
+            float xi = pi[i];
+            float* ptile = tile[i];
+            for ( Index j=0; j<ntile; ++j ) ptile[j] += xi*pj[j];
+          }
+        }
+        for ( Index i=0; i<ntile; ++i ) {
+          double* psum = m_sum.data() + size_t(icha0 + i)*m_npad + jcha0;
+          for ( Index j=0; j<ntile; ++j ) psum[j] += tile[i][j];
+        }
+      }
+    }
+  }
+}
+
+//**********************************************************************
@@ -0,0 +1,110 @@
+// FembNoiseCorrelation.h
+//
+// Channel covariance and correlation matrices of the pedestal-subtracted
+// samples of a FEMB and the coherent noise derived from them.
+//
+// Each event added is a channel x tick block. The pedestal of each channel
+// is its mean over the event. The block is stored tick-major and the sums
+// x_i x_j are accumulated with a blocked symmetric rank-k update: for each
+// 16 x 16 tile of the upper triangle, the products of a tick range are
+// summed in float into a local tile whose inner loop runs over contiguous
+// channels (and so vectorizes) and the tile is then added to the double
+// sums. Events are added until the results are read, e.g. all the no-pulse
+// events of a dataset.
+//
+// For a group of n channels (an ADC or the FEMB) with covariance C
+//   noise            - sqrt of the mean of C_ii [ADC]
+//   coherentRms      - sqrt of the mean of C_ij for i != j [ADC], i.e. the
+//                      RMS of the noise common to the channels
+//   coherentFraction - mean of C_ij over i != j divided by the mean of C_ii,
+//                      0 for independent and 1 for fully coherent noise
+//   meanCorrelation  - mean of the correlation coefficients for i != j
+// The common-mode-subtracted noise of a channel is the RMS of the channel
+// minus the mean of its group at each tick, evaluated from C as
+//   C_ii - (2/n) sum_j C_ij + (1/n^2) sum_jk C_jk
+//
+// If a channel is missing from an event, its row for that event is zero and
+// covariances use the smaller tick count of the two channels.
+
+#ifndef FembNoiseCorrelation_H
+#define FembNoiseCorrelation_H
+
+#include "DuneFembReader.h"
+#include "dune/DuneInterface/Data/DataMap.h"
+#include <string>
+#include <vector>
+
+class FembNoiseCorrelation {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using IndexVector = std::vector<Index>;
+  using Waveform = DuneFembReader::Waveform;
+  using WaveformVector = std::vector<Waveform>;
+
+  // Ctor from the number of channels and the channels per ADC.
+  explicit FembNoiseCorrelation(Index nchan =128, Index nchanPerAdc =16);
+
+  // Add an event from the waveforms of its channels. A missing channel has
+  // an empty waveform. Ticks beyond the shortest waveform are not used.
+  // Returns 0 for success.
+  int addEvent(const WaveformVector& wfs);
+
+  // Add events from a reader. An event listed more than once is added once.
+  // Returns 0 for success.
+  int process(DuneFembReader& rdr, const IndexVector& events);
+
+  // Add the no-pulse events (see FembPedestalSurvey::isNoPulseEvent).
+  int processNoPulse(DuneFembReader& rdr, bool extPulse);
+
+  // Clear the sums.
+  void clear();
+
+  // Covariance [ADC^2] and correlation coefficient for two channels.
+  double covariance(Index icha, Index jcha) const;
+  double correlation(Index icha, Index jcha) const;
+
+  // Common-mode-subtracted noise of a channel [ADC] for groups of
+  // groupSize channels, e.g. 16 for the ADC or nChannel() for the FEMB.
+  double cmsNoise(Index icha, Index groupSize) const;
+
+  // Results for the channels [icha1, icha2) (see above).
+  DataMap groupResult(Index icha1, Index icha2) const;
+  DataMap adcResult(Index iadc) const;
+  DataMap fembResult() const;
+
+  // Results for a channel:
+  //   noise, adcCmsNoise, fembCmsNoise, adcMeanCorrelation
+  DataMap channelResult(Index icha) const;
+
+  // Write the correlation matrix, one line per channel. Returns 0 for success.
+  int write(Name fname) const;
+
+  // Display the ADC and FEMB results.
+  void print() const;
+
+  // Getters.
+  Index nChannel() const { return m_ncha; }
+  Index nChannelPerAdc() const { return m_nchaPerAdc; }
+  Index nAdc() const { return m_nchaPerAdc ? m_ncha/m_nchaPerAdc : 0; }
+  Index nEvent() const { return m_nevt; }
+  Index tickCount(Index icha) const { return icha < m_ncha ? m_ntick[icha] : 0; }
+
+private:
+
+  // Accumulate the sums for the tick-major block m_block with ntick rows.
+  void accumulate(Index ntick);
+
+  Index m_ncha;
+  Index m_nchaPerAdc;
+  Index m_npad;                 // Channels padded to a multiple of the tile size
+  Index m_nevt;
+  std::vector<double> m_sum;    // [icha*m_npad + jcha] for icha <= jcha
+  IndexVector m_ntick;          // [icha] # ticks summed
+  std::vector<float> m_block;   // [itck*m_npad + icha] Work space
+
+};
+
+#endif
@@ -0,0 +1,232 @@
+// FembNoiseSpectrum.cxx
+
+#include "FembNoiseSpectrum.h"
+#include "FembPedestalSurvey.h"
+#include "FembCheckpoint.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::ostringstream;
+using std::vector;
+
+using Index = FembNoiseSpectrum::Index;
+using Name = FembNoiseSpectrum::Name;
+using IndexVector = FembNoiseSpectrum::IndexVector;
+using FloatVector = FembNoiseSpectrum::FloatVector;
+
+//**********************************************************************
+
+FembNoiseSpectrum::FembNoiseSpectrum(const Config& cfg)
+: m_cfg(cfg), m_fft(cfg.length), m_norm(0.0) {
+  const string myname = "FembNoiseSpectrum::ctor: ";
+  if ( ! m_fft.isValid() ) {
+    cout << myname << "Invalid FFT length." << endl;
+    return;
+  }
+  Index nseg = m_cfg.length;
+  double sumw2 = 0.0;
+  for ( Index itck=0; itck<nseg; ++itck ) {
+    double w = 0.5 - 0.5*cos(2.0*M_PI*itck/nseg);
+    m_window.push_back(w);
+    sumw2 += w*w;
+  }
+  // One-sided density: the positive and negative frequencies are summed
+  // for all bins except DC and Nyquist.
+  m_norm = 2.0/(m_cfg.tickFrequency*sumw2);
+  m_segment.resize(nseg);
+  clear();
+}
+
+//**********************************************************************
+
+FembNoiseSpectrum::FembNoiseSpectrum() : FembNoiseSpectrum(Config()) { }
+
+//**********************************************************************
+
+Index FembNoiseSpectrum::add(Index icha, const Waveform& wf) {
+  if ( ! isValid() || icha >= m_cfg.nchan ) return 0;
+  Index nseg = m_cfg.length;
+  Index step = nseg/2 > 0 ? nseg/2 : 1;
+  Index nadd = 0;
+  double* pow = m_power.data() + icha*nbin();
+  for ( Index itck0=0; itck0+nseg<=wf.size(); itck0+=step ) {
+    const unsigned short* padc = wf.data() + itck0;
+    double sum = 0.0;
+    for ( Index itck=0; itck<nseg; ++itck ) sum += padc[itck];
+    double mean = sum/nseg;
+    for ( Index itck=0; itck<nseg; ++itck ) m_segment[itck] = m_window[itck]*(padc[itck] - mean);
+    m_fft.addPower(m_segment.data(), pow);
+    ++nadd;
+  }
+  m_nseg[icha] += nadd;
+  return nadd;
+}
+
+//**********************************************************************
+
+int FembNoiseSpectrum::process(DuneFembReader& rdr, bool extPulse) {
+  const string myname = "FembNoiseSpectrum::process: ";
+  if ( ! isValid() ) return 1;
+  if ( rdr.tree() == nullptr ) {
+    cout << myname << "Tree not found in " << rdr.fileName() << endl;
+    return 2;
+  }
+  Index nerr = 0;
+  for ( DuneFembReader::Entry ient=0; ient<rdr.nEntry(); ++ient ) {
+    // Read the indices first so the pulsed waveforms are not read.
+    if ( rdr.read(ient) ) {
+      ++nerr;
+      continue;
+    }
+    if ( ! FembPedestalSurvey::isNoPulseEvent(rdr.event(), extPulse) ) continue;
+    if ( rdr.readWaveform(ient, nullptr) ) {
+      ++nerr;
+      continue;
+    }
+    add(rdr.channel(), *rdr.waveform());
+  }
+  if ( nerr ) {
+    cout << myname << "Unable to read " << nerr << " entries from " << rdr.fileName() << endl;
+    return 3;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+void FembNoiseSpectrum::clear() {
+  m_power.assign(m_cfg.nchan*nbin(), 0.0);
+  m_nseg.assign(m_cfg.nchan, 0);
+}
+
+//**********************************************************************
+
+FloatVector FembNoiseSpectrum::channelSpectrum(Index icha) const {
+  return averageSpectrum(icha, icha + 1);
+}
+
+//**********************************************************************
+
+FloatVector FembNoiseSpectrum::adcSpectrum(Index iadc) const {
+  Index icha1 = iadc*m_cfg.nchanPerAdc;
+  return averageSpectrum(icha1, icha1 + m_cfg.nchanPerAdc);
+}
+
+//**********************************************************************
+
+FloatVector FembNoiseSpectrum::fembSpectrum() const {
+  return averageSpectrum(0, m_cfg.nchan);
+}
+
+//**********************************************************************
+
+IndexVector FembNoiseSpectrum::findLines(const FloatVector& spec, float ratio, Index halfWidth) {
+  IndexVector lines;
+  Index nbin = spec.size();
+  FloatVector near;
+  // Skip DC, which is removed with the segment mean.
+  for ( Index ibin=1; ibin+1<nbin; ++ibin ) {
+    float val = spec[ibin];
+    if ( val <= spec[ibin-1] || val < spec[ibin+1] ) continue;
+    Index jbin1 = ibin > halfWidth ? ibin - halfWidth : 1;
+    Index jbin2 = std::min(nbin, ibin + halfWidth + 1);
+    near.assign(spec.begin() + jbin1, spec.begin() + jbin2);
+    std::nth_element(near.begin(), near.begin() + near.size()/2, near.end());
+    if ( val > ratio*near[near.size()/2] ) lines.push_back(ibin);
+  }
+  return lines;
+}
+
+//**********************************************************************
+
+int FembNoiseSpectrum::write(Name fname) const {
+  const string myname = "FembNoiseSpectrum::write: ";
+  ostringstream ssout;
+  ssout << "# Noise spectra [ADC^2/MHz] for FFT length " << m_cfg.length
+        << " and tick frequency " << m_cfg.tickFrequency << " MHz\n";
+  ssout << "frequency 0";
+  for ( Index ibin=0; ibin<nbin(); ++ibin ) ssout << " " << frequency(ibin);
+  ssout << "\n";
+  ssout << setprecision(5);
+  auto writeSpec = [&ssout](Name name, Index nseg, const FloatVector& spec) {
+    if ( spec.empty() ) return;
+    ssout << name << " " << nseg;
+    for ( float val : spec ) ssout << " " << val;
+    ssout << "\n";
+  };
+  Index nsegAll = 0;
+  for ( Index nseg : m_nseg ) nsegAll += nseg;
+  writeSpec("femb", nsegAll, fembSpectrum());
+  Index nadc = m_cfg.nchanPerAdc > 0 ? m_cfg.nchan/m_cfg.nchanPerAdc : 0;
+  for ( Index iadc=0; iadc<nadc; ++iadc ) {
+    Index nseg = 0;
+    for ( Index icha=iadc*m_cfg.nchanPerAdc; icha<(iadc+1)*m_cfg.nchanPerAdc; ++icha ) nseg += m_nseg[icha];
+    writeSpec("adc" + std::to_string(iadc), nseg, adcSpectrum(iadc));
+  }
+  for ( Index icha=0; icha<m_cfg.nchan; ++icha ) {
+    writeSpec("chan" + std::to_string(icha), m_nseg[icha], channelSpectrum(icha));
+  }
+  if ( FembCheckpoint::writeAtomic(fname, ssout.str()) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+void FembNoiseSpectrum::print() const {
+  FloatVector spec = fembSpectrum();
+  if ( spec.empty() ) {
+    cout << "No noise spectra." << endl;
+    return;
+  }
+  double var = 0.0;
+  for ( float val : spec ) var += val;
+  var *= frequency(1);
+  IndexVector lines = findLines(spec);
+  cout << "FEMB noise spectrum: RMS " << fixed << setprecision(3) << sqrt(var) << " ADC, "
+       << lines.size() << " line" << (lines.size() == 1 ? "" : "s") << endl;
+  for ( Index ibin : lines ) {
+    cout << setw(10) << setprecision(4) << 1000.0*frequency(ibin) << " kHz"
+         << setw(12) << setprecision(3) << spec[ibin] << " ADC^2/MHz" << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+  cout << setprecision(6);
+}
+
+//**********************************************************************
+
+FloatVector FembNoiseSpectrum::averageSpectrum(Index icha1, Index icha2) const {
+  FloatVector spec;
+  if ( ! isValid() ) return spec;
+  if ( icha2 > m_cfg.nchan ) icha2 = m_cfg.nchan;
+  Index nbin = this->nbin();
+  vector<double> sum(nbin, 0.0);
+  Index ncha = 0;
+  for ( Index icha=icha1; icha<icha2; ++icha ) {
+    Index nseg = m_nseg[icha];
+    if ( nseg == 0 ) continue;
+    const double* pow = m_power.data() + icha*nbin;
+    for ( Index ibin=0; ibin<nbin; ++ibin ) sum[ibin] += pow[ibin]/nseg;
+    ++ncha;
+  }
+  if ( ncha == 0 ) return spec;
+  spec.resize(nbin);
+  for ( Index ibin=0; ibin<nbin; ++ibin ) {
+    double fac = ibin == 0 || ibin + 1 == nbin ? 0.5 : 1.0;
+    spec[ibin] = fac*m_norm*sum[ibin]/ncha;
+  }
+  return spec;
+}
+
+//**********************************************************************
@@ -0,0 +1,105 @@
+// FembNoiseSpectrum.h
+//
+// Noise power spectra for the channels of a FEMB from the pedestal (no-pulse)
+// events of a dataset, e.g. to find pickup lines.
+//
+// The spectrum of each channel is a Welch average: each waveform is split
+// into segments of the FFT length that overlap by half, each segment has
+// its mean subtracted and a Hann window applied, and the power of the
+// segments is averaged. All channels share one FFT plan (see FembRealFft)
+// and their power sums are held in one contiguous array.
+//
+// The spectra are one-sided power spectral densities in ADC^2/MHz, i.e. the
+// sum over bins times the bin width is the variance of the waveform. The
+// ADC spectra are averages over the 16 channels of each ADC and the FEMB
+// spectrum is the average over all channels.
+//
+// write saves the spectra as text lines
+//   NAME NSEG PSD0 PSD1 ...
+// for frequency (NSEG 0), femb, adc0, ..., adc7 and chan0, ..., chan127.
+
+#ifndef FembNoiseSpectrum_H
+#define FembNoiseSpectrum_H
+
+#include "DuneFembReader.h"
+#include "FembRealFft.h"
+#include <string>
+#include <vector>
+
+class FembNoiseSpectrum {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using IndexVector = std::vector<Index>;
+  using FloatVector = std::vector<float>;
+  using Waveform = DuneFembReader::Waveform;
+
+  // Configuration.
+  struct Config {
+    Index length =512;            // FFT length [ticks], a power of two
+    double tickFrequency =2.0;    // Sampling frequency [MHz]
+    Index nchan =128;             // # channels
+    Index nchanPerAdc =16;        // # channels for each ADC
+  };
+
+  // Ctor from the configuration.
+  explicit FembNoiseSpectrum(const Config& cfg);
+
+  // Ctor with the default configuration.
+  FembNoiseSpectrum();
+
+  // Add the segments of a waveform to the spectrum of a channel.
+  // Returns the number of segments added.
+  Index add(Index icha, const Waveform& wf);
+
+  // Add the no-pulse waveforms from a reader (see FembPedestalSurvey::isNoPulseEvent).
+  // Returns 0 for success.
+  int process(DuneFembReader& rdr, bool extPulse);
+
+  // Clear the spectra.
+  void clear();
+
+  // Number of bins and bin frequency [MHz].
+  Index nbin() const { return m_fft.nbin(); }
+  double frequency(Index ibin) const { return ibin*m_cfg.tickFrequency/m_cfg.length; }
+
+  // Number of segments added for a channel.
+  Index segmentCount(Index icha) const { return icha < m_nseg.size() ? m_nseg[icha] : 0; }
+
+  // Spectra [ADC^2/MHz]. Empty if no segments were added.
+  FloatVector channelSpectrum(Index icha) const;
+  FloatVector adcSpectrum(Index iadc) const;
+  FloatVector fembSpectrum() const;
+
+  // Return the bins of a spectrum that are local maxima and exceed the
+  // median of the bins within halfWidth by the factor ratio.
+  static IndexVector findLines(const FloatVector& spec, float ratio =5.0, Index halfWidth =8);
+
+  // Write the spectra. Returns 0 for success.
+  int write(Name fname) const;
+
+  // Display the lines in the FEMB spectrum.
+  void print() const;
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+  bool isValid() const { return m_fft.isValid(); }
+
+private:
+
+  // Average the spectra of a range of channels.
+  FloatVector averageSpectrum(Index icha1, Index icha2) const;
+
+  Config m_cfg;
+  FembRealFft m_fft;
+  std::vector<double> m_window;
+  double m_norm;                    // Scale from |X|^2 to PSD
+  std::vector<double> m_power;      // [icha*nbin + ibin] Sum over segments
+  IndexVector m_nseg;               // [icha]
+  std::vector<double> m_segment;    // Work space
+
+};
+
+#endif
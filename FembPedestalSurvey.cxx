@@ -0,0 +1,376 @@
+// FembPedestalSurvey.cxx
+
+#include "FembPedestalSurvey.h"
+#include "DuneFembReader.h"
+#include "DuneFembFinder.h"
+#include "FembWorkStealingPool.h"
+#include "FembCheckpoint.h"
+#include "FembNoiseSpectrum.h"
+#include "TROOT.h"
+#include "TSystem.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::ostringstream;
+using std::vector;
+
+using Index = FembPedestalSurvey::Index;
+using Name = FembPedestalSurvey::Name;
+using Config = FembPedestalSurvey::Config;
+using Stats = FembPedestalSurvey::Stats;
+using DatasetResult = FembPedestalSurvey::DatasetResult;
+using Waveform = DuneFembReader::Waveform;
+using Histogram = vector<Index>;
+using Clock = std::chrono::steady_clock;
+
+//**********************************************************************
+
+namespace {
+
+// # bins for the 12-bit ADC codes. Larger codes are not counted.
+const Index nbin = 4096;
+
+// Add the ticks of a waveform to a histogram.
+void fill(Histogram& hist, const Waveform& wf) {
+  Index* counts = hist.data();
+  for ( unsigned short adc : wf ) {
+    if ( adc < nbin ) ++counts[adc];
+  }
+}
+
+// Return the most common code in a waveform. The scratch histogram must be
+// empty and is left empty.
+int waveformMode(Histogram& scratch, const Waveform& wf) {
+  Index* counts = scratch.data();
+  Index maxCount = 0;
+  int mode = -1;
+  for ( unsigned short adc : wf ) {
+    if ( adc >= nbin ) continue;
+    Index count = ++counts[adc];
+    if ( count > maxCount ) {
+      maxCount = count;
+      mode = adc;
+    }
+  }
+  for ( unsigned short adc : wf ) {
+    if ( adc < nbin ) counts[adc] = 0;
+  }
+  return mode;
+}
+
+// Add the ticks of a pulsed waveform away from the pulses to a histogram.
+void fillBaseline(Histogram& hist, Histogram& scratch, vector<char>& mask,
+                  const Waveform& wf, const Config& cfg) {
+  int mode = waveformMode(scratch, wf);
+  if ( mode < 0 ) return;
+  Index ntck = wf.size();
+  mask.assign(ntck, 0);
+  Index maskEnd = 0;    // Ticks before this are already masked.
+  for ( Index itck=0; itck<ntck; ++itck ) {
+    int dadc = int(wf[itck]) - mode;
+    if ( Index(std::abs(dadc)) <= cfg.signalThreshold ) continue;
+    Index jtck1 = itck > cfg.maskBefore ? itck - cfg.maskBefore : 0;
+    if ( jtck1 < maskEnd ) jtck1 = maskEnd;
+    Index jtck2 = std::min(ntck, itck + cfg.maskAfter + 1);
+    for ( Index jtck=jtck1; jtck<jtck2; ++jtck ) mask[jtck] = 1;
+    if ( jtck2 > maskEnd ) maskEnd = jtck2;
+  }
+  Index* counts = hist.data();
+  for ( Index itck=0; itck<ntck; ++itck ) {
+    unsigned short adc = wf[itck];
+    if ( ! mask[itck] && adc < nbin ) ++counts[adc];
+  }
+}
+
+// Ratio of the RMS of a Gaussian truncated at +/-k sigma to sigma.
+double truncatedRmsRatio(double k) {
+  double inside = std::erf(k/std::sqrt(2.0));
+  if ( inside <= 0.0 ) return 1.0;
+  double density = std::exp(-0.5*k*k)/std::sqrt(2.0*M_PI);
+  double ratio2 = 1.0 - 2.0*k*density/inside;
+  return ratio2 > 0.0 ? std::sqrt(ratio2) : 1.0;
+}
+
+// Evaluate the statistics of a histogram.
+Stats histStats(const Histogram& hist, const Config& cfg) {
+  Stats st;
+  unsigned long long count = 0;
+  unsigned long long nclassic = 0;
+  Index maxCount = 0;
+  int mode = -1;
+  for ( Index ibin=0; ibin<nbin; ++ibin ) {
+    Index binCount = hist[ibin];
+    if ( binCount == 0 ) continue;
+    count += binCount;
+    if ( binCount > maxCount ) {
+      maxCount = binCount;
+      mode = ibin;
+    }
+    Index mod = ibin%64;
+    if ( mod == 0 || mod == 63 ) nclassic += binCount;
+  }
+  st.count = count;
+  if ( count == 0 ) return st;
+  st.mode = mode;
+  st.sticky1 = double(maxCount)/count;
+  st.sticky2 = double(nclassic)/count;
+  // Iterate the truncated mean and RMS. Sums are taken about the mode.
+  double rmsRatio = truncatedRmsRatio(cfg.nsigma);
+  double mean = mode;
+  double rms = 0.0;
+  double halfWidth = cfg.startHalfWidth;
+  int bin1 = -1;
+  int bin2 = -1;
+  for ( Index iter=0; iter<cfg.maxIter; ++iter ) {
+    int newBin1 = std::max(0, int(std::ceil(mean - halfWidth)));
+    int newBin2 = std::min(int(nbin) - 1, int(std::floor(mean + halfWidth)));
+    if ( newBin1 == bin1 && newBin2 == bin2 ) break;
+    bin1 = newBin1;
+    bin2 = newBin2;
+    double sum0 = 0.0;
+    double sum1 = 0.0;
+    double sum2 = 0.0;
+    for ( int ibin=bin1; ibin<=bin2; ++ibin ) {
+      double binCount = hist[ibin];
+      double dadc = ibin - mode;
+      sum0 += binCount;
+      sum1 += binCount*dadc;
+      sum2 += binCount*dadc*dadc;
+    }
+    if ( sum0 <= 0.0 ) break;
+    double dmean = sum1/sum0;
+    double var = sum2/sum0 - dmean*dmean;
+    mean = mode + dmean;
+    rms = var > 0.0 ? std::sqrt(var) : 0.0;
+    // The RMS is truncated if the window is set by nsigma.
+    double sigma = rms/rmsRatio;
+    if ( cfg.nsigma*sigma > cfg.minHalfWidth ) {
+      rms = sigma;
+      halfWidth = cfg.nsigma*sigma;
+    } else {
+      halfWidth = cfg.minHalfWidth;
+    }
+  }
+  st.mean = mean;
+  st.rms = rms;
+  return st;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembPedestalSurvey::FembPedestalSurvey(Name topdir, const Config& cfg)
+: m_topdir(topdir), m_cfg(cfg) { }
+
+//**********************************************************************
+
+FembPedestalSurvey::FembPedestalSurvey(Name topdir)
+: FembPedestalSurvey(topdir, Config()) { }
+
+//**********************************************************************
+
+Index FembPedestalSurvey::findDatasets() {
+  const string myname = "FembPedestalSurvey::findDatasets: ";
+  vector<Dataset> dss = FembCampaign::scanDatasets(m_topdir, m_selFembs, m_selGains, m_selShaps);
+  for ( const Dataset& ds : dss ) addDataset(ds);
+  Index nds = dss.size();
+  cout << myname << "Found " << nds << " dataset" << (nds == 1 ? "" : "s") << "." << endl;
+  return nds;
+}
+
+//**********************************************************************
+
+Index FembPedestalSurvey::addDataset(const Dataset& ds) {
+  m_datasets.push_back(ds);
+  m_results.emplace_back();
+  return m_datasets.size() - 1;
+}
+
+//**********************************************************************
+
+Index FembPedestalSurvey::run(Index nthread) {
+  const string myname = "FembPedestalSurvey::run: ";
+  Index nds = m_datasets.size();
+  m_results.assign(nds, DatasetResult());
+  if ( nds == 0 ) return 0;
+  Clock::time_point start = Clock::now();
+  // Each thread opens its own file.
+  ROOT::EnableThreadSafety();
+  {
+    FembWorkStealingPool pool(nthread);
+    cout << myname << "Surveying " << nds << " dataset" << (nds == 1 ? "" : "s") << " with "
+         << pool.size() << " thread" << (pool.size() == 1 ? "" : "s") << "." << endl;
+    for ( Index ids=0; ids<nds; ++ids ) pool.submit([this, ids]() { surveyDataset(ids); });
+    pool.wait();
+  }
+  Index nfail = 0;
+  for ( const DatasetResult& res : m_results ) if ( res.status ) ++nfail;
+  double time = std::chrono::duration<double>(Clock::now() - start).count();
+  cout << myname << "Surveyed " << nds - nfail << " of " << nds << " datasets in "
+       << time << " sec." << endl;
+  return nfail;
+}
+
+//**********************************************************************
+
+int FembPedestalSurvey::writeTable(Name fname) const {
+  const string myname = "FembPedestalSurvey::writeTable: ";
+  ostringstream ssout;
+  ssout << "# dataset chan nped mode mean rms sticky1 sticky2 nbase bmean brms\n";
+  ssout << fixed;
+  for ( Index ids=0; ids<m_datasets.size(); ++ids ) {
+    const DatasetResult& res = m_results[ids];
+    if ( res.status ) continue;
+    Name dsname = m_datasets[ids].name();
+    for ( Index icha=0; icha<res.channels.size(); ++icha ) {
+      const Stats& ped = res.channels[icha].pedestal;
+      const Stats& bas = res.channels[icha].baseline;
+      if ( ped.count == 0 && bas.count == 0 ) continue;
+      ssout << dsname << " " << icha << " " << ped.count << " " << ped.mode
+            << setprecision(2) << " " << ped.mean << setprecision(3) << " " << ped.rms
+            << setprecision(4) << " " << ped.sticky1 << " " << ped.sticky2
+            << " " << bas.count
+            << setprecision(2) << " " << bas.mean << setprecision(3) << " " << bas.rms << "\n";
+    }
+  }
+  if ( FembCheckpoint::writeAtomic(fname, ssout.str()) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+Index FembPedestalSurvey::writeSpectra(Name dirname) const {
+  const string myname = "FembPedestalSurvey::writeSpectra: ";
+  if ( gSystem->AccessPathName(dirname.c_str()) ) gSystem->mkdir(dirname.c_str(), true);
+  Index nfail = 0;
+  for ( Index ids=0; ids<m_datasets.size(); ++ids ) {
+    const FembNoiseSpectrum* pspec = m_results[ids].spectrum.get();
+    if ( pspec == nullptr ) continue;
+    if ( pspec->write(dirname + "/" + m_datasets[ids].name() + "_spectrum.txt") ) ++nfail;
+  }
+  return nfail;
+}
+
+//**********************************************************************
+
+void FembPedestalSurvey::print() const {
+  cout << "Pedestal survey of " << m_datasets.size() << " datasets" << endl;
+  cout << "Stat  nent  nerr  ncha  meanRms   time  Dataset" << endl;
+  for ( Index ids=0; ids<m_datasets.size(); ++ids ) {
+    const DatasetResult& res = m_results[ids];
+    double sumRms = 0.0;
+    Index ncha = 0;
+    for ( const ChannelResult& chres : res.channels ) {
+      if ( chres.pedestal.count == 0 ) continue;
+      sumRms += chres.pedestal.rms;
+      ++ncha;
+    }
+    cout << setw(4) << res.status << setw(6) << res.nEntry << setw(6) << res.nReadError
+         << setw(6) << ncha << fixed << setprecision(2) << setw(9) << (ncha ? sumRms/ncha : 0.0)
+         << setprecision(1) << setw(7) << res.time << "  " << m_datasets[ids].name() << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+  cout << setprecision(6);
+}
+
+//**********************************************************************
+
+int FembPedestalSurvey::survey(DuneFembReader& rdr, bool extPulse, const Config& cfg, DatasetResult& res) {
+  const string myname = "FembPedestalSurvey::survey: ";
+  res = DatasetResult();
+  if ( rdr.tree() == nullptr ) {
+    cout << myname << "Tree not found in " << rdr.fileName() << endl;
+    return res.status = 1;
+  }
+  Index ncha = rdr.nChannel();
+  if ( ncha == 0 ) {
+    cout << myname << "No channels found in " << rdr.fileName() << endl;
+    return res.status = 2;
+  }
+  vector<Histogram> pedHists(ncha, Histogram(nbin, 0));
+  vector<Histogram> baseHists(cfg.useBaselines ? ncha : 0, Histogram(nbin, 0));
+  Histogram scratch(nbin, 0);
+  vector<char> mask;
+  FembNoiseSpectrum* pspec = nullptr;
+  if ( cfg.spectrumLength ) {
+    FembNoiseSpectrum::Config spcfg;
+    spcfg.length = cfg.spectrumLength;
+    spcfg.nchan = ncha;
+    res.spectrum.reset(pspec = new FembNoiseSpectrum(spcfg));
+  }
+  DuneFembReader::Entry nent = rdr.nEntry();
+  for ( DuneFembReader::Entry ient=0; ient<nent; ++ient ) {
+    // Without baselines, the waveforms of the pulsed events are not read.
+    if ( ! cfg.useBaselines ) {
+      if ( rdr.read(ient) ) {
+        ++res.nReadError;
+        continue;
+      }
+      if ( ! isNoPulseEvent(rdr.event(), extPulse) ) continue;
+    }
+    if ( rdr.readWaveform(ient, nullptr) ) {
+      ++res.nReadError;
+      continue;
+    }
+    ++res.nEntry;
+    Index icha = rdr.channel();
+    if ( icha >= ncha ) continue;
+    const Waveform& wf = *rdr.waveform();
+    if ( isNoPulseEvent(rdr.event(), extPulse) ) {
+      fill(pedHists[icha], wf);
+      if ( pspec != nullptr ) pspec->add(icha, wf);
+    } else if ( cfg.useBaselines ) {
+      fillBaseline(baseHists[icha], scratch, mask, wf, cfg);
+    }
+  }
+  res.channels.resize(ncha);
+  for ( Index icha=0; icha<ncha; ++icha ) {
+    res.channels[icha].pedestal = histStats(pedHists[icha], cfg);
+    if ( cfg.useBaselines ) res.channels[icha].baseline = histStats(baseHists[icha], cfg);
+  }
+  if ( res.nReadError ) {
+    cout << myname << "Unable to read " << res.nReadError << " entries from "
+         << rdr.fileName() << endl;
+    return res.status = 3;
+  }
+  return res.status = 0;
+}
+
+//**********************************************************************
+
+void FembPedestalSurvey::surveyDataset(Index ids) {
+  const string myname = "FembPedestalSurvey::surveyDataset: ";
+  const Dataset& ds = m_datasets[ids];
+  DatasetResult& res = m_results[ids];
+  Clock::time_point start = Clock::now();
+  DuneFembFinder::RdrPtr prdr;
+  if ( ds.path.size() ) {
+    prdr.reset(new DuneFembReader(ds.path));
+  } else {
+    DuneFembFinder fdr(m_topdir);
+    prdr = fdr.find(ds.femb, ds.isCold, ds.ts, ds.gain, ds.shap, ds.extPulse, ds.extClock);
+  }
+  if ( ! prdr ) {
+    cout << myname << "Dataset " << ds.name() << " not found." << endl;
+    res.status = 4;
+  } else {
+    survey(*prdr, ds.extPulse, m_cfg, res);
+  }
+  res.time = std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+//**********************************************************************
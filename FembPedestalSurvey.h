@@ -0,0 +1,154 @@
+// FembPedestalSurvey.h
+//
+// Fast survey of the pedestal and noise of every channel in a set of FEMB
+// datasets, e.g. the whole archive, for health checks.
+//
+// Instead of running the pedestal fit and ROI tools of FembTestAnalyzer,
+// the survey streams the raw waveforms of each dataset once and fills
+// integer histograms of the ADC codes for each channel:
+//   pedestal - all ticks of the no-pulse events (those with zero charge,
+//              see FembTestAnalyzer::chargeFc)
+//   baseline - ticks of the pulsed events away from the pulses
+// A tick of a pulsed event is taken to be signal if it differs from the
+// most common code of its waveform by more than signalThreshold. Ticks
+// from maskBefore before to maskAfter after a signal tick are excluded
+// from the baseline.
+//
+// For each histogram the result holds
+//   count   - # ticks
+//   mode    - most common ADC code
+//   mean    - mean of a Gaussian truncated at nsigma about the mean
+//   rms     - sigma of that Gaussian, corrected for the truncation
+//   sticky1 - fraction of ticks with the most common code (s1)
+//   sticky2 - fraction of ticks with code%64 = 0 or 63 (s2)
+// The truncated mean and RMS are iterated starting from a window of
+// +/-startHalfWidth about the mode. The window half width is at least
+// minHalfWidth so the RMS of quiet channels is not truncated.
+//
+// If spectrumLength is not zero, the noise spectra of the no-pulse
+// waveforms (see FembNoiseSpectrum) are found in the same pass and
+// writeSpectra writes them for each dataset.
+//
+// Datasets are surveyed concurrently, one per thread. writeTable writes
+// one line for each channel of each dataset.
+
+#ifndef FembPedestalSurvey_H
+#define FembPedestalSurvey_H
+
+#include "FembCampaign.h"
+#include <string>
+#include <vector>
+#include <memory>
+
+class DuneFembReader;
+class FembNoiseSpectrum;
+
+class FembPedestalSurvey {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using IndexVector = std::vector<Index>;
+  using Dataset = FembCampaign::Dataset;
+
+  // Configuration.
+  struct Config {
+    float nsigma =3.0;            // Truncation of the Gaussian [sigma]
+    Index startHalfWidth =20;     // Half width of the first window [ADC]
+    Index minHalfWidth =3;        // Minimum half width of the window [ADC]
+    Index maxIter =10;            // Maximum # iterations for the truncated mean
+    bool useBaselines =true;      // Survey the baselines of the pulsed events
+    Index signalThreshold =25;    // Threshold for a signal tick [ADC]
+    Index maskBefore =10;         // Ticks excluded before a signal tick
+    Index maskAfter =150;         // Ticks excluded after a signal tick
+    Index spectrumLength =0;      // FFT length for the noise spectra (0 for none)
+  };
+
+  // Results for one histogram.
+  struct Stats {
+    Index count = 0;
+    int mode = -1;
+    float mean = 0.0;
+    float rms = 0.0;
+    float sticky1 = 0.0;
+    float sticky2 = 0.0;
+  };
+
+  // Results for one channel.
+  struct ChannelResult {
+    Stats pedestal;
+    Stats baseline;
+  };
+
+  // Results for one dataset.
+  struct DatasetResult {
+    int status = -1;        // 0 for success
+    Index nEntry = 0;       // # waveforms read
+    Index nReadError = 0;   // # waveforms that could not be read
+    double time = 0.0;      // [sec]
+    std::vector<ChannelResult> channels;
+    std::shared_ptr<FembNoiseSpectrum> spectrum;
+  };
+
+  // Ctor from the data directory (blank for DuneFembFinder::defaultTopdir())
+  // and the configuration.
+  FembPedestalSurvey(Name topdir, const Config& cfg);
+
+  // Ctor with the default configuration.
+  explicit FembPedestalSurvey(Name topdir ="");
+
+  // Selection used by findDatasets. An empty list selects all values.
+  void setFembs(const IndexVector& vals) { m_selFembs = vals; }
+  void setGains(const IndexVector& vals) { m_selGains = vals; }
+  void setShapings(const IndexVector& vals) { m_selShaps = vals; }
+
+  // Add all selected datasets found in fembjson.dat and the data tree.
+  // Returns the number of datasets added.
+  Index findDatasets();
+
+  // Add a dataset. If its path is blank, it is found with DuneFembFinder.
+  // Returns the dataset index.
+  Index addDataset(const Dataset& ds);
+
+  // Survey the datasets with nthread threads (zero for the hardware
+  // concurrency). Returns the number of datasets that failed.
+  Index run(Index nthread =0);
+
+  // Write the channel results. Returns 0 for success.
+  int writeTable(Name fname) const;
+
+  // Write the noise spectra of each dataset to DIR/DATASET_spectrum.txt.
+  // Returns the number of datasets whose spectra could not be written.
+  Index writeSpectra(Name dirname) const;
+
+  // Display the dataset results.
+  void print() const;
+
+  // Survey the waveforms from a reader. Returns the result status.
+  static int survey(DuneFembReader& rdr, bool extPulse, const Config& cfg, DatasetResult& res);
+
+  // Return if an event has no pulse.
+  static bool isNoPulseEvent(Index ievt, bool extPulse) { return ievt == 0 || (extPulse && ievt == 1); }
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+  const std::vector<Dataset>& datasets() const { return m_datasets; }
+  const std::vector<DatasetResult>& results() const { return m_results; }
+
+private:
+
+  // Survey one dataset.
+  void surveyDataset(Index ids);
+
+  Name m_topdir;
+  Config m_cfg;
+  IndexVector m_selFembs;
+  IndexVector m_selGains;
+  IndexVector m_selShaps;
+  std::vector<Dataset> m_datasets;
+  std::vector<DatasetResult> m_results;
+
+};
+
+#endif
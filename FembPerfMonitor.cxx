@@ -0,0 +1,146 @@
+// FembPerfMonitor.cxx
+
+#include "FembPerfMonitor.h"
+#include <iostream>
+#include <iomanip>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::lock_guard;
+using std::mutex;
+
+using Index = FembPerfMonitor::Index;
+using Name = FembPerfMonitor::Name;
+
+//**********************************************************************
+
+void FembPerfMonitor::Stats::add(double dt, Count nbyte, Count nsam, Count nroi, Count nalloc) {
+  if ( calls == 0 || dt < timeMin ) timeMin = dt;
+  if ( calls == 0 || dt > timeMax ) timeMax = dt;
+  ++calls;
+  time += dt;
+  bytes += nbyte;
+  samples += nsam;
+  rois += nroi;
+  allocs += nalloc;
+}
+
+//**********************************************************************
+
+FembPerfMonitor::Scope::
+Scope(FembPerfMonitor* pmon, const char* stage, Index icha, const Name& tool)
+: m_pmon(pmon), m_icha(icha) {
+  if ( m_pmon == nullptr ) return;
+  m_stage = stage;
+  m_stage += tool;
+  m_start = Clock::now();
+}
+
+//**********************************************************************
+
+FembPerfMonitor::Scope::~Scope() {
+  if ( m_pmon == nullptr ) return;
+  double dt = std::chrono::duration<double>(Clock::now() - m_start).count();
+  m_pmon->record(m_stage, m_icha, dt, m_nbyte, m_nsam, m_nroi, m_nalloc);
+}
+
+//**********************************************************************
+
+void FembPerfMonitor::
+record(const Name& stage, Index icha, double dt, Count nbyte, Count nsam, Count nroi, Count nalloc) {
+  lock_guard<mutex> lock(m_mutex);
+  StatsMap::iterator ient = m_stats.find(stage);
+  if ( ient == m_stats.end() ) {
+    m_names.push_back(stage);
+    ient = m_stats.emplace(stage, Stats()).first;
+  }
+  ient->second.add(dt, nbyte, nsam, nroi, nalloc);
+  if ( icha != noChannel() ) m_chanStats[icha][stage].add(dt, nbyte, nsam, nroi, nalloc);
+}
+
+//**********************************************************************
+
+std::vector<Name> FembPerfMonitor::stageNames() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_names;
+}
+
+//**********************************************************************
+
+FembPerfMonitor::StatsMap FembPerfMonitor::stats() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_stats;
+}
+
+//**********************************************************************
+
+FembPerfMonitor::ChannelStatsMap FembPerfMonitor::channelStats() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_chanStats;
+}
+
+//**********************************************************************
+
+void FembPerfMonitor::clear() {
+  lock_guard<mutex> lock(m_mutex);
+  m_names.clear();
+  m_stats.clear();
+  m_chanStats.clear();
+}
+
+//**********************************************************************
+
+void FembPerfMonitor::print(string prefix) const {
+  std::vector<Name> names = stageNames();
+  StatsMap stmap = stats();
+  Index wnam = 5;
+  for ( const Name& name : names ) if ( name.size() > wnam ) wnam = name.size();
+  cout << prefix << setw(wnam) << "Stage" << setw(9) << "Calls" << setw(11) << "Time [s]"
+       << setw(11) << "Mean [ms]" << setw(11) << "Max [ms]" << setw(12) << "MB"
+       << setw(12) << "Samples" << setw(9) << "ROIs" << setw(9) << "Allocs" << endl;
+  for ( const Name& name : names ) {
+    const Stats& st = stmap[name];
+    double tmean = st.calls ? 1000.0*st.time/st.calls : 0.0;
+    cout << prefix << setw(wnam) << name << setw(9) << st.calls
+         << fixed << setprecision(3) << setw(11) << st.time
+         << setw(11) << tmean << setw(11) << 1000.0*st.timeMax
+         << setw(12) << 1.e-6*st.bytes << setw(12) << st.samples << setw(9) << st.rois << setw(9) << st.allocs << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+}
+
+//**********************************************************************
+
+DataMap FembPerfMonitor::summary() const {
+  DataMap res;
+  std::vector<Name> names = stageNames();
+  StatsMap stmap = stats();
+  ChannelStatsMap chmap = channelStats();
+  Index ncha = chmap.size() ? chmap.rbegin()->first + 1 : 0;
+  for ( const Name& name : names ) {
+    const Stats& st = stmap[name];
+    res.setInt("perfCalls_" + name, st.calls);
+    res.setFloat("perfTime_" + name, st.time);
+    res.setFloat("perfTimeMax_" + name, st.timeMax);
+    if ( st.bytes ) res.setFloat("perfBytes_" + name, st.bytes);
+    if ( st.samples ) res.setFloat("perfSamples_" + name, st.samples);
+    if ( st.rois ) res.setInt("perfRois_" + name, st.rois);
+    if ( st.allocs ) res.setInt("perfAllocs_" + name, st.allocs);
+    DataMap::FloatVector chanTimes(ncha, 0.0);
+    bool haveChan = false;
+    for ( const auto& ient : chmap ) {
+      StatsMap::const_iterator jent = ient.second.find(name);
+      if ( jent == ient.second.end() ) continue;
+      chanTimes[ient.first] = jent->second.time;
+      haveChan = true;
+    }
+    if ( haveChan ) res.setFloatVector("perfChannelTimes_" + name, chanTimes);
+  }
+  return res;
+}
+
+//**********************************************************************
@@ -0,0 +1,109 @@
+// FembPerfMonitor.h
+//
+// Timers and counters for the stages of the FEMB analysis.
+//
+// A stage is identified by name, e.g. "read", "mod_adcPedestalFit" or
+// "fitHeight". Each time a stage runs, the elapsed time (steady clock) and
+// optional counts of bytes, samples, ROIs and buffer allocations are recorded for the run and,
+// if a channel is given, for that channel.
+//
+// Stages may be nested and times are inclusive.
+// Recording is thread safe. Scope does nothing, not even reading the clock,
+// if its monitor is null, so instrumentation costs nearly nothing when disabled.
+
+#ifndef FembPerfMonitor_H
+#define FembPerfMonitor_H
+
+#include "dune/DuneInterface/Data/DataMap.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <limits>
+
+class FembPerfMonitor {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using Count = unsigned long;
+  using Clock = std::chrono::steady_clock;
+
+  // Accumulated statistics for one stage.
+  struct Stats {
+    Count calls = 0;
+    double time = 0.0;      // Total time [sec]
+    double timeMin = 0.0;   // Min time for one call [sec]
+    double timeMax = 0.0;   // Max time for one call [sec]
+    Count bytes = 0;
+    Count samples = 0;
+    Count rois = 0;
+    Count allocs = 0;       // Buffer allocations
+    void add(double dt, Count nbyte, Count nsam, Count nroi, Count nalloc =0);
+  };
+
+  using StatsMap = std::map<Name, Stats>;
+  using ChannelStatsMap = std::map<Index, StatsMap>;
+
+  // Times a stage from construction to destruction.
+  // The stage name is stage + tool.
+  class Scope {
+  public:
+    Scope(FembPerfMonitor* pmon, const char* stage, Index icha =noChannel(),
+          const Name& tool =Name());
+    ~Scope();
+    Scope(const Scope&) =delete;
+    Scope& operator=(const Scope&) =delete;
+    void addBytes(Count val) { m_nbyte += val; }
+    void addSamples(Count val) { m_nsam += val; }
+    void addRois(Count val) { m_nroi += val; }
+    void addAllocs(Count val) { m_nalloc += val; }
+  private:
+    FembPerfMonitor* m_pmon;
+    Name m_stage;
+    Index m_icha;
+    Clock::time_point m_start;
+    Count m_nbyte = 0;
+    Count m_nsam = 0;
+    Count m_nroi = 0;
+    Count m_nalloc = 0;
+  };
+
+  // Channel value for stages that are not associated with a channel.
+  static Index noChannel() { return std::numeric_limits<Index>::max(); }
+
+  // Record one call to a stage.
+  void record(const Name& stage, Index icha, double dt,
+              Count nbyte =0, Count nsam =0, Count nroi =0, Count nalloc =0);
+
+  // Stage names in the order they were first recorded.
+  std::vector<Name> stageNames() const;
+
+  // Statistics for the run and for each channel.
+  StatsMap stats() const;
+  ChannelStatsMap channelStats() const;
+
+  // Remove all entries.
+  void clear();
+
+  // Display a table of the stage statistics.
+  void print(std::string prefix ="") const;
+
+  // Return the statistics in a data map. For each stage STAGE:
+  //   perfCalls_STAGE, perfTime_STAGE, perfTimeMax_STAGE
+  //   perfBytes_STAGE, perfSamples_STAGE, perfRois_STAGE, perfAllocs_STAGE (if nonzero)
+  //   perfChannelTimes_STAGE - time for each channel (if any)
+  DataMap summary() const;
+
+private:
+
+  mutable std::mutex m_mutex;
+  std::vector<Name> m_names;
+  StatsMap m_stats;
+  ChannelStatsMap m_chanStats;
+
+};
+
+#endif
@@ -0,0 +1,277 @@
+// FembPlotRenderer.cxx
+
+#include "FembPlotRenderer.h"
+#include "FembTestAnalyzer.h"
+#include "FembCheckpoint.h"
+#include "FembToolConfig.h"
+#include "dune/DuneCommon/TPadManipulator.h"
+#include "TROOT.h"
+#include "TSystem.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ostringstream;
+using std::istringstream;
+using std::vector;
+using std::map;
+
+using Index = FembPlotRenderer::Index;
+using Name = FembPlotRenderer::Name;
+using Plot = FembPlotRenderer::Plot;
+
+//**********************************************************************
+
+namespace {
+
+// 64-bit FNV-1a hash as hex.
+Name hashName(const Name& text) {
+  unsigned long long hash = 14695981039346656037ULL;
+  for ( unsigned char ch : text ) {
+    hash ^= ch;
+    hash *= 1099511628211ULL;
+  }
+  ostringstream sshash;
+  sshash << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return sshash.str();
+}
+
+// Size and modification time of a file or "missing".
+Name fileStamp(Name fname) {
+  FileStat_t fstat;
+  if ( gSystem->GetPathInfo(fname.c_str(), fstat) ) return fname + ":missing";
+  ostringstream ssout;
+  ssout << fname << ":" << fstat.fSize << ":" << fstat.fMtime;
+  return ssout.str();
+}
+
+// Hash of the content of a small file or "missing".
+Name fileHash(Name fname) {
+  ifstream fin(fname.c_str());
+  if ( ! fin ) return fname + ":missing";
+  ostringstream sstext;
+  sstext << fin.rdbuf();
+  return fname + ":" + hashName(sstext.str());
+}
+
+// Work shared by the worker processes. The status of each plot,
+// 0 not done, 1 success, 2 failure, follows the header in the mapped region.
+struct SharedWork {
+  std::atomic<unsigned int> next;
+};
+
+// Return the status bytes that follow the work header.
+unsigned char* workStatus(void* pmap) {
+  return static_cast<unsigned char*>(pmap) + sizeof(SharedWork);
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembPlotRenderer::FembPlotRenderer(FembTestAnalyzer* pfta, Name outdir)
+: m_pfta(pfta), m_outdir(outdir), m_nproc(0), m_force(false),
+  m_nrender(0), m_nskip(0), m_nfail(0) { }
+
+//**********************************************************************
+
+void FembPlotRenderer::addFemb(Name name, Name fileName) {
+  Plot plot;
+  plot.fileName = fileName;
+  plot.name = name;
+  add(plot);
+}
+
+//**********************************************************************
+
+void FembPlotRenderer::addAdc(Name name, int iadc, int ievt, Name fileName) {
+  Plot plot;
+  plot.fileName = fileName;
+  plot.name = name;
+  plot.adc = true;
+  plot.index = iadc;
+  plot.event = ievt;
+  add(plot);
+}
+
+//**********************************************************************
+
+Index FembPlotRenderer::render() {
+  const string myname = "FembPlotRenderer::render: ";
+  m_nrender = 0;
+  m_nskip = 0;
+  m_nfail = 0;
+  if ( m_pfta == nullptr ) {
+    cout << myname << "Analyzer is missing." << endl;
+    return m_nfail = m_plots.size();
+  }
+  if ( gSystem->AccessPathName(m_outdir.c_str()) ) gSystem->mkdir(m_outdir.c_str(), true);
+  // Read the stamps of the last render.
+  map<Name, Name> stamps;
+  {
+    ifstream fin(stampFileName().c_str());
+    Name fname;
+    Name sig;
+    while ( fin >> fname >> sig ) stamps[fname] = sig;
+  }
+  // Find the plots to render.
+  vector<Index> todo;
+  vector<Name> sigs;
+  Name insig = inputSignature();
+  for ( Index iplt=0; iplt<m_plots.size(); ++iplt ) {
+    const Plot& plot = m_plots[iplt];
+    Name sig = signature(insig, plot);
+    sigs.push_back(sig);
+    Name path = m_outdir + "/" + plot.fileName;
+    if ( ! m_force && stamps[plot.fileName] == sig && ! gSystem->AccessPathName(path.c_str()) ) {
+      ++m_nskip;
+    } else {
+      todo.push_back(iplt);
+    }
+  }
+  if ( m_nskip ) cout << myname << "Skipping " << m_nskip << " unchanged plots." << endl;
+  Index nplt = todo.size();
+  if ( nplt == 0 ) return 0;
+  // Process before forking so the workers share the results.
+  if ( m_pfta->processAll().status() ) {
+    cout << myname << "Analyzer processing failed." << endl;
+    return m_nfail = nplt;
+  }
+  Index nproc = m_nproc > 0 ? m_nproc : std::thread::hardware_concurrency();
+  if ( nproc == 0 ) nproc = 1;
+  if ( nproc > nplt ) nproc = nplt;
+  vector<unsigned char> stats(nplt, 0);
+  if ( nproc == 1 ) {
+    bool batchSave = gROOT->IsBatch();
+    gROOT->SetBatch(true);
+    for ( Index jplt=0; jplt<nplt; ++jplt ) stats[jplt] = renderPlot(m_plots[todo[jplt]]) ? 2 : 1;
+    gROOT->SetBatch(batchSave);
+  } else {
+    size_t nbyte = sizeof(SharedWork) + nplt;
+    void* pmap = mmap(nullptr, nbyte, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if ( pmap == MAP_FAILED ) {
+      cout << myname << "Unable to map shared memory." << endl;
+      return m_nfail = nplt;
+    }
+    SharedWork* pwork = new (pmap) SharedWork;
+    pwork->next = 0;
+    unsigned char* pstat = workStatus(pmap);
+    for ( Index jplt=0; jplt<nplt; ++jplt ) pstat[jplt] = 0;
+    cout << myname << "Rendering " << nplt << " plots in " << nproc << " processes." << endl;
+    // Flush so buffered output is not repeated by the workers.
+    cout.flush();
+    vector<pid_t> pids;
+    for ( Index iproc=0; iproc<nproc; ++iproc ) {
+      pid_t pid = fork();
+      if ( pid < 0 ) {
+        cout << myname << "Unable to fork worker." << endl;
+        break;
+      }
+      if ( pid == 0 ) {
+        gROOT->SetBatch(true);
+        // Reopen the data files so the workers do not share file offsets.
+        for ( FembTestAnalyzer* pfta : {m_pfta, m_pfta->rawSource()} ) {
+          if ( pfta != nullptr && pfta->reader() != nullptr ) pfta->reader()->refresh(true);
+        }
+        while ( true ) {
+          Index jplt = pwork->next++;
+          if ( jplt >= nplt ) break;
+          pstat[jplt] = renderPlot(m_plots[todo[jplt]]) ? 2 : 1;
+        }
+        cout.flush();
+        _exit(0);
+      }
+      pids.push_back(pid);
+    }
+    for ( pid_t pid : pids ) {
+      int wstat = 0;
+      waitpid(pid, &wstat, 0);
+    }
+    for ( Index jplt=0; jplt<nplt; ++jplt ) stats[jplt] = pstat[jplt];
+    munmap(pmap, nbyte);
+  }
+  // Record the stamps of the rendered plots.
+  for ( Index jplt=0; jplt<nplt; ++jplt ) {
+    Index iplt = todo[jplt];
+    const Plot& plot = m_plots[iplt];
+    if ( stats[jplt] == 1 ) {
+      ++m_nrender;
+      stamps[plot.fileName] = sigs[iplt];
+    } else {
+      cout << myname << "Unable to render " << plot.fileName << endl;
+      ++m_nfail;
+      stamps.erase(plot.fileName);
+    }
+  }
+  ostringstream ssout;
+  for ( const auto& ent : stamps ) {
+    if ( ent.second.size() ) ssout << ent.first << " " << ent.second << "\n";
+  }
+  if ( FembCheckpoint::writeAtomic(stampFileName(), ssout.str()) ) {
+    cout << myname << "Unable to write " << stampFileName() << endl;
+  }
+  cout << myname << "Rendered " << m_nrender << ", skipped " << m_nskip
+       << ", failed " << m_nfail << " plots." << endl;
+  return m_nfail;
+}
+
+//**********************************************************************
+
+Name FembPlotRenderer::inputSignature() const {
+  if ( m_pfta == nullptr ) return "";
+  const FembTestAnalyzer& fta = *m_pfta;
+  ostringstream ssout;
+  ssout << "femb=" << fta.femb() << " gain=" << fta.gainIndex() << " shap=" << fta.shapingIndex()
+        << " cold=" << fta.isCold() << " extp=" << fta.extPulse() << " extc=" << fta.extClock()
+        << " calib=" << fta.calibOptionName() << " roi=" << fta.roiOptionName()
+        << " period=" << fta.tickPeriod();
+  if ( fta.reader() != nullptr ) ssout << " data=" << fileStamp(fta.reader()->fileName());
+  // Hash the tool configuration file that is actually read.
+  Name toolFile = FembToolConfig::instance("dunefemb.fcl").filePath();
+  ssout << " tools=" << fileHash(toolFile.size() ? toolFile : "dunefemb.fcl");
+  if ( fta.isCalib() ) {
+    ssout << " calfcl=" << fileHash(fta.calibFclDirName() + "/" + fta.calibFclToolName() + ".fcl");
+  }
+  return ssout.str();
+}
+
+//**********************************************************************
+
+Name FembPlotRenderer::signature(const Plot& plot) const {
+  return signature(inputSignature(), plot);
+}
+
+//**********************************************************************
+
+Name FembPlotRenderer::signature(Name insig, const Plot& plot) {
+  ostringstream ssout;
+  ssout << insig << " plot=" << plot.name << " adc=" << plot.adc
+        << " index=" << plot.index << " event=" << plot.event << " file=" << plot.fileName;
+  return hashName(ssout.str());
+}
+
+//**********************************************************************
+
+int FembPlotRenderer::renderPlot(const Plot& plot) const {
+  TPadManipulator* pman = plot.adc ? m_pfta->drawAdc(plot.name, plot.index, plot.event)
+                                   : m_pfta->draw(plot.name, plot.index, plot.event);
+  if ( pman == nullptr ) return 1;
+  Name path = m_outdir + "/" + plot.fileName;
+  if ( pman->print(path) ) return 2;
+  return 0;
+}
+
+//**********************************************************************
@@ -0,0 +1,101 @@
+// FembPlotRenderer.h
+//
+// Renders a list of FembTestAnalyzer plots to image files in batch mode
+// using forked worker processes. ROOT graphics is not thread safe, so the
+// concurrency is across processes: each worker takes the next plot from a
+// shared counter, draws it with FembTestAnalyzer::draw or drawAdc and
+// prints it. The analyzer is processed (processAll) before the workers are
+// forked so they share its results and only do the drawing.
+//
+// Each rendered file is recorded in the stamp file OUTDIR/plotstamps.txt
+// with a signature of the plot and its inputs:
+//   - the plot name, channel or ADC, event and file name,
+//   - the analyzer FEMB, gain, shaping, temperature, pulser, clock,
+//     calibration, ROI option and tick period,
+//   - the size and modification time of the data file,
+//   - the content of the tool configuration (dunefemb.fcl as found using
+//     FHICL_FILE_PATH) and, for calibrated analyzers, the calibration FCL.
+// A plot whose file exists and whose signature is unchanged since the last
+// render is skipped.
+//
+// The renderer must be called from a single-threaded process, e.g. not
+// inside FembCampaign::run.
+
+#ifndef FembPlotRenderer_H
+#define FembPlotRenderer_H
+
+#include <string>
+#include <vector>
+
+class FembTestAnalyzer;
+
+class FembPlotRenderer {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+
+  // Description of one plot.
+  struct Plot {
+    Name fileName;       // Output file relative to the output directory
+    Name name;           // Plot name for draw or drawAdc, e.g. "pedlim"
+    bool adc = false;    // True to use drawAdc
+    int index = -1;      // Channel for draw, ADC for drawAdc
+    int event = -1;      // Event (-1 for all)
+  };
+
+  // Ctor from the analyzer and output directory.
+  explicit FembPlotRenderer(FembTestAnalyzer* pfta, Name outdir =".");
+
+  // Set the number of worker processes. Zero means the hardware concurrency.
+  void setProcessCount(Index val) { m_nproc = val; }
+
+  // Render every plot even if its signature is unchanged.
+  void setForce(bool val) { m_force = val; }
+
+  // Add plots.
+  void add(const Plot& plot) { m_plots.push_back(plot); }
+  void addFemb(Name name, Name fileName);
+  void addAdc(Name name, int iadc, int ievt, Name fileName);
+
+  // Render the plots that are missing or out of date.
+  // Returns the number of plots that could not be rendered.
+  Index render();
+
+  // Signature of the analyzer inputs.
+  Name inputSignature() const;
+
+  // Signature of a plot including the inputs.
+  Name signature(const Plot& plot) const;
+
+  // Getters.
+  FembTestAnalyzer* analyzer() const { return m_pfta; }
+  Name outdir() const { return m_outdir; }
+  Name stampFileName() const { return m_outdir + "/plotstamps.txt"; }
+  const std::vector<Plot>& plots() const { return m_plots; }
+  Index processCount() const { return m_nproc; }
+  Index renderCount() const { return m_nrender; }
+  Index skipCount() const { return m_nskip; }
+  Index failCount() const { return m_nfail; }
+
+private:
+
+  // Signature of a plot for the input signature insig.
+  static Name signature(Name insig, const Plot& plot);
+
+  // Draw and print a plot. Returns 0 for success.
+  int renderPlot(const Plot& plot) const;
+
+  FembTestAnalyzer* m_pfta;
+  Name m_outdir;
+  Index m_nproc;
+  bool m_force;
+  std::vector<Plot> m_plots;
+  Index m_nrender;
+  Index m_nskip;
+  Index m_nfail;
+
+};
+
+#endif
@@ -0,0 +1,150 @@
+// FembPrepareKernel.cxx
+
+#include "FembPrepareKernel.h"
+#include "dune/DuneInterface/AdcChannelData.h"
+#include <iostream>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <set>
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using Index = FembPrepareKernel::Index;
+
+namespace {
+
+// Ticks per block. The raw, sample, flag and mask data for a block
+// fit in the L1 cache.
+const Index blockSize = 1024;
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembPrepareKernel::FembPrepareKernel(const Config& cfg) : m_cfg(cfg) { }
+
+//**********************************************************************
+
+void FembPrepareKernel::setCalibration(const FembCalibTable& cal) {
+  m_cal = cal;
+}
+
+//**********************************************************************
+
+DataMap FembPrepareKernel::update(AdcChannelData& acd) const {
+  const string myname = "FembPrepareKernel::update: ";
+  DataMap res;
+  Index nsam = acd.raw.size();
+  Index icha = acd.channel;
+  const float ped = acd.pedestal;
+  float gain = 1.0;
+  int adcmin = m_cfg.adcUnderflow;
+  int adcmax = m_cfg.adcOverflow;
+  if ( haveCalibration() ) {
+    if ( icha >= m_cal.size() ) {
+      cout << myname << "Channel " << icha << " is not in the calibration." << endl;
+      return res.setStatus(1);
+    }
+    gain = m_cal.gain(icha);
+    adcmin = m_cal.adcMin(icha);
+    adcmax = m_cal.adcMax(icha);
+  }
+  const FembRoiFinder::Config& rcfg = m_cfg.roi;
+  const bool doThreshold = m_cfg.doRoi && rcfg.mode == FembRoiFinder::ThresholdMode;
+  const float infinity = std::numeric_limits<float>::infinity();
+  const float thrPos = rcfg.flagPositive ? rcfg.threshold : infinity;
+  const float thrNeg = rcfg.flagNegative ? -rcfg.threshold : -infinity;
+  acd.samples.resize(nsam);
+  acd.flags.resize(nsam);
+  if ( m_cfg.doRoi ) acd.rois.clear();
+  const AdcCount* praw = acd.raw.data();
+  AdcSignal* psam = acd.samples.data();
+  AdcFlag* pflg = acd.flags.data();
+  unsigned char above[blockSize];
+  FembRoiFinder::RoiBuilder bld(nsam, rcfg.binsBefore, rcfg.binsAfter, acd.rois);
+  for ( Index isam0=0; isam0<nsam; isam0+=blockSize ) {
+    Index nblk = nsam - isam0 < blockSize ? nsam - isam0 : blockSize;
+    const AdcCount* prawb = praw + isam0;
+    AdcSignal* psamb = psam + isam0;
+    AdcFlag* pflgb = pflg + isam0;
+    // Branch-free conversion, calibration, flagging and threshold test.
+    for ( Index ib=0; ib<nblk; ++ib ) {
+      const int iadc = prawb[ib];
+      const float q = gain*(float(iadc) - ped);
+      psamb[ib] = q;
+      pflgb[ib] = iadc <= adcmin ? AdcUnderflow : iadc >= adcmax ? AdcOverflow : AdcGood;
+      above[ib] = (q > thrPos) | (q < thrNeg);
+    }
+    if ( ! doThreshold ) continue;
+    // Build ROIs from the ticks above threshold, skipping empty words.
+    Index ib = 0;
+    while ( ib < nblk ) {
+      if ( ib + 8 <= nblk ) {
+        uint64_t word;
+        std::memcpy(&word, above + ib, 8);
+        if ( word == 0 ) {
+          ib += 8;
+          continue;
+        }
+      }
+      if ( above[ib] ) bld.add(isam0 + ib);
+      ++ib;
+    }
+  }
+  if ( doThreshold ) bld.finish();
+  if ( m_cfg.doRoi ) {
+    if ( ! doThreshold ) FembRoiFinder::findRegularRois(nsam, rcfg.period, rcfg.length, acd.rois);
+    FembRoiFinder::fillSignal(acd);
+    FembRoiFinder::summarize(acd, res, rcfg.useSimd);
+  }
+  if ( haveCalibration() ) {
+    acd.sampleUnit = m_cal.units();
+    res.setInt("calibAdcMin", adcmin);
+    res.setInt("calibAdcMax", adcmax);
+  } else {
+    acd.sampleUnit = "ADC counts";
+  }
+  return res;
+}
+
+//**********************************************************************
+
+DataMap FembPrepareKernel::
+compare(const AdcChannelData& acd, const AdcChannelData& acdref, bool checkRois, float tol) {
+  DataMap res;
+  Index nsam = acd.samples.size();
+  Index nsamRef = acdref.samples.size();
+  Index nsamMin = nsam < nsamRef ? nsam : nsamRef;
+  float dsamMax = 0.0;
+  Index nsamDiff = nsam > nsamRef ? nsam - nsamRef : nsamRef - nsam;
+  for ( Index isam=0; isam<nsamMin; ++isam ) {
+    float dsam = std::fabs(acd.samples[isam] - acdref.samples[isam]);
+    float lim = tol*(1.0 + std::fabs(acdref.samples[isam]));
+    if ( dsam > dsamMax ) dsamMax = dsam;
+    if ( dsam > lim ) ++nsamDiff;
+  }
+  Index nflg = acd.flags.size() < acdref.flags.size() ? acd.flags.size() : acdref.flags.size();
+  Index nflgDiff = acd.flags.size() + acdref.flags.size() - 2*nflg;
+  for ( Index isam=0; isam<nflg; ++isam ) {
+    if ( acd.flags[isam] != acdref.flags[isam] ) ++nflgDiff;
+  }
+  res.setFloat("prepareDiffSampleMax", dsamMax);
+  res.setInt("prepareDiffSampleCount", nsamDiff);
+  res.setInt("prepareDiffFlagCount", nflgDiff);
+  res.setInt("prepareDiffUnit", acd.sampleUnit != acdref.sampleUnit);
+  if ( checkRois ) {
+    std::set<AdcRoi> rois(acd.rois.begin(), acd.rois.end());
+    std::set<AdcRoi> roisRef(acdref.rois.begin(), acdref.rois.end());
+    Index nroiDiff = 0;
+    for ( const AdcRoi& roi : rois ) if ( roisRef.count(roi) == 0 ) ++nroiDiff;
+    for ( const AdcRoi& roi : roisRef ) if ( rois.count(roi) == 0 ) ++nroiDiff;
+    res.setInt("prepareDiffRoiCount", nroiDiff);
+  }
+  return res;
+}
+
+//**********************************************************************
@@ -0,0 +1,76 @@
+// FembPrepareKernel.h
+//
+// ADC channel tool that does the sample preparation usually done by a
+// chain of tools in a single pass over the raw data:
+//
+//   adcSampleFiller or FembLinearCalibration - samples and under/overflow flags
+//   adcThresholdSignalFinder                 - signal flags and ROIs
+//     or tickModSignalFinder
+//   adcRoiViewer                             - ROI summary
+//
+// The pedestal is taken from the channel data and so must already be set,
+// e.g. with adcPedestalFit.
+//
+// Samples are processed in blocks that stay in cache. Within a block, the
+// conversion, calibration, flagging and threshold test are branch free so
+// the compiler can vectorize them. The threshold mask is then scanned eight
+// ticks at a time, which is fast because signals are sparse. ROI finding
+// and the summary follow FembRoiFinder.
+//
+// The update result holds
+//   the FembRoiFinder ROI summary (if ROIs are found)
+//   calibAdcMin, calibAdcMax - ADC range (if a calibration is applied)
+
+#ifndef FembPrepareKernel_H
+#define FembPrepareKernel_H
+
+#include "FembCalibTable.h"
+#include "FembRoiFinder.h"
+#include "dune/DuneInterface/Tool/AdcChannelTool.h"
+
+class FembPrepareKernel : public AdcChannelTool {
+
+public:
+
+  using Index = unsigned int;
+
+  // Configuration. Defaults are those of the dunetpc tools.
+  struct Config {
+    bool  doRoi =true;          // Find ROIs
+    FembRoiFinder::Config roi;  // ROI finding
+    int   adcUnderflow =0;      // Underflow level without calibration
+    int   adcOverflow =4095;    // Overflow level without calibration
+  };
+
+  // Ctor from configuration.
+  explicit FembPrepareKernel(const Config& cfg);
+
+  // Apply a calibration. Samples are then in the calibration units.
+  void setCalibration(const FembCalibTable& cal);
+
+  // Fill samples, flags, signal and ROIs from raw data and pedestal.
+  DataMap update(AdcChannelData& acd) const override;
+
+  // Compare the prepared data in acd with that from reference acdref.
+  // The result holds:
+  //   prepareDiffSampleMax - Maximum sample difference
+  //   prepareDiffSampleCount - # samples differing by more than tol
+  //   prepareDiffFlagCount - # ticks with different flags
+  //   prepareDiffRoiCount - # ROIs that are not in both
+  //   prepareDiffUnit - 1 if the sample units differ
+  static DataMap compare(const AdcChannelData& acd, const AdcChannelData& acdref,
+                         bool checkRois, float tol =1.e-4);
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+  bool haveCalibration() const { return m_cal.isValid(); }
+  const FembCalibTable& calibration() const { return m_cal; }
+
+private:
+
+  Config m_cfg;
+  FembCalibTable m_cal;
+
+};
+
+#endif
@@ -0,0 +1,86 @@
+// FembRealFft.cxx
+
+#include "FembRealFft.h"
+#include <iostream>
+#include <cmath>
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using Index = FembRealFft::Index;
+using Complex = FembRealFft::Complex;
+
+//**********************************************************************
+
+FembRealFft::FembRealFft(Index n) : m_n(0) {
+  const string myname = "FembRealFft::ctor: ";
+  if ( n < 2 || ! isPowerOfTwo(n) ) {
+    cout << myname << "Invalid length: " << n << endl;
+    return;
+  }
+  m_n = n;
+  Index nhalf = n/2;
+  Index nbit = 0;
+  while ( (Index(1) << nbit) < nhalf ) ++nbit;
+  m_bitrev.resize(nhalf);
+  for ( Index i=0; i<nhalf; ++i ) {
+    Index irev = 0;
+    for ( Index ibit=0; ibit<nbit; ++ibit ) if ( i & (Index(1) << ibit) ) irev |= Index(1) << (nbit - 1 - ibit);
+    m_bitrev[i] = irev;
+  }
+  for ( Index k=0; k<nhalf/2; ++k ) m_twiddle.push_back(std::polar(1.0, -2.0*M_PI*k/nhalf));
+  for ( Index k=0; k<nhalf; ++k ) m_split.push_back(std::polar(1.0, -2.0*M_PI*k/n));
+  m_half.resize(nhalf);
+}
+
+//**********************************************************************
+
+int FembRealFft::transform(const double* in, Complex* out) {
+  if ( ! isValid() ) return 1;
+  transformHalf(in);
+  for ( Index k=0; k<nbin(); ++k ) out[k] = amplitude(k);
+  return 0;
+}
+
+//**********************************************************************
+
+int FembRealFft::addPower(const double* in, double* pow) {
+  if ( ! isValid() ) return 1;
+  transformHalf(in);
+  for ( Index k=0; k<nbin(); ++k ) pow[k] += std::norm(amplitude(k));
+  return 0;
+}
+
+//**********************************************************************
+
+void FembRealFft::transformHalf(const double* in) {
+  Index nhalf = m_n/2;
+  Complex* z = m_half.data();
+  for ( Index j=0; j<nhalf; ++j ) z[m_bitrev[j]] = Complex(in[2*j], in[2*j+1]);
+  for ( Index len=2; len<=nhalf; len*=2 ) {
+    Index step = nhalf/len;
+    Index hlen = len/2;
+    for ( Index i=0; i<nhalf; i+=len ) {
+      for ( Index j=0; j<hlen; ++j ) {
+        Complex t = m_twiddle[j*step]*z[i+j+hlen];
+        z[i+j+hlen] = z[i+j] - t;
+        z[i+j] += t;
+      }
+    }
+  }
+}
+
+//**********************************************************************
+
+Complex FembRealFft::amplitude(Index k) const {
+  // Separate the transforms of the even and odd samples.
+  Index nhalf = m_n/2;
+  Complex zk = m_half[k%nhalf];
+  Complex zc = std::conj(m_half[(nhalf - k)%nhalf]);
+  Complex even = 0.5*(zk + zc);
+  Complex odd = Complex(0.0, -0.5)*(zk - zc);
+  return k < nhalf ? even + m_split[k]*odd : even - odd;
+}
+
+//**********************************************************************
@@ -0,0 +1,65 @@
+// FembRealFft.h
+//
+// Radix-2 FFT of real data with a plan, i.e. the bit-reversal table and
+// twiddle factors, computed once and reused for every transform of the
+// same length.
+//
+// A real sequence of length n is transformed with one complex FFT of
+// length n/2 of the even and odd samples packed as real and imaginary
+// parts. The result is the n/2 + 1 non-negative frequency amplitudes
+//   X_k = sum_j x_j exp(-2 pi i j k/n),  k = 0, ..., n/2.
+//
+// The transform uses internal work space, so an object should not be used
+// by more than one thread at a time.
+
+#ifndef FembRealFft_H
+#define FembRealFft_H
+
+#include <vector>
+#include <complex>
+
+class FembRealFft {
+
+public:
+
+  using Index = unsigned int;
+  using Complex = std::complex<double>;
+
+  // Ctor from the length, which must be a power of two and at least 2.
+  explicit FembRealFft(Index n);
+
+  // Return if the length is valid.
+  bool isValid() const { return m_n > 0; }
+
+  // Length and number of output bins.
+  Index size() const { return m_n; }
+  Index nbin() const { return m_n/2 + 1; }
+
+  // Transform size() values into nbin() amplitudes.
+  // Returns 0 for success.
+  int transform(const double* in, Complex* out);
+
+  // Add |X_k|^2 to pow[k] for the nbin() amplitudes.
+  // Returns 0 for success.
+  int addPower(const double* in, double* pow);
+
+  // Return if a value is a power of two.
+  static bool isPowerOfTwo(Index n) { return n > 0 && (n & (n - 1)) == 0; }
+
+private:
+
+  // Transform into the work space m_half.
+  void transformHalf(const double* in);
+
+  // Return amplitude k from the work space.
+  Complex amplitude(Index k) const;
+
+  Index m_n;
+  std::vector<Index> m_bitrev;        // Bit reversal of the half-length indices
+  std::vector<Complex> m_twiddle;     // exp(-2 pi i k/(n/2)), k < n/4
+  std::vector<Complex> m_split;       // exp(-2 pi i k/n), k < n/2
+  std::vector<Complex> m_half;        // Work space
+
+};
+
+#endif
@@ -0,0 +1,369 @@
+// FembRoiFinder.cxx
+
+#include "FembRoiFinder.h"
+#include "dune/DuneInterface/AdcChannelData.h"
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FembRoiFinder_X86 1
+#include <immintrin.h>
+#else
+#define FembRoiFinder_X86 0
+#endif
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using Index = FembRoiFinder::Index;
+using IntVector = DataMap::IntVector;
+using FloatVector = DataMap::FloatVector;
+
+namespace {
+
+// Summary for one ROI.
+struct RoiStats {
+  float sigmin = 0.0;
+  float sigmax = 0.0;
+  float area = 0.0;
+  Index tickmin = 0;
+  Index tickmax = 0;
+  Index nunder = 0;
+  Index nover = 0;
+};
+
+//**********************************************************************
+
+void roiStatsScalar(const AdcSignal* psam, const AdcFlag* pflg, Index nsam, RoiStats& st) {
+  float sigmin = psam[0];
+  float sigmax = psam[0];
+  Index tickmin = 0;
+  Index tickmax = 0;
+  float area = 0.0;
+  for ( Index isam=0; isam<nsam; ++isam ) {
+    float sig = psam[isam];
+    if ( sig < sigmin ) {
+      sigmin = sig;
+      tickmin = isam;
+    }
+    if ( sig > sigmax ) {
+      sigmax = sig;
+      tickmax = isam;
+    }
+    area += sig;
+  }
+  st.sigmin = sigmin;
+  st.sigmax = sigmax;
+  st.tickmin = tickmin;
+  st.tickmax = tickmax;
+  st.area = area;
+  st.nunder = 0;
+  st.nover = 0;
+  if ( pflg == nullptr ) return;
+  for ( Index isam=0; isam<nsam; ++isam ) {
+    st.nunder += pflg[isam] == AdcUnderflow;
+    st.nover += pflg[isam] == AdcOverflow;
+  }
+}
+
+//**********************************************************************
+
+void thresholdScalar(const AdcSignal* psam, Index isam0, Index isam1,
+                     float thrPos, float thrNeg, FembRoiFinder::RoiBuilder& bld) {
+  for ( Index isam=isam0; isam<isam1; ++isam ) {
+    float sig = psam[isam];
+    if ( sig > thrPos || sig < thrNeg ) bld.add(isam);
+  }
+}
+
+//**********************************************************************
+
+#if FembRoiFinder_X86
+
+__attribute__((target("avx2")))
+float hmin(__m256 v) {
+  __m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+__attribute__((target("avx2")))
+float hmax(__m256 v) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+__attribute__((target("avx2")))
+float hsum(__m256 v) {
+  __m128 m = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_add_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+// Return the first tick with sample equal to val.
+__attribute__((target("avx2")))
+Index firstEqual(const AdcSignal* psam, Index nsam, float val) {
+  const __m256 vval = _mm256_set1_ps(val);
+  Index isam = 0;
+  for ( ; isam+8<=nsam; isam+=8 ) {
+    int bits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(psam + isam), vval, _CMP_EQ_OQ));
+    if ( bits ) return isam + __builtin_ctz(bits);
+  }
+  for ( ; isam<nsam; ++isam ) if ( psam[isam] == val ) return isam;
+  return 0;
+}
+
+// Return the number of flags equal to flg.
+__attribute__((target("avx2")))
+Index countFlag(const AdcFlag* pflg, Index nsam, AdcFlag flg) {
+  static_assert(sizeof(AdcFlag) == 2, "AVX2 flag count assumes 16-bit flags");
+  const __m256i vflg = _mm256_set1_epi16(flg);
+  Index count = 0;
+  Index isam = 0;
+  for ( ; isam+16<=nsam; isam+=16 ) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pflg + isam));
+    unsigned int bits = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vflg));
+    count += __builtin_popcount(bits)/2;
+  }
+  for ( ; isam<nsam; ++isam ) count += pflg[isam] == flg;
+  return count;
+}
+
+__attribute__((target("avx2")))
+void roiStatsAvx2(const AdcSignal* psam, const AdcFlag* pflg, Index nsam, RoiStats& st) {
+  if ( nsam < 8 ) {
+    roiStatsScalar(psam, pflg, nsam, st);
+    return;
+  }
+  __m256 vmin = _mm256_loadu_ps(psam);
+  __m256 vmax = vmin;
+  __m256 vsum = _mm256_setzero_ps();
+  Index isam = 0;
+  for ( ; isam+8<=nsam; isam+=8 ) {
+    __m256 v = _mm256_loadu_ps(psam + isam);
+    vmin = _mm256_min_ps(vmin, v);
+    vmax = _mm256_max_ps(vmax, v);
+    vsum = _mm256_add_ps(vsum, v);
+  }
+  float sigmin = hmin(vmin);
+  float sigmax = hmax(vmax);
+  float area = hsum(vsum);
+  for ( ; isam<nsam; ++isam ) {
+    float sig = psam[isam];
+    if ( sig < sigmin ) sigmin = sig;
+    if ( sig > sigmax ) sigmax = sig;
+    area += sig;
+  }
+  st.tickmin = firstEqual(psam, nsam, sigmin);
+  st.tickmax = firstEqual(psam, nsam, sigmax);
+  st.sigmin = psam[st.tickmin];
+  st.sigmax = psam[st.tickmax];
+  st.area = area;
+  st.nunder = pflg == nullptr ? 0 : countFlag(pflg, nsam, AdcUnderflow);
+  st.nover = pflg == nullptr ? 0 : countFlag(pflg, nsam, AdcOverflow);
+}
+
+__attribute__((target("avx2")))
+void thresholdAvx2(const AdcSignal* psam, Index nsam,
+                   float thrPos, float thrNeg, FembRoiFinder::RoiBuilder& bld) {
+  const __m256 vpos = _mm256_set1_ps(thrPos);
+  const __m256 vneg = _mm256_set1_ps(thrNeg);
+  Index isam = 0;
+  for ( ; isam+8<=nsam; isam+=8 ) {
+    __m256 v = _mm256_loadu_ps(psam + isam);
+    __m256 vabove = _mm256_or_ps(_mm256_cmp_ps(v, vpos, _CMP_GT_OQ),
+                                 _mm256_cmp_ps(v, vneg, _CMP_LT_OQ));
+    unsigned int bits = _mm256_movemask_ps(vabove);
+    while ( bits ) {
+      bld.add(isam + __builtin_ctz(bits));
+      bits &= bits - 1;
+    }
+  }
+  thresholdScalar(psam, isam, nsam, thrPos, thrNeg, bld);
+}
+
+#endif
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+bool FembRoiFinder::haveAvx2() {
+#if FembRoiFinder_X86
+  static bool val = __builtin_cpu_supports("avx2");
+  return val;
+#else
+  return false;
+#endif
+}
+
+//**********************************************************************
+
+void FembRoiFinder::
+findThresholdRois(const AdcSignal* psam, Index nsam, const Config& cfg, AdcRoiVector& rois) {
+  const float infinity = std::numeric_limits<float>::infinity();
+  const float thrPos = cfg.flagPositive ? cfg.threshold : infinity;
+  const float thrNeg = cfg.flagNegative ? -cfg.threshold : -infinity;
+  RoiBuilder bld(nsam, cfg.binsBefore, cfg.binsAfter, rois);
+#if FembRoiFinder_X86
+  if ( cfg.useSimd && haveAvx2() ) {
+    thresholdAvx2(psam, nsam, thrPos, thrNeg, bld);
+    bld.finish();
+    return;
+  }
+#endif
+  thresholdScalar(psam, 0, nsam, thrPos, thrNeg, bld);
+  bld.finish();
+}
+
+//**********************************************************************
+
+void FembRoiFinder::findRegularRois(Index nsam, Index period, Index length, AdcRoiVector& rois) {
+  if ( nsam == 0 ) return;
+  if ( period == 0 ) {
+    rois.emplace_back(0, nsam - 1);
+    return;
+  }
+  if ( length == 0 ) length = period;
+  for ( Index isam=0; isam<nsam; isam+=period ) {
+    Index isam2 = isam + length < nsam ? isam + length : nsam;
+    rois.emplace_back(isam, isam2 - 1);
+  }
+}
+
+//**********************************************************************
+
+void FembRoiFinder::fillSignal(AdcChannelData& acd) {
+  Index nsam = acd.samples.size();
+  acd.signal.assign(nsam, false);
+  for ( const AdcRoi& roi : acd.rois ) {
+    Index isam2 = roi.second < nsam ? roi.second + 1 : nsam;
+    for ( Index isam=roi.first; isam<isam2; ++isam ) acd.signal[isam] = true;
+  }
+}
+
+//**********************************************************************
+
+void FembRoiFinder::summarize(const AdcChannelData& acd, DataMap& res, bool useSimd) {
+  Index nsam = acd.samples.size();
+  Index nroi = acd.rois.size();
+  const AdcSignal* psam = acd.samples.data();
+  const AdcFlag* pflg = acd.flags.size() == nsam ? acd.flags.data() : nullptr;
+  bool doSimd = false;
+#if FembRoiFinder_X86
+  doSimd = useSimd && haveAvx2();
+#endif
+  IntVector tick0s, nticks, tickmins, tickmaxs, nunders, novers;
+  FloatVector sigmins, sigmaxs, areas;
+  tick0s.reserve(nroi);
+  nticks.reserve(nroi);
+  tickmins.reserve(nroi);
+  tickmaxs.reserve(nroi);
+  nunders.reserve(nroi);
+  novers.reserve(nroi);
+  sigmins.reserve(nroi);
+  sigmaxs.reserve(nroi);
+  areas.reserve(nroi);
+  for ( const AdcRoi& roi : acd.rois ) {
+    Index isam1 = roi.first;
+    Index isam2 = roi.second < nsam ? roi.second + 1 : nsam;
+    if ( isam1 >= isam2 ) continue;
+    Index nroisam = isam2 - isam1;
+    const AdcFlag* pflgRoi = pflg == nullptr ? nullptr : pflg + isam1;
+    RoiStats st;
+#if FembRoiFinder_X86
+    if ( doSimd ) roiStatsAvx2(psam + isam1, pflgRoi, nroisam, st);
+    else roiStatsScalar(psam + isam1, pflgRoi, nroisam, st);
+#else
+    roiStatsScalar(psam + isam1, pflgRoi, nroisam, st);
+#endif
+    tick0s.push_back(isam1);
+    nticks.push_back(nroisam);
+    tickmins.push_back(st.tickmin);
+    tickmaxs.push_back(st.tickmax);
+    nunders.push_back(st.nunder);
+    novers.push_back(st.nover);
+    sigmins.push_back(st.sigmin);
+    sigmaxs.push_back(st.sigmax);
+    areas.push_back(st.area);
+  }
+  res.setInt("roiCount", tick0s.size());
+  res.setInt("roiNTickChannel", nsam);
+  res.setIntVector("roiTick0s", tick0s);
+  res.setIntVector("roiNTicks", nticks);
+  res.setIntVector("roiTickMins", tickmins);
+  res.setIntVector("roiTickMaxs", tickmaxs);
+  res.setIntVector("roiNUnderflows", nunders);
+  res.setIntVector("roiNOverflows", novers);
+  res.setFloatVector("roiSigMins", sigmins);
+  res.setFloatVector("roiSigMaxs", sigmaxs);
+  res.setFloatVector("roiSigAreas", areas);
+}
+
+//**********************************************************************
+
+Index FembRoiFinder::compareSummary(const DataMap& res, const DataMap& resref, float tol) {
+  Index ndiff = 0;
+  for ( string name : {"roiCount", "roiNTickChannel"} ) {
+    if ( res.getInt(name) != resref.getInt(name) ) ++ndiff;
+  }
+  for ( string name : {"roiTick0s", "roiNTicks", "roiTickMins", "roiTickMaxs",
+                       "roiNUnderflows", "roiNOverflows"} ) {
+    const IntVector& vals = res.getIntVector(name);
+    const IntVector& refs = resref.getIntVector(name);
+    Index nval = vals.size() < refs.size() ? vals.size() : refs.size();
+    ndiff += vals.size() + refs.size() - 2*nval;
+    for ( Index ival=0; ival<nval; ++ival ) if ( vals[ival] != refs[ival] ) ++ndiff;
+  }
+  for ( string name : {"roiSigMins", "roiSigMaxs", "roiSigAreas"} ) {
+    const FloatVector& vals = res.getFloatVector(name);
+    const FloatVector& refs = resref.getFloatVector(name);
+    Index nval = vals.size() < refs.size() ? vals.size() : refs.size();
+    ndiff += vals.size() + refs.size() - 2*nval;
+    for ( Index ival=0; ival<nval; ++ival ) {
+      float lim = tol*(1.0 + std::fabs(refs[ival]));
+      if ( std::fabs(vals[ival] - refs[ival]) > lim ) ++ndiff;
+    }
+  }
+  return ndiff;
+}
+
+//**********************************************************************
+
+FembRoiFinder::FembRoiFinder(const Config& cfg) : m_cfg(cfg) { }
+
+//**********************************************************************
+
+DataMap FembRoiFinder::update(AdcChannelData& acd) const {
+  const string myname = "FembRoiFinder::update: ";
+  DataMap res;
+  Index nsam = acd.samples.size();
+  if ( nsam == 0 ) {
+    cout << myname << "Channel " << acd.channel << " has no samples." << endl;
+    return res.setStatus(1);
+  }
+  if ( m_cfg.mode == ThresholdMode ) {
+    acd.rois.clear();
+    findThresholdRois(acd.samples.data(), nsam, m_cfg, acd.rois);
+  } else {
+    Index period = m_cfg.period;
+    Index length = m_cfg.length;
+    if ( period == 0 && acd.rois.size() ) {
+      period = acd.rois[0].second + 1 - acd.rois[0].first;
+      if ( length == 0 ) length = period;
+    }
+    acd.rois.clear();
+    findRegularRois(nsam, period, length, acd.rois);
+  }
+  fillSignal(acd);
+  summarize(acd, res, m_cfg.useSimd);
+  return res;
+}
+
+//**********************************************************************
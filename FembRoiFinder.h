@@ -0,0 +1,122 @@
+// FembRoiFinder.h
+//
+// ADC channel tool that finds ROIs in prepared samples and summarizes them.
+// Two modes are supported:
+//
+//   ThresholdMode - Same as AdcThresholdSignalFinder: ticks with a sample
+//                   beyond the threshold are kept with binsBefore ticks
+//                   before and binsAfter ticks after.
+//     RegularMode - Same as AdcRegularSignalFinder: ROIs of the given length
+//                   start every period ticks. If the period is zero, it is taken
+//                   from the first ROI in the channel data. If the length is
+//                   zero, it is the period.
+//
+// The update result holds the ROI summary also produced by adcRoiViewer:
+//   roiCount - # ROIs
+//   roiNTickChannel - # ticks in the channel
+//   roiTick0s, roiNTicks - First tick and # ticks for each ROI
+//   roiSigMins, roiSigMaxs - Min and max sample in each ROI
+//   roiTickMins, roiTickMaxs - Tick (relative to the ROI) of the first min and max
+//   roiSigAreas - Sum of the samples in each ROI
+//   roiNUnderflows, roiNOverflows - # under and overflows in each ROI
+//
+// The threshold scan and the summary reductions use AVX2 if the CPU supports
+// it, chosen at run time. Otherwise or if useSimd is false, scalar code is used.
+// ROI boundaries and min/max do not depend on that choice. Areas may differ
+// by rounding because the sum order differs.
+
+#ifndef FembRoiFinder_H
+#define FembRoiFinder_H
+
+#include "dune/DuneInterface/AdcTypes.h"
+#include "dune/DuneInterface/Tool/AdcChannelTool.h"
+
+class FembRoiFinder : public AdcChannelTool {
+
+public:
+
+  using Index = unsigned int;
+
+  enum Mode { ThresholdMode, RegularMode };
+
+  struct Config {
+    Mode mode =ThresholdMode;
+    float threshold =0.0;       // Signal threshold in sample units
+    bool flagPositive =true;    // Keep samples above threshold
+    bool flagNegative =true;    // Keep samples below -threshold
+    Index binsBefore =0;        // # ticks added before each signal tick
+    Index binsAfter =0;         // # ticks added after each signal tick
+    Index period =0;            // Regular ROI period
+    Index length =0;            // Regular ROI length
+    bool useSimd =true;         // Use AVX2 if available
+  };
+
+  // Merges the windows around signal ticks into ROIs.
+  // Ticks must be added in increasing order.
+  class RoiBuilder {
+  public:
+    RoiBuilder(Index nsam, Index before, Index after, AdcRoiVector& rois)
+    : m_nsam(nsam), m_before(before), m_after(after), m_rois(rois),
+      m_haveRoi(false), m_begin(0), m_end(0) { }
+    void add(Index isam) {
+      Index lo = isam > m_before ? isam - m_before : 0;
+      Index hi = isam + m_after < m_nsam ? isam + m_after : m_nsam - 1;
+      if ( m_haveRoi && lo <= m_end + 1 ) {
+        m_end = hi;
+        return;
+      }
+      if ( m_haveRoi ) m_rois.emplace_back(m_begin, m_end);
+      m_begin = lo;
+      m_end = hi;
+      m_haveRoi = true;
+    }
+    void finish() {
+      if ( m_haveRoi ) m_rois.emplace_back(m_begin, m_end);
+      m_haveRoi = false;
+    }
+  private:
+    Index m_nsam;
+    Index m_before;
+    Index m_after;
+    AdcRoiVector& m_rois;
+    bool m_haveRoi;
+    Index m_begin;
+    Index m_end;
+  };
+
+  // Return if the AVX2 code can be used on this CPU.
+  static bool haveAvx2();
+
+  // Append the threshold ROIs for samples psam[0:nsam] to rois.
+  static void findThresholdRois(const AdcSignal* psam, Index nsam, const Config& cfg,
+                                AdcRoiVector& rois);
+
+  // Append the regular ROIs for nsam ticks to rois.
+  static void findRegularRois(Index nsam, Index period, Index length, AdcRoiVector& rois);
+
+  // Set the signal flags from the ROIs.
+  static void fillSignal(AdcChannelData& acd);
+
+  // Add the summary of the ROIs in acd to res.
+  static void summarize(const AdcChannelData& acd, DataMap& res, bool useSimd =true);
+
+  // Return the number of ROI summary values in res that differ from those in resref.
+  // Floats are compared with relative tolerance tol.
+  static Index compareSummary(const DataMap& res, const DataMap& resref, float tol =1.e-4);
+
+  // Ctor from configuration.
+  explicit FembRoiFinder(const Config& cfg);
+
+  // Find the ROIs, set the signal flags and return the summary.
+  DataMap update(AdcChannelData& acd) const override;
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+
+private:
+
+  Config m_cfg;
+
+};
+
+#endif
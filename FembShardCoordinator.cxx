@@ -0,0 +1,523 @@
+// FembShardCoordinator.cxx
+
+#include "FembShardCoordinator.h"
+#include "FembTestAnalyzer.h"
+#include "FembCalibTable.h"
+#include "FembCheckpoint.h"
+#include "FembCalibDatabase.h"
+#include "TSystem.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <deque>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::ostringstream;
+using std::istringstream;
+
+using Index = FembShardCoordinator::Index;
+using Name = FembShardCoordinator::Name;
+
+namespace {
+
+// Send all bytes. Returns 0 for success.
+int sendAll(int fd, const char* buf, size_t nbyte) {
+  while ( nbyte ) {
+    ssize_t nsent = ::send(fd, buf, nbyte, MSG_NOSIGNAL);
+    if ( nsent < 0 ) {
+      if ( errno == EINTR ) continue;
+      return 1;
+    }
+    buf += nsent;
+    nbyte -= nsent;
+  }
+  return 0;
+}
+
+// Send a header line and payload. Returns 0 for success.
+int sendMessage(int fd, const string& header, const string& payload =string()) {
+  string msg = header + "\n" + payload;
+  return sendAll(fd, msg.data(), msg.size());
+}
+
+// Buffered reader for a socket.
+class SocketReader {
+public:
+  explicit SocketReader(int fd) : m_fd(fd) { }
+  // Read a line without the newline. Returns 0 for success.
+  int readLine(string& line) {
+    string::size_type ipos;
+    while ( (ipos = m_buf.find('\n')) == string::npos ) {
+      if ( fill() ) return 1;
+    }
+    line = m_buf.substr(0, ipos);
+    m_buf.erase(0, ipos + 1);
+    return 0;
+  }
+  // Read nbyte bytes. Returns 0 for success.
+  int readBytes(size_t nbyte, string& out) {
+    while ( m_buf.size() < nbyte ) {
+      if ( fill() ) return 1;
+    }
+    out = m_buf.substr(0, nbyte);
+    m_buf.erase(0, nbyte);
+    return 0;
+  }
+private:
+  int fill() {
+    char buf[65536];
+    while ( true ) {
+      ssize_t nread = ::read(m_fd, buf, sizeof(buf));
+      if ( nread < 0 && errno == EINTR ) continue;
+      if ( nread <= 0 ) return 1;
+      m_buf.append(buf, nread);
+      return 0;
+    }
+  }
+  int m_fd;
+  string m_buf;
+};
+
+// Write a list as NAME N V1 V2 ...
+template<typename T>
+void writeValues(ostringstream& ssout, Name name, const std::vector<T>& vals) {
+  ssout << name << " " << vals.size();
+  for ( const T& val : vals ) ssout << " " << val;
+  ssout << "\n";
+}
+
+// Read a list written by writeValues. Returns 0 for success.
+template<typename T>
+int readValues(istringstream& ssin, std::vector<T>& vals) {
+  size_t nval = 0;
+  if ( ! (ssin >> nval) ) return 1;
+  vals.resize(nval);
+  for ( T& val : vals ) ssin >> val;
+  return ssin ? 0 : 2;
+}
+
+// Coordinator view of a worker.
+struct Worker {
+  pid_t pid;
+  int fd;
+  SocketReader reader;
+  Index ids;
+  bool ready;     // Waiting for a job
+  bool busy;
+  bool open;
+  bool exiting;
+  Worker(pid_t a_pid, int a_fd)
+  : pid(a_pid), fd(a_fd), reader(a_fd), ids(0),
+    ready(false), busy(false), open(true), exiting(false) { }
+};
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembShardCoordinator::FembShardCoordinator(const FembCampaign& camp, Index nproc)
+: m_camp(camp), m_nproc(nproc > 0 ? nproc : 1),
+  m_valueNames({"pedMin", "pedMax", "fitGainHeight", "adcminWithPed",
+                "lowSaturatedRawAdcMax", "linFitChiSquareDofHeight"}),
+  m_resultFileName("campaign_results.txt"), m_pchk(nullptr) { }
+
+//**********************************************************************
+
+Index FembShardCoordinator::run() {
+  const string myname = "FembShardCoordinator::run: ";
+  Index nds = m_camp.datasets().size();
+  m_results.assign(nds, Result());
+  if ( nds == 0 ) return 0;
+  // Take the results of completed datasets from the checkpoint and skip
+  // those that are quarantined or have no attempts left.
+  std::deque<Index> pending;
+  for ( Index ids=0; ids<nds; ++ids ) {
+    if ( m_pchk != nullptr ) {
+      Name jobName = checkpointJobName(ids);
+      Result& res = m_results[ids];
+      string payload;
+      if ( m_pchk->isDone(jobName) && m_pchk->readRecord(jobName, payload) == 0 &&
+           decode(payload, res) == 0 ) {
+        res.status = 0;
+        continue;
+      }
+      res = Result();
+      FembCheckpoint::Entry ent = m_pchk->entry(m_camp.datasets()[ids].name());
+      if ( ent.status == FembCheckpoint::Quarantined ) {
+        res.status = ent.error ? ent.error : -1;
+        continue;
+      }
+      if ( ! m_pchk->shouldRun(jobName) ) {
+        int error = m_pchk->entry(jobName).error;
+        res.status = error ? error : -1;
+        continue;
+      }
+    }
+    pending.push_back(ids);
+  }
+  if ( pending.size() < nds ) {
+    cout << myname << "Skipping " << nds - pending.size() << " datasets recorded in checkpoint "
+         << m_pchk->dirName() << endl;
+  }
+  Index nproc = m_nproc < pending.size() ? m_nproc : pending.size();
+  // Flush so buffered output is not repeated by the workers.
+  cout.flush();
+  std::vector<Worker> wkrs;
+  for ( Index iproc=0; iproc<nproc; ++iproc ) {
+    int fds[2];
+    if ( socketpair(AF_UNIX, SOCK_STREAM, 0, fds) ) {
+      cout << myname << "Unable to create socket pair." << endl;
+      break;
+    }
+    pid_t pid = fork();
+    if ( pid < 0 ) {
+      cout << myname << "Unable to fork worker." << endl;
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+    if ( pid == 0 ) {
+      close(fds[0]);
+      for ( const Worker& wkr : wkrs ) close(wkr.fd);
+      work(fds[1]);
+    }
+    close(fds[1]);
+    wkrs.emplace_back(pid, fds[0]);
+  }
+  if ( wkrs.size() == 0 && pending.size() ) return nds;
+  if ( wkrs.size() ) {
+    cout << myname << "Running " << pending.size() << " datasets in " << wkrs.size()
+         << " processes." << endl;
+  }
+  Index nopen = wkrs.size();
+  while ( nopen ) {
+    std::vector<pollfd> pfds;
+    std::vector<Index> iwkrs;
+    for ( Index iwkr=0; iwkr<wkrs.size(); ++iwkr ) {
+      if ( ! wkrs[iwkr].open ) continue;
+      pollfd pfd;
+      pfd.fd = wkrs[iwkr].fd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      pfds.push_back(pfd);
+      iwkrs.push_back(iwkr);
+    }
+    if ( poll(pfds.data(), pfds.size(), -1) < 0 ) {
+      if ( errno == EINTR ) continue;
+      cout << myname << "Poll failed." << endl;
+      break;
+    }
+    for ( Index ipfd=0; ipfd<pfds.size(); ++ipfd ) {
+      if ( pfds[ipfd].revents == 0 ) continue;
+      Worker& wkr = wkrs[iwkrs[ipfd]];
+      string line;
+      bool lost = wkr.reader.readLine(line) != 0;
+      if ( ! lost ) {
+        istringstream ssline(line);
+        string cmd;
+        ssline >> cmd;
+        if ( cmd == "DONE" ) {
+          Index ids = nds;
+          int stat = -1;
+          size_t nbyte = 0;
+          ssline >> ids >> stat >> nbyte;
+          string payload;
+          if ( wkr.reader.readBytes(nbyte, payload) ) {
+            lost = true;
+          } else if ( ids < nds ) {
+            Result& res = m_results[ids];
+            if ( decode(payload, res) ) {
+              cout << myname << "Invalid result for dataset " << ids << endl;
+              stat = 99;
+            }
+            res.status = stat;
+            wkr.busy = false;
+            wkr.ready = true;
+            cout << myname << "Dataset " << m_camp.datasets()[ids].name()
+                 << " finished with status " << stat << endl;
+            if ( stat == 0 && m_pchk != nullptr ) {
+              m_pchk->writeRecord(checkpointJobName(ids), payload);
+              m_pchk->setDone(checkpointJobName(ids));
+            } else if ( stat ) {
+              recordFailure(ids, stat, false, pending);
+            }
+          }
+        } else if ( cmd == "READY" ) {
+          wkr.ready = true;
+        } else {
+          cout << myname << "Unexpected message from worker " << wkr.pid << ": " << line << endl;
+        }
+      }
+      if ( lost ) {
+        if ( wkr.busy ) {
+          cout << myname << "Worker " << wkr.pid << " died while processing dataset "
+               << m_camp.datasets()[wkr.ids].name() << endl;
+          m_results[wkr.ids].status = -2;
+          recordFailure(wkr.ids, -2, true, pending);
+        }
+        close(wkr.fd);
+        wkr.open = false;
+        wkr.busy = false;
+        --nopen;
+      }
+    }
+    // Hand out pending datasets to the waiting workers. The workers are told
+    // to exit when nothing is pending or running, because a dataset may be
+    // requeued until then.
+    bool anyBusy = false;
+    for ( const Worker& wkr : wkrs ) if ( wkr.open && wkr.busy ) anyBusy = true;
+    for ( Worker& wkr : wkrs ) {
+      if ( ! wkr.open || ! wkr.ready || wkr.exiting ) continue;
+      if ( pending.size() ) {
+        ostringstream sshdr;
+        sshdr << "JOB " << pending.front();
+        if ( sendMessage(wkr.fd, sshdr.str()) ) continue;
+        wkr.ids = pending.front();
+        pending.pop_front();
+        wkr.ready = false;
+        wkr.busy = true;
+        anyBusy = true;
+      } else if ( ! anyBusy ) {
+        sendMessage(wkr.fd, "EXIT");
+        wkr.exiting = true;
+      }
+    }
+  }
+  for ( const Worker& wkr : wkrs ) {
+    if ( wkr.open ) close(wkr.fd);
+    int wstat = 0;
+    waitpid(wkr.pid, &wstat, 0);
+  }
+  Index nfail = 0;
+  for ( const Result& res : m_results ) if ( res.status != 0 ) ++nfail;
+  cout << myname << "Datasets failed: " << nfail << " of " << nds << endl;
+  writeOutputs();
+  return nfail;
+}
+
+//**********************************************************************
+
+Name FembShardCoordinator::checkpointJobName(Index ids) const {
+  return m_camp.datasets()[ids].name() + "_shard";
+}
+
+//**********************************************************************
+
+void FembShardCoordinator::
+recordFailure(Index ids, int stat, bool crashed, std::deque<Index>& pending) const {
+  const string myname = "FembShardCoordinator::recordFailure: ";
+  if ( m_pchk == nullptr ) return;
+  const FembCampaign::Dataset& ds = m_camp.datasets()[ids];
+  Name jobName = checkpointJobName(ids);
+  if ( stat == FembCampaign::badInputStatus() ) {
+    m_pchk->setQuarantined(ds.name(), stat, ds.path);
+    return;
+  }
+  m_pchk->setFailed(jobName, stat);
+  if ( m_pchk->shouldRun(jobName) ) {
+    cout << myname << "Retrying dataset " << ds.name() << endl;
+    pending.push_back(ids);
+  } else if ( crashed ) {
+    // Input that repeatedly kills the worker is taken to be corrupt.
+    m_pchk->setQuarantined(ds.name(), stat, ds.path);
+  }
+}
+
+//**********************************************************************
+
+void FembShardCoordinator::work(int fd) const {
+  const string myname = "FembShardCoordinator::work: ";
+  // Nothing may propagate out of here: the worker is a copy of the caller
+  // and must not return into its code.
+  int wstat = 0;
+  try {
+    SocketReader reader(fd);
+    int rstat = sendMessage(fd, "READY");
+    string line;
+    while ( rstat == 0 && reader.readLine(line) == 0 ) {
+      istringstream ssline(line);
+      string cmd;
+      Index ids = 0;
+      ssline >> cmd >> ids;
+      if ( cmd != "JOB" ) break;
+      string payload;
+      int stat = 0;
+      try {
+        stat = analyze(ids, payload);
+      } catch ( std::exception& exc ) {
+        cout << myname << "ERROR: Dataset " << ids << " raised exception: " << exc.what() << endl;
+        stat = 6;
+      } catch ( ... ) {
+        cout << myname << "ERROR: Dataset " << ids << " raised an unknown exception." << endl;
+        stat = 6;
+      }
+      if ( stat == 6 ) payload.clear();
+      ostringstream sshdr;
+      sshdr << "DONE " << ids << " " << stat << " " << payload.size();
+      rstat = sendMessage(fd, sshdr.str(), payload);
+    }
+  } catch ( ... ) {
+    cout << myname << "ERROR: Worker raised an exception." << endl;
+    wstat = 1;
+  }
+  close(fd);
+  cout.flush();
+  _exit(wstat);
+}
+
+//**********************************************************************
+
+int FembShardCoordinator::analyze(Index ids, Name& payload) const {
+  const string myname = "FembShardCoordinator::analyze: ";
+  payload.clear();
+  if ( ids >= m_camp.datasets().size() ) return 1;
+  const FembCampaign::Dataset& ds = m_camp.datasets()[ids];
+  FembTestAnalyzer fta(10, ds.femb, ds.gain, ds.shap, ds.ts, ds.isCold, ds.extPulse, ds.extClock);
+  const DuneFembReader* prdr = fta.reader();
+  if ( prdr == nullptr ) {
+    cout << myname << "No reader found for " << ds.name() << endl;
+    return 2;
+  }
+  if ( prdr->tree() == nullptr || prdr->nChannel() == 0 || prdr->nEvent() == 0 ) {
+    cout << myname << "Input for " << ds.name() << " is corrupt or empty." << endl;
+    return FembCampaign::badInputStatus();
+  }
+  if ( ! fta.haveTools() ) {
+    cout << myname << "Tools not found for " << ds.name() << endl;
+    return 3;
+  }
+  // Channels checkpointed by an earlier attempt are not processed again.
+  if ( m_pchk != nullptr ) fta.setCheckpoint(m_pchk, ds.name());
+  FembCalibTable cal;
+  int cstat = fta.calibTable(cal);
+  if ( prdr->readErrorCount() ) {
+    cout << myname << "Input for " << ds.name() << " has " << prdr->readErrorCount()
+         << " unreadable entries." << endl;
+    return FembCampaign::badInputStatus();
+  }
+  if ( cstat ) return 5;
+  string toolName = fta.calibFclToolName();
+  string fcl = cal.fclText(toolName);
+  ostringstream ssout;
+  ssout << std::setprecision(9);
+  ssout << "calibDir " << fta.calibFclDirName() << "\n";
+  ssout << "calibTool " << toolName << "\n";
+  ssout << "calibFcl " << fcl.size() << "\n" << fcl;
+  ssout << "calibUnits " << cal.units() << "\n";
+  ssout << "calibFemb " << cal.femb() << "\n";
+  ssout << "calibRange " << cal.adcMin() << " " << cal.adcMax() << "\n";
+  writeValues(ssout, "calibGains", cal.gains());
+  writeValues(ssout, "calibAdcMins", cal.adcMins());
+  writeValues(ssout, "calibAdcMaxs", cal.adcMaxs());
+  for ( Index icha=0; icha<fta.nChannel(); ++icha ) {
+    for ( const Name& name : m_valueNames ) {
+      float val = 0.0;
+      if ( fta.channelValue(icha, name, val) == 0 ) {
+        ssout << "value " << icha << " " << name << " " << val << "\n";
+      }
+    }
+  }
+  payload = ssout.str();
+  return 0;
+}
+
+//**********************************************************************
+
+int FembShardCoordinator::decode(const Name& payload, Result& res) {
+  istringstream ssin(payload);
+  string key;
+  while ( ssin >> key ) {
+    if ( key == "calibDir" ) {
+      ssin >> res.calibDir;
+    } else if ( key == "calibTool" ) {
+      ssin >> res.calibTool;
+    } else if ( key == "calibFcl" ) {
+      size_t nbyte = 0;
+      ssin >> nbyte;
+      ssin.get();
+      res.calibFcl.assign(nbyte, ' ');
+      if ( nbyte ) ssin.read(&res.calibFcl[0], nbyte);
+      if ( ! ssin ) return 2;
+    } else if ( key == "calibUnits" ) {
+      string units;
+      ssin >> units;
+      res.calib.setUnits(units);
+    } else if ( key == "calibFemb" ) {
+      FembCalibTable::Index femb = 0;
+      ssin >> femb;
+      res.calib.setFemb(femb);
+    } else if ( key == "calibRange" ) {
+      int amin = 0;
+      int amax = 0;
+      ssin >> amin >> amax;
+      res.calib.setAdcRange(amin, amax);
+    } else if ( key == "calibGains" ) {
+      FembCalibTable::FloatVector vals;
+      if ( readValues(ssin, vals) ) return 3;
+      res.calib.setGains(vals);
+    } else if ( key == "calibAdcMins" || key == "calibAdcMaxs" ) {
+      FembCalibTable::IntVector vals;
+      if ( readValues(ssin, vals) ) return 3;
+      if ( key == "calibAdcMins" ) res.calib.setAdcMins(vals);
+      else res.calib.setAdcMaxs(vals);
+    } else if ( key == "value" ) {
+      string line;
+      getline(ssin, line);
+      if ( line.size() ) res.lines.push_back(line.substr(1));
+    } else {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+int FembShardCoordinator::writeOutputs() const {
+  const string myname = "FembShardCoordinator::writeOutputs: ";
+  int rstat = 0;
+  ofstream fout(m_resultFileName.c_str());
+  for ( Index ids=0; ids<m_results.size(); ++ids ) {
+    const Result& res = m_results[ids];
+    if ( res.status != 0 ) continue;
+    Name dsname = m_camp.datasets()[ids].name();
+    for ( const Name& line : res.lines ) fout << dsname << " " << line << "\n";
+    if ( res.calibDir.size() == 0 || res.calibTool.size() == 0 ) continue;
+    if ( gSystem->AccessPathName(res.calibDir.c_str()) ) gSystem->mkdir(res.calibDir.c_str());
+    Name fclName = res.calibDir + "/" + res.calibTool + ".fcl";
+    ofstream fcl(fclName.c_str());
+    fcl << res.calibFcl;
+    if ( ! fcl ) {
+      cout << myname << "Unable to write " << fclName << endl;
+      rstat = 1;
+    }
+  }
+  if ( ! fout ) {
+    cout << myname << "Unable to write " << m_resultFileName << endl;
+    return 2;
+  }
+  if ( m_calibDbName.size() ) {
+    FembCalibDatabase db;
+    if ( ! gSystem->AccessPathName(m_calibDbName.c_str()) ) db.addFile(m_calibDbName);
+    for ( Index ids=0; ids<m_results.size(); ++ids ) {
+      const Result& res = m_results[ids];
+      if ( res.status != 0 || ! res.calib.isValid() ) continue;
+      if ( db.add(m_camp.datasets()[ids].calibKey(), res.calib) ) rstat = 3;
+    }
+    if ( db.write(m_calibDbName) ) return 4;
+  }
+  cout << myname << "Results written to " << m_resultFileName << endl;
+  return rstat;
+}
+
+//**********************************************************************
@@ -0,0 +1,121 @@
+// FembShardCoordinator.h
+//
+// Runs the datasets of a FembCampaign in forked worker processes so that
+// each analysis has its own ROOT global state (gDirectory, file list,
+// named histograms).
+//
+// The coordinator forks N workers, each connected by a local socket pair.
+// A worker asks for a job, runs the raw analysis (calibTable) for the
+// dataset and sends back a compact result: the calibration FCL and a few
+// values for each channel. The coordinator hands out datasets in order,
+// writes the calibration FCL files and merges the channel values into one
+// results file with lines
+//   DATASET CHANNEL NAME VALUE
+// The calibrations may also be written to one FembCalibDatabase file.
+//
+// Protocol. Each message is a header line optionally followed by a payload:
+//   worker -> coordinator   READY
+//                           DONE IDS STATUS NBYTE  (+ NBYTE bytes of result)
+//   coordinator -> worker   JOB IDS
+//                           EXIT
+//
+// If a worker dies, its dataset is marked failed and the others continue.
+// An exception raised by the analysis is reported as DONE with status 6.
+// A worker always ends with _exit and never returns to the caller.
+//
+// With a checkpoint (see FembCheckpoint), each result is saved as the
+// record DATASET_shard and is taken from there in later runs. The workers
+// also checkpoint the channel results. A failed dataset is retried until
+// it reaches the maximum attempts of the checkpoint. A dataset with corrupt
+// input, or one that kills its worker on every attempt, is quarantined.
+// Everything runs on the local machine. The coordinator must be single
+// threaded when the workers are forked, e.g. not inside FembCampaign::run.
+
+#ifndef FembShardCoordinator_H
+#define FembShardCoordinator_H
+
+#include "FembCampaign.h"
+#include "FembCheckpoint.h"
+#include "FembCalibTable.h"
+#include <string>
+#include <vector>
+#include <deque>
+
+class FembShardCoordinator {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using NameVector = std::vector<Name>;
+
+  // Result received for one dataset.
+  struct Result {
+    int status = -1;        // 0 for success
+    Name calibDir;
+    Name calibTool;
+    Name calibFcl;
+    FembCalibTable calib;
+    NameVector lines;       // CHANNEL NAME VALUE
+  };
+
+  // Ctor from the campaign and the number of worker processes.
+  FembShardCoordinator(const FembCampaign& camp, Index nproc);
+
+  // Channel result values sent by the workers.
+  void setValueNames(const NameVector& names) { m_valueNames = names; }
+
+  // Name of the merged results file.
+  void setResultFileName(Name val) { m_resultFileName = val; }
+
+  // Calibration database written with the results. Tables from an existing
+  // file are kept unless replaced. A blank name disables the database.
+  void setCalibDatabaseName(Name val) { m_calibDbName = val; }
+
+  // Checkpoint for results and job status. Null disables checkpointing.
+  void setCheckpoint(FembCheckpoint* pchk) { m_pchk = pchk; }
+
+  // Run all datasets of the campaign.
+  // Returns the number of datasets that failed.
+  Index run();
+
+  // Getters.
+  Index processCount() const { return m_nproc; }
+  const NameVector& valueNames() const { return m_valueNames; }
+  Name resultFileName() const { return m_resultFileName; }
+  Name calibDatabaseName() const { return m_calibDbName; }
+  const std::vector<Result>& results() const { return m_results; }
+  FembCheckpoint* checkpoint() const { return m_pchk; }
+
+private:
+
+  // Worker loop for the socket fd. Does not return.
+  void work(int fd) const;
+
+  // Analyze a dataset in a worker and return the encoded result.
+  int analyze(Index ids, Name& payload) const;
+
+  // Checkpoint job name for a dataset.
+  Name checkpointJobName(Index ids) const;
+
+  // Record a failed dataset in the checkpoint and requeue it if it has
+  // attempts left.
+  void recordFailure(Index ids, int stat, bool crashed, std::deque<Index>& pending) const;
+
+  // Decode a result payload.
+  static int decode(const Name& payload, Result& res);
+
+  // Write the calibration FCL files and merged results.
+  int writeOutputs() const;
+
+  const FembCampaign& m_camp;
+  Index m_nproc;
+  NameVector m_valueNames;
+  Name m_resultFileName;
+  Name m_calibDbName;
+  std::vector<Result> m_results;   // [ids]
+  FembCheckpoint* m_pchk;
+
+};
+
+#endif
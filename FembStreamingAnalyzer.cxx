@@ -0,0 +1,200 @@
+// FembStreamingAnalyzer.cxx
+
+#include "FembStreamingAnalyzer.h"
+#include "dune/DuneInterface/AdcChannelData.h"
+#include "dune/DuneInterface/Tool/AdcChannelTool.h"
+#include "FembToolPool.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+
+using Index = FembStreamingAnalyzer::Index;
+using Entry = FembStreamingAnalyzer::Entry;
+using Clock = std::chrono::steady_clock;
+
+//**********************************************************************
+
+FembStreamingAnalyzer::FembStreamingAnalyzer(string fname, const Config& cfg)
+: m_cfg(cfg), m_reader(new DuneFembReader(fname)),
+  m_nextEntry(0), m_nEntryFailed(0),
+  m_lastUpdateTime(0.0), m_maxUpdateTime(0.0), m_stop(false) {
+  const string myname = "FembStreamingAnalyzer::ctor: ";
+  m_ptool = FembToolPool::instance("dunefemb.fcl").acquire(m_cfg.pedestalToolName);
+  if ( ! m_ptool ) {
+    cout << myname << "Unable to find pedestal tool " << m_cfg.pedestalToolName << endl;
+  }
+}
+
+//**********************************************************************
+
+FembStreamingAnalyzer::~FembStreamingAnalyzer() {
+  FembToolPool::instance("dunefemb.fcl").release(m_cfg.pedestalToolName, std::move(m_ptool));
+}
+
+//**********************************************************************
+
+int FembStreamingAnalyzer::update() {
+  const string myname = "FembStreamingAnalyzer::update: ";
+  if ( ! haveTool() ) return -1;
+  Clock::time_point start = Clock::now();
+  // Refresh only when the entries found earlier are all processed.
+  if ( m_nextEntry >= m_reader->nEntry() ) {
+    if ( m_reader->refresh(m_cfg.reopen) < 0 ) return 0;
+  }
+  Entry nent = m_reader->nEntry();
+  if ( m_cfg.maxEntryPerUpdate > 0 && nent - m_nextEntry > m_cfg.maxEntryPerUpdate ) {
+    nent = m_nextEntry + m_cfg.maxEntryPerUpdate;
+  }
+  int nproc = 0;
+  for ( ; m_nextEntry<nent; ++m_nextEntry ) {
+    if ( processEntry(m_nextEntry) ) ++m_nEntryFailed;
+    else ++nproc;
+  }
+  m_lastUpdateTime = std::chrono::duration<double>(Clock::now() - start).count();
+  if ( m_lastUpdateTime > m_maxUpdateTime ) m_maxUpdateTime = m_lastUpdateTime;
+  return nproc;
+}
+
+//**********************************************************************
+
+int FembStreamingAnalyzer::run(Callback cb) {
+  const string myname = "FembStreamingAnalyzer::run: ";
+  if ( ! haveTool() ) {
+    cout << myname << "Pedestal tool is missing." << endl;
+    return 1;
+  }
+  m_stop = false;
+  Clock::time_point lastNew = Clock::now();
+  while ( ! m_stop ) {
+    Clock::time_point start = Clock::now();
+    Entry ent0 = m_nextEntry;
+    if ( update() < 0 ) return 2;
+    Entry ent1 = m_nextEntry;
+    if ( ent1 > ent0 ) {
+      lastNew = Clock::now();
+      if ( cb ) cb(*this, ent0, ent1);
+      // Entries are still waiting to be processed.
+      if ( m_nextEntry < m_reader->nEntry() ) continue;
+    } else {
+      double idle = std::chrono::duration<double>(Clock::now() - lastNew).count();
+      if ( idle > m_cfg.idleTimeout ) {
+        cout << myname << "No new entries for " << idle << " sec. Stopping." << endl;
+        break;
+      }
+    }
+    std::chrono::duration<double> wait(m_cfg.pollPeriod);
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(wait));
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+DataMap FembStreamingAnalyzer::channelResult(Index icha) const {
+  DataMap res;
+  if ( icha >= m_chans.size() || m_chans[icha].nevt == 0 ) return res.setStatus(1);
+  const ChannelStats& cs = m_chans[icha];
+  double ped = cs.sumPed/cs.nevt;
+  double var = cs.sumPed2/cs.nevt - ped*ped;
+  float noise = cs.sumNoise/cs.nevt;
+  res.setInt("nEvent", cs.nevt);
+  res.setFloat("pedestal", ped);
+  res.setFloat("pedestalSpread", var > 0.0 ? sqrt(var) : 0.0);
+  res.setFloat("noise", noise);
+  res.setFloat("lastPedestal", cs.lastPed);
+  res.setFloat("lastNoise", cs.lastNoise);
+  res.setFloat("signalMax", cs.sigMax);
+  res.setFloat("signalMin", cs.sigMin);
+  res.setInt("dead", noise < m_cfg.deadNoise);
+  return res;
+}
+
+//**********************************************************************
+
+DataMap FembStreamingAnalyzer::eventResult(Index ievt) const {
+  DataMap res;
+  if ( ievt >= m_evts.size() || m_evts[ievt].ncha == 0 ) return res.setStatus(1);
+  const EventStats& es = m_evts[ievt];
+  res.setInt("nChannel", es.ncha);
+  res.setFloat("meanPedestal", es.sumPed/es.ncha);
+  res.setFloat("meanNoise", es.sumNoise/es.ncha);
+  res.setInt("nDead", es.ndead);
+  return res;
+}
+
+//**********************************************************************
+
+void FembStreamingAnalyzer::print() const {
+  cout << "Streaming analysis of " << m_reader->label() << ": "
+       << m_nextEntry << " entries processed, " << m_nEntryFailed << " failed, "
+       << nEvent() << " events." << endl;
+  cout << "Max update time: " << m_maxUpdateTime << " sec" << endl;
+  cout << "Chan  nevt       ped    spread     noise" << endl;
+  for ( Index icha=0; icha<m_chans.size(); ++icha ) {
+    DataMap res = channelResult(icha);
+    if ( res.status() ) continue;
+    cout << setw(4) << icha << setw(6) << res.getInt("nEvent") << fixed << setprecision(2)
+         << setw(10) << res.getFloat("pedestal")
+         << setw(10) << res.getFloat("pedestalSpread")
+         << setw(10) << res.getFloat("noise");
+    if ( res.getInt("dead") ) cout << "  DEAD";
+    cout << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+}
+
+//**********************************************************************
+
+int FembStreamingAnalyzer::processEntry(Entry ient) {
+  const string myname = "FembStreamingAnalyzer::processEntry: ";
+  AdcChannelData acd;
+  if ( m_reader->readWaveform(ient, &acd) ) {
+    cout << myname << "Unable to read entry " << ient << endl;
+    return 1;
+  }
+  DataMap res = m_ptool->update(acd);
+  if ( res.status() ) {
+    cout << myname << "Pedestal tool returned error " << res.status()
+         << " for entry " << ient << endl;
+    return 2;
+  }
+  Index icha = acd.channel;
+  Index ievt = acd.event;
+  float ped = acd.pedestal;
+  float noise = acd.pedestalRms;
+  float sigMax = 0.0;
+  float sigMin = 0.0;
+  for ( AdcCount adc : acd.raw ) {
+    float sig = adc - ped;
+    if ( sig > sigMax ) sigMax = sig;
+    if ( sig < sigMin ) sigMin = sig;
+  }
+  if ( icha >= m_chans.size() ) m_chans.resize(icha + 1);
+  ChannelStats& cs = m_chans[icha];
+  ++cs.nevt;
+  cs.sumPed += ped;
+  cs.sumPed2 += ped*ped;
+  cs.sumNoise += noise;
+  cs.lastPed = ped;
+  cs.lastNoise = noise;
+  if ( cs.nevt == 1 || sigMax > cs.sigMax ) cs.sigMax = sigMax;
+  if ( cs.nevt == 1 || sigMin < cs.sigMin ) cs.sigMin = sigMin;
+  if ( ievt >= m_evts.size() ) m_evts.resize(ievt + 1);
+  EventStats& es = m_evts[ievt];
+  ++es.ncha;
+  es.sumPed += ped;
+  es.sumNoise += noise;
+  if ( noise < m_cfg.deadNoise ) ++es.ndead;
+  return 0;
+}
+
+//**********************************************************************
@@ -0,0 +1,143 @@
+// FembStreamingAnalyzer.h
+//
+// Online analysis of a FEMB test file that is still being written.
+//
+// The file is followed with DuneFembReader::refresh. Each update picks up
+// the entries (waveforms) appended since the last update, finds the
+// pedestal and noise for each with the pedestal tool (adcPedestalFit by
+// default) and adds them to running channel and event summaries. A dead
+// channel shows up as soon as its first waveform is processed instead of
+// after the test ends.
+//
+// run calls update every pollPeriod seconds until stop is called or no
+// new entries arrive for idleTimeout seconds. The delay from an entry
+// being saved to the file to its inclusion in the results is at most
+// about one poll period plus the processing time for one update, which is
+// bounded with maxEntryPerUpdate. An optional callback is called after
+// each update that adds entries.
+//
+// channelResult(icha) holds
+//   nEvent          - # events processed for the channel
+//   pedestal        - mean pedestal [ADC]
+//   pedestalSpread  - RMS of the pedestal over events [ADC]
+//   noise           - mean pedestal RMS [ADC]
+//   lastPedestal    - pedestal for the last event
+//   lastNoise       - noise for the last event
+//   signalMax       - maximum of raw ADC minus pedestal
+//   signalMin       - minimum of raw ADC minus pedestal
+//   dead            - 1 if the mean noise is below deadNoise
+// eventResult(ievt) holds
+//   nChannel        - # channels processed for the event
+//   meanPedestal    - mean over channels of the pedestal [ADC]
+//   meanNoise       - mean over channels of the noise [ADC]
+//   nDead           - # channels with noise below deadNoise
+
+#ifndef FembStreamingAnalyzer_H
+#define FembStreamingAnalyzer_H
+
+#include "DuneFembReader.h"
+#include "dune/DuneInterface/Data/DataMap.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+
+class AdcChannelTool;
+
+class FembStreamingAnalyzer {
+
+public:
+
+  using Index = unsigned int;
+  using Entry = DuneFembReader::Entry;
+  using Callback = std::function<void(const FembStreamingAnalyzer&, Entry ent0, Entry ent1)>;
+
+  // Configuration.
+  struct Config {
+    double pollPeriod =2.0;                     // Time between updates [sec]
+    double idleTimeout =600.0;                  // run ends after this time with no new entries [sec]
+    Index maxEntryPerUpdate =0;                 // Max entries processed in one update (0 for all)
+    float deadNoise =0.5;                       // Noise [ADC] below which a channel is dead
+    bool reopen =false;                         // Reopen the file for each update
+    std::string pedestalToolName ="adcPedestalFit";
+  };
+
+  // Ctor from the file name. The file need not exist yet.
+  FembStreamingAnalyzer(std::string fname, const Config& cfg);
+
+  // Dtor.
+  ~FembStreamingAnalyzer();
+
+  // Delete copy and assignment.
+  FembStreamingAnalyzer(const FembStreamingAnalyzer&) =delete;
+  FembStreamingAnalyzer& operator=(const FembStreamingAnalyzer&) =delete;
+
+  // Refresh the file and process new entries.
+  // Returns the number of entries processed or -1 for error.
+  int update();
+
+  // Update until stop is called or the idle timeout is reached.
+  // Returns 0 for success.
+  int run(Callback cb =nullptr);
+
+  // Ask run to return after the current update. May be called from another thread.
+  void stop() { m_stop = true; }
+
+  // Results.
+  DataMap channelResult(Index icha) const;
+  DataMap eventResult(Index ievt) const;
+
+  // Getters.
+  const Config& config() const { return m_cfg; }
+  DuneFembReader* reader() const { return m_reader.get(); }
+  bool haveTool() const { return m_ptool != nullptr; }
+  Entry nEntryProcessed() const { return m_nextEntry; }
+  Index nEntryFailed() const { return m_nEntryFailed; }
+  Index nChannel() const { return m_chans.size(); }
+  Index nEvent() const { return m_evts.size(); }
+  double lastUpdateTime() const { return m_lastUpdateTime; }   // [sec]
+  double maxUpdateTime() const { return m_maxUpdateTime; }     // [sec]
+
+  // Display the channel summary.
+  void print() const;
+
+private:
+
+  // Running sums for a channel.
+  struct ChannelStats {
+    Index nevt = 0;
+    double sumPed = 0.0;
+    double sumPed2 = 0.0;
+    double sumNoise = 0.0;
+    float lastPed = 0.0;
+    float lastNoise = 0.0;
+    float sigMax = 0.0;
+    float sigMin = 0.0;
+  };
+
+  // Running sums for an event.
+  struct EventStats {
+    Index ncha = 0;
+    double sumPed = 0.0;
+    double sumNoise = 0.0;
+    Index ndead = 0;
+  };
+
+  // Process one entry. Returns 0 for success.
+  int processEntry(Entry ient);
+
+  Config m_cfg;
+  std::unique_ptr<DuneFembReader> m_reader;
+  std::unique_ptr<AdcChannelTool> m_ptool;
+  std::vector<ChannelStats> m_chans;
+  std::vector<EventStats> m_evts;
+  Entry m_nextEntry;
+  Index m_nEntryFailed;
+  double m_lastUpdateTime;
+  double m_maxUpdateTime;
+  std::atomic<bool> m_stop;
+
+};
+
+#endif
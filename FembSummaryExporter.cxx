@@ -0,0 +1,252 @@
+// FembSummaryExporter.cxx
+
+#include "FembSummaryExporter.h"
+#include "FembTestAnalyzer.h"
+#include "FembCheckpoint.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ostream;
+using std::ostringstream;
+using std::vector;
+
+using Index = FembSummaryExporter::Index;
+using Name = FembSummaryExporter::Name;
+using NameVector = FembSummaryExporter::NameVector;
+
+//**********************************************************************
+
+namespace {
+
+// Write a float or null.
+void writeFloat(ostream& out, float val) {
+  if ( std::isfinite(val) ) out << val;
+  else out << "null";
+}
+
+// Write a float vector.
+void writeFloats(ostream& out, const vector<float>& vals) {
+  out << "[";
+  for ( Index ival=0; ival<vals.size(); ++ival ) {
+    if ( ival ) out << ",";
+    writeFloat(out, vals[ival]);
+  }
+  out << "]";
+}
+
+// Max of the valid (non-negative) fractions in a vector.
+float maxFraction(const vector<float>& vals, float maxval) {
+  for ( float val : vals ) if ( val > maxval ) maxval = val;
+  return maxval;
+}
+
+// Page layout and script for writeHtml. The summaries are in fembData.
+const char* htmlScript = R"(
+function fmt(v) {
+  if ( v === null || v === undefined ) return "";
+  if ( Math.abs(v) >= 100 ) return v.toFixed(1);
+  return Number(v.toPrecision(4)).toString();
+}
+function spark(vals, w, h) {
+  var pts = [];
+  var ymin = Infinity, ymax = -Infinity;
+  vals.forEach(function(v) { if ( v !== null ) { ymin = Math.min(ymin, v); ymax = Math.max(ymax, v); } });
+  if ( ymin > ymax ) return "";
+  var dy = ymax > ymin ? ymax - ymin : 1;
+  var dx = vals.length > 1 ? (w - 2)/(vals.length - 1) : 0;
+  vals.forEach(function(v, i) {
+    if ( v !== null ) pts.push((1 + i*dx).toFixed(1) + "," + (h - 1 - (v - ymin)/dy*(h - 2)).toFixed(1));
+  });
+  return '<svg width="' + w + '" height="' + h + '"><polyline fill="none" stroke="#36c" ' +
+         'stroke-width="1" points="' + pts.join(" ") + '"/></svg>';
+}
+var cols = ["channel", "pedMin", "pedMax", "gain", "chi2Dof", "adcMin", "adcSatMax",
+            "devRms", "devTailFrac", "sticky1Max", "sticky2Max"];
+function render(ds, div) {
+  var title = "FEMB " + ds.femb + " gain " + ds.gain + " shaping " + ds.shap + ", " +
+              (ds.cold ? "cold" : "warm") + ", " + (ds.extPulse ? "external" : "internal") +
+              " pulser" + (ds.extClock ? "" : ", internal clock") + ", " + ds.calib;
+  var html = "<h2>" + title + "</h2><p>" + ds.nChannel + " channels, " + ds.nEvent + " events";
+  ["devRms", "devTailFrac"].forEach(function(k) { if ( ds.summary[k] !== undefined ) html += ", " + k + " " + fmt(ds.summary[k]); });
+  html += ". Gain unit: " + ds.gainUnit + ".</p>";
+  var chans = ds.channels.slice();
+  var used = cols.filter(function(c) { return chans.some(function(ch) { return ch[c] !== null; }); });
+  html += "<table><thead><tr>";
+  used.forEach(function(c) { html += '<th data-col="' + c + '">' + c + "</th>"; });
+  html += "<th>peds</th></tr><tr class=\"spark\">";
+  used.forEach(function(c) {
+    html += "<td>" + (c == "channel" ? "" : spark(chans.map(function(ch) { return ch[c]; }), 80, 20)) + "</td>";
+  });
+  html += "<td></td></tr></thead><tbody></tbody></table>";
+  div.innerHTML = html;
+  var body = div.querySelector("tbody");
+  function fill() {
+    var rows = "";
+    chans.forEach(function(ch) {
+      rows += "<tr>";
+      used.forEach(function(c) { rows += "<td>" + fmt(ch[c]) + "</td>"; });
+      rows += "<td>" + spark(ch.peds, 120, 20) + "</td></tr>";
+    });
+    body.innerHTML = rows;
+  }
+  var sortCol = "channel", sortDir = 1;
+  div.querySelectorAll("th[data-col]").forEach(function(th) {
+    th.onclick = function() {
+      var c = th.getAttribute("data-col");
+      sortDir = c == sortCol ? -sortDir : 1;
+      sortCol = c;
+      chans.sort(function(a, b) {
+        var x = a[c], y = b[c];
+        if ( x === null ) return 1;
+        if ( y === null ) return -1;
+        return sortDir*(x - y);
+      });
+      fill();
+    };
+  });
+  fill();
+}
+fembData.forEach(function(ds) {
+  var div = document.createElement("div");
+  document.body.appendChild(div);
+  render(ds, div);
+});
+)";
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembSummaryExporter::FembSummaryExporter(FembTestAnalyzer* pfta) : m_pfta(pfta) { }
+
+//**********************************************************************
+
+Name FembSummaryExporter::json() const {
+  if ( m_pfta == nullptr ) return "";
+  FembTestAnalyzer& fta = *m_pfta;
+  Index ncha = fta.nChannel();
+  Index nevt = fta.nEvent();
+  ostringstream ssout;
+  ssout << std::setprecision(6);
+  ssout << "{\"femb\": " << fta.femb() << ", \"gain\": " << fta.gainIndex()
+        << ", \"shap\": " << fta.shapingIndex()
+        << ", \"cold\": " << (fta.isCold() ? "true" : "false")
+        << ", \"extPulse\": " << (fta.extPulse() ? "true" : "false")
+        << ", \"extClock\": " << (fta.extClock() ? "true" : "false")
+        << ", \"calib\": \"" << fta.calibOptionName() << "\""
+        << ", \"roi\": \"" << fta.roiOptionName() << "\""
+        << ", \"gainUnit\": \"" << fta.gainUnit() << "\""
+        << ", \"nChannel\": " << ncha << ", \"nEvent\": " << nevt << ",\n";
+  vector<float> charges;
+  for ( Index ievt=0; ievt<nevt; ++ievt ) charges.push_back(fta.chargeFc(ievt));
+  ssout << " \"charges\": ";
+  writeFloats(ssout, charges);
+  ssout << ",\n \"summary\": {";
+  const char* sep = "";
+  for ( string name : {"devMean", "devRms", "devTailFrac"} ) {
+    if ( ! fta.allResult.haveFloat(name) ) continue;
+    ssout << sep << "\"" << name << "\": ";
+    writeFloat(ssout, fta.allResult.getFloat(name));
+    sep = ", ";
+  }
+  ssout << "},\n \"channels\": [";
+  const vector<std::pair<string, string>> valNames = {
+    {"pedMin", "pedMin"}, {"pedMax", "pedMax"}, {"gain", "fitGainHeight"},
+    {"chi2Dof", "linFitChiSquareDofHeight"}, {"adcMin", "adcminWithPed"},
+    {"adcSatMax", "lowSaturatedRawAdcMax"}, {"devRms", "devRms"}, {"devTailFrac", "devTailFrac"}
+  };
+  for ( Index icha=0; icha<ncha; ++icha ) {
+    ssout << (icha ? ",\n  " : "\n  ") << "{\"channel\": " << icha;
+    for ( const auto& ent : valNames ) {
+      float val = 0.0;
+      ssout << ", \"" << ent.first << "\": ";
+      if ( fta.channelValue(icha, ent.second, val) ) ssout << "null";
+      else writeFloat(ssout, val);
+    }
+    // Per-event values are only available for channels processed in memory.
+    const DataMap* pres = icha < fta.chanResults.size() && fta.chanResults[icha].haveInt("channel") ?
+                          &fta.chanResults[icha] : nullptr;
+    for ( string sname : {"sticky1", "sticky2"} ) {
+      float smax = -1.0;
+      if ( pres != nullptr ) {
+        for ( string ssgn : {"Pos", "Neg"} ) {
+          string vname = sname + ssgn + "s";
+          if ( pres->haveFloatVector(vname) ) smax = maxFraction(pres->getFloatVector(vname), smax);
+        }
+      }
+      ssout << ", \"" << sname << "Max\": ";
+      if ( smax < 0.0 ) ssout << "null";
+      else writeFloat(ssout, smax);
+    }
+    ssout << ", \"peds\": ";
+    if ( pres != nullptr && pres->haveFloatVector("peds") ) writeFloats(ssout, pres->getFloatVector("peds"));
+    else ssout << "[]";
+    ssout << "}";
+  }
+  ssout << "\n ]\n}\n";
+  return ssout.str();
+}
+
+//**********************************************************************
+
+int FembSummaryExporter::writeJson(Name fname) const {
+  const string myname = "FembSummaryExporter::writeJson: ";
+  if ( m_pfta == nullptr ) {
+    cout << myname << "Analyzer is missing." << endl;
+    return 1;
+  }
+  if ( FembCheckpoint::writeAtomic(fname, json()) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 2;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+int FembSummaryExporter::writeHtml(Name fname, const NameVector& jsonNames, Name title) {
+  const string myname = "FembSummaryExporter::writeHtml: ";
+  ostringstream ssout;
+  ssout << "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>" << title << "</title>\n"
+        << "<style>\n"
+        << "body { font-family: sans-serif; font-size: 13px; }\n"
+        << "table { border-collapse: collapse; }\n"
+        << "th, td { border: 1px solid #ccc; padding: 1px 6px; text-align: right; }\n"
+        << "th { background: #eee; cursor: pointer; }\n"
+        << "tr.spark td { background: #f8f8f8; }\n"
+        << "</style></head>\n<body><h1>" << title << "</h1>\n"
+        << "<script>\nvar fembData = [\n";
+  Index nread = 0;
+  for ( Name jsonName : jsonNames ) {
+    ifstream fin(jsonName.c_str());
+    if ( ! fin ) {
+      cout << myname << "Unable to read " << jsonName << endl;
+      continue;
+    }
+    ostringstream sstext;
+    sstext << fin.rdbuf();
+    string text = sstext.str();
+    // Keep the data from closing the script element.
+    for ( string::size_type ipos=text.find("</"); ipos!=string::npos; ipos=text.find("</", ipos) ) {
+      text.replace(ipos, 2, "<\\/");
+    }
+    if ( nread ) ssout << ",\n";
+    ssout << text;
+    ++nread;
+  }
+  ssout << "];\n" << htmlScript << "</script>\n</body></html>\n";
+  if ( FembCheckpoint::writeAtomic(fname, ssout.str()) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
+  return nread == jsonNames.size() ? 0 : 2;
+}
+
+//**********************************************************************
@@ -0,0 +1,70 @@
+// FembSummaryExporter.h
+//
+// Writes the numbers used for FEMB triage from the processed results of a
+// FembTestAnalyzer as a compact JSON summary, and a static HTML page that
+// shows one or more summaries without ROOT.
+//
+// The JSON summary holds the dataset (FEMB, gain, shaping, temperature,
+// pulser, clock, calibration), the FEMB deviation results and for each
+// channel
+//   channel      - channel number
+//   pedMin       - minimum pedestal over events [ADC]
+//   pedMax       - maximum pedestal over events [ADC]
+//   gain         - fitted height gain (fitGainHeight) in gainUnit
+//   chi2Dof      - chi-square/DOF of the gain fit
+//   adcMin       - minimum ADC for the fit (adcminWithPed)
+//   adcSatMax    - largest raw ADC of the low saturated samples
+//   devRms       - RMS of the calibrated deviations [ke] (calibrated only)
+//   devTailFrac  - fraction of deviations in the tail (calibrated only)
+//   sticky1Max   - max over events of the most common code fraction
+//   sticky2Max   - max over events of the code%64 = 63 fraction
+//   peds         - pedestal for each event [ADC]
+// Values that are not available are null.
+//
+// The HTML page embeds the summaries so it can be opened from a file. It
+// has a sortable table for each dataset and sparklines for the pedestals
+// of each channel and for the channel dependence of each column.
+//
+// Writing takes milliseconds for an analyzer that has been processed. The
+// analyzer processes any channel that has not been processed (or read from
+// its checkpoint).
+
+#ifndef FembSummaryExporter_H
+#define FembSummaryExporter_H
+
+#include <string>
+#include <vector>
+
+class FembTestAnalyzer;
+
+class FembSummaryExporter {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using NameVector = std::vector<Name>;
+
+  // Ctor from the analyzer.
+  explicit FembSummaryExporter(FembTestAnalyzer* pfta);
+
+  // Return the JSON summary.
+  Name json() const;
+
+  // Write the JSON summary. Returns 0 for success.
+  int writeJson(Name fname) const;
+
+  // Write an HTML page showing the JSON summaries in the listed files.
+  // Returns 0 for success.
+  static int writeHtml(Name fname, const NameVector& jsonNames, Name title ="FEMB summary");
+
+  // Getters.
+  FembTestAnalyzer* analyzer() const { return m_pfta; }
+
+private:
+
+  FembTestAnalyzer* m_pfta;
+
+};
+
+#endif
@@ -5,9 +5,17 @@
 #include <fstream>
 #include <map>
 #include <iomanip>
+#include <array>
 #include "dune/DuneInterface/AdcChannelData.h"
 #include "dune/ArtSupport/DuneToolManager.h"
+#include "FembToolPool.h"
 #include "DuneFembFinder.h"
+#include "FembWorkStealingPool.h"
+#include "FembToolConfig.h"
+#include "FembCalibTable.h"
+#include "FembPerfMonitor.h"
+#include "FembTraceRecorder.h"
+#include "FembBufferPool.h"
 #include "TGraphErrors.h"
 #include "TROOT.h"
 #include "TF1.h"
@@ -15,6 +23,7 @@
 #include "TLatex.h"
 #include "TLegend.h"
 #include "TSystem.h"
+#include "Math/MinimizerOptions.h"
 
 using std::string;
 using std::cout;
@@ -24,6 +33,105 @@ using std::setprecision;
 using std::fixed;
 using std::ofstream;
 
+namespace {
+
+// Times a stage with the analyzer's performance monitor and records it
+// as a span with its trace recorder. Either may be null.
+class StageScope {
+public:
+  using Index = FembTestAnalyzer::Index;
+  StageScope(const FembTestAnalyzer* pfta, const char* stage, Index icha, int ievt =-1,
+             const string& tool =string())
+  : m_perf(pfta->perfMonitor(), stage, icha, tool),
+    m_span(pfta->traceRecorder(), stage, pfta->femb(), icha, ievt, tool) { }
+  void addBytes(FembPerfMonitor::Count val) { m_perf.addBytes(val); }
+  void addSamples(FembPerfMonitor::Count val) { m_perf.addSamples(val); }
+  void addRois(FembPerfMonitor::Count val) { m_perf.addRois(val); }
+  void addAllocs(FembPerfMonitor::Count val) { m_perf.addAllocs(val); }
+private:
+  FembPerfMonitor::Scope m_perf;
+  FembTraceRecorder::Span m_span;
+};
+
+using Index = FembTestAnalyzer::Index;
+
+// Reusable buffers for the ROI processing in processChannelEvent.
+// The period and ADC-code counts are indexed by value and only the
+// entries that were filled are reset.
+struct RoiScratch {
+  vector<float> sigAreas[2];   // Calibrated area for each signal
+  vector<float> sigHeights[2]; // Calibrated height for each signal
+  vector<float> sigCals[2];    // Calibrated charge (height or area depending on calib option)
+  vector<float> sigDevs[2];    // Deviation of calibrated value from expected value
+  vector<bool> roiIsPos;
+  DataMap::IntVector roiPeriods;
+  vector<Index> periodCounts;  // Count for each period
+  vector<Index> adcCounts;     // Count for each ADC code
+  vector<AdcIndex> adcCodes;   // ADC codes with nonzero count
+  void clear() {
+    for ( Index isgn=0; isgn<2; ++isgn ) {
+      sigAreas[isgn].clear();
+      sigHeights[isgn].clear();
+      sigCals[isgn].clear();
+      sigDevs[isgn].clear();
+    }
+    roiIsPos.clear();
+    roiPeriods.clear();
+  }
+};
+
+// Capacities of the pooled buffers. A change means a buffer was reallocated.
+using Capacities = std::array<size_t, 18>;
+
+Capacities capacities(const AdcChannelData& acd, const RoiScratch& scr) {
+  Capacities caps = {{acd.raw.capacity(), acd.samples.capacity(), acd.flags.capacity(),
+                      acd.signal.capacity(), acd.rois.capacity(),
+                      scr.roiIsPos.capacity(), scr.roiPeriods.capacity(),
+                      scr.periodCounts.capacity(), scr.adcCounts.capacity(),
+                      scr.adcCodes.capacity()}};
+  Index icap = 10;
+  for ( Index isgn=0; isgn<2; ++isgn ) {
+    caps[icap++] = scr.sigAreas[isgn].capacity();
+    caps[icap++] = scr.sigHeights[isgn].capacity();
+    caps[icap++] = scr.sigCals[isgn].capacity();
+    caps[icap++] = scr.sigDevs[isgn].capacity();
+  }
+  return caps;
+}
+
+Index countChanges(const Capacities& lhs, const Capacities& rhs) {
+  Index count = 0;
+  for ( Index icap=0; icap<lhs.size(); ++icap ) if ( lhs[icap] != rhs[icap] ) ++count;
+  return count;
+}
+
+// Reset channel data keeping the capacity of its sample vectors.
+void resetChannelData(AdcChannelData& acd) {
+  AdcCountVector raw;
+  AdcSignalVector samples;
+  AdcFlagVector flags;
+  AdcFilterVector signal;
+  AdcRoiVector rois;
+  raw.swap(acd.raw);
+  samples.swap(acd.samples);
+  flags.swap(acd.flags);
+  signal.swap(acd.signal);
+  rois.swap(acd.rois);
+  acd = AdcChannelData();
+  raw.clear();
+  samples.clear();
+  flags.clear();
+  signal.clear();
+  rois.clear();
+  acd.raw.swap(raw);
+  acd.samples.swap(samples);
+  acd.flags.swap(flags);
+  acd.signal.swap(signal);
+  acd.rois.swap(rois);
+}
+
+}  // end unnamed namespace
+
 //**********************************************************************
 
 FembTestAnalyzer::Index FembTestAnalyzer::typeIndex(SignOption isgn, bool useArea) {
@@ -65,14 +173,18 @@ FembTestAnalyzer(opt, a_femb, fpat, a_isCold) {
 //**********************************************************************
 
 FembTestAnalyzer::FembTestAnalyzer(int opt, int a_femb, string a_tspat, bool a_isCold)
-: m_copt(CalibOption(opt%10)), m_ropt(RoiOption((opt%100)/10)), m_doDraw(opt>99),
+: m_copt(CalibOption(opt%10)), m_ropt(RoiOption((opt%100)/10)), m_doDraw((opt/100)%10),
+  m_headless(opt>999),
   m_femb(a_femb), m_tspat(a_tspat), m_isCold(a_isCold),
   m_ptreePulse(nullptr), m_tickPeriod(0),
-  m_nChannelEventProcessed(0) {
+  m_nChannelEventProcessed(0), m_nthread(1), m_popt(OptPrepareTools),
+  m_retain(false), m_prawSource(nullptr), m_pchk(nullptr), m_pulseStream(false),
+  m_columnExport(false) {
   const string myname = "FembTestAnalyzer::ctor: ";
   cout << myname << "  Calib option: " << calibOptionName() << endl;
   cout << myname << "    ROI option: " << roiOptionName() << endl;
   cout << myname << "       Do draw: " << (m_doDraw ? "true" : "false") << endl;
+  cout << myname << "      Headless: " << (m_headless ? "true" : "false") << endl;
   adcModifierNames.push_back("adcPedestalFit");
   string roiPeakName;
   if ( isNoCalib() ) {
@@ -96,35 +208,62 @@ FembTestAnalyzer::FembTestAnalyzer(int opt, int a_femb, string a_tspat, bool a_i
 
 //**********************************************************************
 
+FembTestAnalyzer::~FembTestAnalyzer() {
+  releaseTools(adcModifiers, adcModifierNames);
+}
+
+//**********************************************************************
+
 void FembTestAnalyzer::getTools() {
   const string myname = "FembTestAnalyzer::getTools: ";
-  DuneToolManager* ptm = DuneToolManager::instance("dunefemb.fcl");
-  if ( ptm == nullptr ) {
-    cout << myname << "Unable to retrieve tool manager." << endl;
-    return;
-  }
+  FembToolPool& pool = FembToolPool::instance("dunefemb.fcl");
   fixToolNames(adcModifierNames);
   for ( string modname : adcModifierNames ) {
-    std::unique_ptr<AdcChannelTool> pmod =
-      ptm->getPrivate<AdcChannelTool>(modname);
+    std::unique_ptr<AdcChannelTool> pmod = pool.acquire(modname);
     if ( ! pmod ) {
       cout << myname << "Unable to find modifier " << modname << endl;
-      adcModifiers.clear();
+      releaseTools(adcModifiers, adcModifierNames);
       return;
     }
     adcModifiers.push_back(std::move(pmod));
   }
   fixToolNames(adcViewerNames);
+  if ( isHeadless() ) return;
+  if ( getViewers() ) releaseTools(adcModifiers, adcModifierNames);
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::getViewers() {
+  const string myname = "FembTestAnalyzer::getViewers: ";
+  // Viewers keep state and do their end-of-job work when they are deleted,
+  // so each analyzer has its own instances rather than pooled ones.
+  DuneToolManager* ptm = DuneToolManager::instance("dunefemb.fcl");
+  if ( ptm == nullptr ) {
+    cout << myname << "Unable to retrieve tool manager." << endl;
+    return 1;
+  }
   for ( string vwrname : adcViewerNames ) {
     auto pvwr = ptm->getPrivate<AdcChannelTool>(vwrname);
     if ( ! pvwr ) {
       cout << myname << "Unable to find viewer " << vwrname << endl;
-      adcModifiers.clear();
       adcViewers.clear();
-      return;
+      return 2;
     }
     adcViewers.push_back(std::move(pvwr));
   }
+  return 0;
+}
+
+//**********************************************************************
+
+void FembTestAnalyzer::
+releaseTools(vector<std::unique_ptr<AdcChannelTool>>& tools, const vector<string>& names) {
+  FembToolPool& pool = FembToolPool::instance("dunefemb.fcl");
+  for ( Index itoo=0; itoo<tools.size() && itoo<names.size(); ++itoo ) {
+    pool.release(names[itoo], std::move(tools[itoo]));
+  }
+  tools.clear();
 }
 
 //**********************************************************************
@@ -169,14 +308,193 @@ find(int a_gain, int a_shap, bool a_extPulse, bool a_extClock, string dir) {
     m_reader = std::move(fdr.find(femb(), isCold(), tspat(), a_gain, a_shap, a_extPulse, a_extClock));
   }
   cout << myname << "Done fetching reader." << endl;
+  if ( m_reader ) m_reader->setTraceRecorder(traceRecorder());
   chanevtResults.resize(nChannel(), vector<DataMap>(nEvent()));
   chanResults.resize(nChannel());
   chanResponseResults.resize(typeSize(), vector<DataMap>(nChannel()));
+  m_retained.clear();
+  if ( retainChannelData() ) m_retained.resize(nChannel(), vector<AdcChannelData>(nEvent()));
+  return 0;
+}
+
+//**********************************************************************
+
+bool FembTestAnalyzer::isPrepareTool(string modName) {
+  if ( modName == "adcSampleFiller" ) return true;
+  if ( modName == "adcThresholdSignalFinder" ) return true;
+  if ( modName == "keThresholdSignalFinder" ) return true;
+  if ( modName == "tickModSignalFinder" ) return true;
+  if ( modName.substr(0, 14) == "fembCalibrator" ) return true;
+  return false;
+}
+
+//**********************************************************************
+
+const FembPrepareKernel* FembTestAnalyzer::prepareKernel() {
+  const string myname = "FembTestAnalyzer::prepareKernel: ";
+  if ( m_prepareKernel ) return m_prepareKernel.get();
+  const FembToolConfig& tcfg = FembToolConfig::instance("dunefemb.fcl");
+  if ( ! tcfg.isValid() ) {
+    cout << myname << "Tool configuration not found." << endl;
+    return nullptr;
+  }
+  using RoiIndex = FembRoiFinder::Index;
+  string roiName;
+  string calName;
+  for ( string modName : adcModifierNames ) {
+    if ( modName.find("ThresholdSignalFinder") != string::npos ) roiName = modName;
+    if ( modName == "tickModSignalFinder" ) roiName = modName;
+    if ( modName.substr(0, 14) == "fembCalibrator" ) calName = modName;
+  }
+  FembPrepareKernel::Config cfg;
+  FembRoiFinder::Config& rcfg = cfg.roi;
+  cfg.doRoi = roiName.size() > 0;
+  if ( doPeakRoi() ) {
+    rcfg.mode         = FembRoiFinder::ThresholdMode;
+    rcfg.threshold    = tcfg.get<float>(roiName, "Threshold", 0.0);
+    rcfg.binsBefore   = tcfg.get<RoiIndex>(roiName, "BinsBefore", 0);
+    rcfg.binsAfter    = tcfg.get<RoiIndex>(roiName, "BinsAfter", 0);
+    rcfg.flagPositive = tcfg.get<bool>(roiName, "FlagPositive", true);
+    rcfg.flagNegative = tcfg.get<bool>(roiName, "FlagNegative", true);
+  } else if ( doTickModRoi() ) {
+    // The tick period, if set, is passed to the tool through the channel ROIs.
+    rcfg.mode   = FembRoiFinder::RegularMode;
+    rcfg.period = tickPeriod() > 0 ? tickPeriod() : tcfg.get<RoiIndex>(roiName, "Period", 0);
+    rcfg.length = tickPeriod() > 0 ? tickPeriod() : tcfg.get<RoiIndex>(roiName, "Length", 0);
+  }
+  cfg.adcUnderflow = tcfg.get<int>("adcSampleFiller", "AdcUnderflow", 0);
+  cfg.adcOverflow  = tcfg.get<int>("adcSampleFiller", "AdcOverflow", 4095);
+  std::unique_ptr<FembPrepareKernel> pkern(new FembPrepareKernel(cfg));
+  if ( calName.size() ) {
+    // Calibration for this FEMB as written by writeCalibFcl.
+    string dirName = tcfg.get<string>(calName, "DirName", "");
+    string toolBase = tcfg.get<string>(calName, "ToolBase", "");
+    if ( dirName.size() == 0 || toolBase.size() == 0 ) {
+      cout << myname << "Calibrator " << calName << " does not have DirName and ToolBase." << endl;
+      return nullptr;
+    }
+    ostringstream sstool;
+    sstool << toolBase << femb();
+    string toolName = sstool.str();
+    FembCalibTable cal;
+    if ( cal.readFcl(dirName + "/" + toolName + ".fcl", toolName) ) {
+      cout << myname << "Unable to read calibration " << toolName << endl;
+      return nullptr;
+    }
+    pkern->setCalibration(cal);
+  }
+  m_prepareKernel = std::move(pkern);
+  return m_prepareKernel.get();
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::setTraceFile(string fname) {
+  if ( fname.size() == 0 ) m_trace.reset();
+  else m_trace.reset(new FembTraceRecorder(fname));
+  if ( reader() != nullptr ) reader()->setTraceRecorder(m_trace.get());
   return 0;
 }
 
 //**********************************************************************
 
+int FembTestAnalyzer::setRetainChannelData(bool val) {
+  const string myname = "FembTestAnalyzer::setRetainChannelData: ";
+  if ( val == m_retain ) return 0;
+  if ( nChannelEventProcessed() != 0 ) {
+    cout << myname << "Retention cannot be changed after processing has begun." << endl;
+    return 1;
+  }
+  m_retain = val;
+  m_retained.clear();
+  if ( m_retain ) m_retained.resize(nChannel(), vector<AdcChannelData>(nEvent()));
+  return 0;
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::setRawSource(FembTestAnalyzer* praw) {
+  const string myname = "FembTestAnalyzer::setRawSource: ";
+  m_prawSource = nullptr;
+  m_calibKernel.reset();
+  if ( praw == nullptr ) return 0;
+  if ( nChannelEventProcessed() != 0 ) {
+    cout << myname << "Source cannot be set after processing has begun." << endl;
+    return 1;
+  }
+  if ( ! isHeightCalib() || ! praw->isNoCalib() ) {
+    cout << myname << "Source must be uncalibrated and this analyzer height calibrated." << endl;
+    return 2;
+  }
+  if ( praw->femb() != femb() || praw->roiOption() != roiOption() ||
+       praw->nChannel() != nChannel() || praw->nEvent() != nEvent() ) {
+    cout << myname << "Source does not match this analyzer." << endl;
+    return 3;
+  }
+  if ( ! praw->retainChannelData() && praw->setRetainChannelData(true) ) {
+    cout << myname << "Source does not retain its channel data." << endl;
+    return 4;
+  }
+  FembCalibTable cal;
+  if ( praw->calibTable(cal) ) {
+    cout << myname << "Unable to evaluate the calibration from the source." << endl;
+    return 5;
+  }
+  // The kernel applies the calibration. ROIs are taken from the source.
+  FembPrepareKernel::Config cfg;
+  cfg.doRoi = false;
+  m_calibKernel.reset(new FembPrepareKernel(cfg));
+  m_calibKernel->setCalibration(cal);
+  m_prawSource = praw;
+  return 0;
+}
+
+//**********************************************************************
+
+void FembTestAnalyzer::setCheckpoint(FembCheckpoint* pchk, string prefix) {
+  m_pchk = pchk;
+  m_chkPrefix = prefix;
+  m_chkValues.clear();
+}
+
+//**********************************************************************
+
+string FembTestAnalyzer::checkpointRecordName(Index icha) const {
+  ostringstream ssnam;
+  ssnam << m_chkPrefix << "_ch" << setw(3) << setfill('0') << icha;
+  return ssnam.str();
+}
+
+//**********************************************************************
+
+const vector<string>& FembTestAnalyzer::checkpointValueNames() {
+  static const vector<string> names = {
+    "pedMin", "pedMax", "fitGainHeight", "adcminWithPed",
+    "lowSaturatedRawAdcMax", "linFitChiSquareDofHeight"
+  };
+  return names;
+}
+
+//**********************************************************************
+
+const AdcChannelData* FembTestAnalyzer::retainedChannelData(Index icha, Index ievt) const {
+  if ( icha >= m_retained.size() ) return nullptr;
+  if ( ievt >= m_retained[icha].size() ) return nullptr;
+  const AdcChannelData& acd = m_retained[icha][ievt];
+  if ( acd.raw.size() == 0 ) return nullptr;
+  return &acd;
+}
+
+//**********************************************************************
+
+bool FembTestAnalyzer::setPerfMonitor(bool val) {
+  if ( ! val ) m_perf.reset();
+  else if ( ! m_perf ) m_perf.reset(new FembPerfMonitor);
+  return val;
+}
+
+//**********************************************************************
+
 int FembTestAnalyzer::setTickPeriod(Index val) {
   const string myname = "FembTestAnalyzer::setTickPeriod: ";
   if ( nChannelEventProcessed() != 0 ) {
@@ -266,6 +584,138 @@ string FembTestAnalyzer::responseFitFunctionName(SignOption isgn) const {
 
 //**********************************************************************
 
+int FembTestAnalyzer::
+prepareChannelEvent(Index icha, Index ievt, AdcChannelData& acd, DataMap& resmod, DataMap& reskern) {
+  const string myname = "FembTestAnalyzer::prepareChannelEvent: ";
+  acd.run = femb();
+  acd.event = ievt;
+  acd.channel = icha;
+  acd.fembID = femb();
+  if ( rawSource() != nullptr ) return deriveChannelEvent(icha, ievt, acd, resmod);
+  // Read the raw data.
+  {
+    StageScope perf(this, "read", icha, ievt);
+    int rstat = reader()->read(ievt, icha, &acd);
+    if ( rstat ) {
+      cout << myname << "Read of channel " << icha << ", event " << ievt
+           << " failed with status " << rstat << endl;
+      return 3;
+    }
+    perf.addBytes(acd.raw.size()*sizeof(AdcCount));
+    perf.addSamples(acd.raw.size());
+  }
+  // Process the data, i.e. subtract pedestal, calibrate, find ROIs, etc.
+  if ( dbg > 2 ) cout << myname << "Applying modifiers." << endl;
+  const FembPrepareKernel* pkern = nullptr;
+  if ( prepareOption() != OptPrepareTools ) {
+    pkern = prepareKernel();
+    if ( pkern == nullptr ) {
+      cout << myname << "WARNING: Prepare kernel not available. Using tools." << endl;
+      setPrepareOption(OptPrepareTools);
+    }
+  }
+  bool validate = prepareOption() == OptPrepareValidate;
+  bool kernelDone = false;
+  AdcChannelData acdKernel;
+  reskern = DataMap();
+  Index imod = 0;
+  for ( const std::unique_ptr<AdcChannelTool>& pmod : adcModifiers ) {
+    string modName = adcModifierNames[imod];
+    // Apply the prepare kernel in place of the first tool it replaces.
+    // For validation, it is applied to a copy and the tools are also run.
+    if ( pkern != nullptr && isPrepareTool(modName) ) {
+      if ( ! kernelDone ) {
+        if ( dbg > 2 ) cout << "Applying prepare kernel" << endl;
+        StageScope perf(this, "prepareKernel", icha, ievt);
+        perf.addSamples(acd.raw.size());
+        if ( validate ) {
+          acdKernel = acd;
+          reskern = pkern->update(acdKernel);
+          if ( reskern.status() ) {
+            cout << myname << "WARNING: Prepare kernel returned error " << reskern.status() << endl;
+            validate = false;
+          }
+        } else {
+          resmod += pkern->update(acd);
+          if ( resmod.status() ) {
+            cout << myname << "Prepare kernel returned error " << resmod.status() << endl;
+            return 2;
+          }
+        }
+        perf.addRois(validate ? acdKernel.rois.size() : acd.rois.size());
+        kernelDone = true;
+      }
+      if ( ! validate ) {
+        ++imod;
+        continue;
+      }
+    }
+    // For the tickmod ROI builder, if we have a tick period, add it to the channel data.
+    if ( modName == "tickModSignalFinder" && tickPeriod() > 0 ) {
+      acd.rois.clear();
+      acd.rois.emplace_back(0, tickPeriod()-1);
+    }
+    if ( dbg > 2 ) cout << "Applying modifier " << modName << endl;
+    StageScope perf(this, "mod_", icha, ievt, modName);
+    resmod += pmod->update(acd);
+    perf.addSamples(acd.samples.size());
+    if ( modName.find("SignalFinder") != string::npos ) perf.addRois(acd.rois.size());
+    if ( resmod.status() ) {
+      cout << myname << "Modifier " << modName << " returned error "
+           << resmod.status() << endl;
+      return 2;
+    }
+    ++imod;
+  }
+  if ( validate && kernelDone ) {
+    DataMap resdiff = FembPrepareKernel::compare(acdKernel, acd, pkern->config().doRoi);
+    int ndiff = resdiff.getInt("prepareDiffSampleCount") + resdiff.getInt("prepareDiffFlagCount") +
+                  resdiff.getInt("prepareDiffRoiCount") + resdiff.getInt("prepareDiffUnit");
+    if ( ndiff ) {
+      cout << myname << "WARNING: Prepare kernel differs from tools for channel " << icha
+           << ", event " << ievt << ":" << endl;
+      resdiff.print();
+    }
+    resmod += resdiff;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::
+deriveChannelEvent(Index icha, Index ievt, AdcChannelData& acd, DataMap& resmod) {
+  const string myname = "FembTestAnalyzer::deriveChannelEvent: ";
+  FembTestAnalyzer& fraw = *rawSource();
+  const AdcChannelData* pacdRaw = fraw.retainedChannelData(icha, ievt);
+  if ( pacdRaw == nullptr && fraw.processChannelEvent(icha, ievt).status() == 0 ) {
+    pacdRaw = fraw.retainedChannelData(icha, ievt);
+  }
+  if ( pacdRaw == nullptr ) {
+    cout << myname << "Source data not found for channel " << icha << ", event " << ievt << endl;
+    return 1;
+  }
+  StageScope perf(this, "derive", icha, ievt);
+  acd.raw = pacdRaw->raw;
+  acd.pedestal = pacdRaw->pedestal;
+  acd.pedestalRms = pacdRaw->pedestalRms;
+  resmod += m_calibKernel->update(acd);
+  if ( resmod.status() ) {
+    cout << myname << "Calibration returned error " << resmod.status() << endl;
+    return 2;
+  }
+  if ( doRoi() ) {
+    acd.rois = pacdRaw->rois;
+    FembRoiFinder::fillSignal(acd);
+    FembRoiFinder::summarize(acd, resmod);
+  }
+  perf.addSamples(acd.samples.size());
+  perf.addRois(acd.rois.size());
+  return 0;
+}
+
+//**********************************************************************
+
 const DataMap& FembTestAnalyzer::
 processChannelEvent(Index icha, Index ievt) {
   const string myname = "FembTestAnalyzer::processChannelEvent: ";
@@ -292,36 +742,33 @@ processChannelEvent(Index icha, Index ievt) {
   ++m_nChannelEventProcessed;
   res.setInt("event", ievt);
   if ( reader() == nullptr ) return res.setStatus(1);
+  StageScope perfEvent(this, "channelEvent", icha, ievt);
+  // Take the channel data and scratch buffers from the pools for this thread.
+  // In steady state, these are reused without allocation.
+  Index nalloc0 = FembBufferPool<AdcChannelData>::allocationCount() +
+                  FembBufferPool<RoiScratch>::allocationCount();
+  FembBufferPool<AdcChannelData>::Handle pacd = FembBufferPool<AdcChannelData>::acquire();
+  FembBufferPool<RoiScratch>::Handle pscr = FembBufferPool<RoiScratch>::acquire();
+  AdcChannelData& acd = *pacd;
+  RoiScratch& scr = *pscr;
+  resetChannelData(acd);
+  scr.clear();
+  Capacities caps0;
+  if ( perfMonitor() != nullptr ) caps0 = capacities(acd, scr);
   // Fetch the expected charge for this sample.
   double pulseQfC = chargeFc(ievt);
   double pulseQe = pulseQfC*elecPerFc();
   res.setFloat("nElectron", pulseQe);
-  // Read the raw data.
-  AdcChannelData acd;
-  acd.run = femb();
-  acd.event = ievt;
-  acd.channel = icha;
-  acd.fembID = femb();
-  reader()->read(ievt, icha, &acd);
-  // Process the data, i.e. subtract pedestal, calibrate, find ROIs, etc.
+  // Read and prepare the data, i.e. subtract pedestal, calibrate, find ROIs, etc.
   DataMap resmod;
-  if ( dbg > 2 ) cout << myname << "Applying modifiers." << endl;
-  Index imod = 0;
-  for ( const std::unique_ptr<AdcChannelTool>& pmod : adcModifiers ) {
-    string modName = adcModifierNames[imod];
-    // For the tickmod ROI builder, if we have a tick period, add it to the channel data.
-    if ( modName == "tickModSignalFinder" && tickPeriod() > 0 ) {
-      acd.rois.clear();
-      acd.rois.emplace_back(0, tickPeriod()-1);
-    }
-    if ( dbg > 2 ) cout << "Applying modifier " << modName << endl;
-    resmod += pmod->update(acd);
-    if ( resmod.status() ) {
-      cout << myname << "Modifier " << modName << " returned error "
-           << resmod.status() << endl;
-      return res.setStatus(2);
-    }
-    ++imod;
+  DataMap reskern;
+  if ( prepareChannelEvent(icha, ievt, acd, resmod, reskern) ) return res.setStatus(2);
+  if ( retainChannelData() && icha < m_retained.size() && ievt < m_retained[icha].size() ) {
+    AdcChannelData& acdRetained = m_retained[icha][ievt];
+    acdRetained.raw = acd.raw;
+    acdRetained.pedestal = acd.pedestal;
+    acdRetained.pedestalRms = acd.pedestalRms;
+    acdRetained.rois = acd.rois;
   }
   if ( dbg > 3 ) {
     cout << myname << "Result:" << endl;
@@ -336,15 +783,32 @@ processChannelEvent(Index icha, Index ievt) {
     cout << myname << "    rois: size=" << acd.rois.size()    << endl;
     cout << myname << "----------------------------------" << endl;
   }
-  if ( dbg > 2 ) cout << myname << "Applying viewers." << endl;
-  for ( Index ivwr=0; ivwr<adcViewers.size(); ++ivwr ) {
+  // Headless, the viewers fetched for viewChannelEvent are not applied here.
+  Index nvwr = isHeadless() ? 0 : adcViewers.size();
+  if ( dbg > 2 && nvwr ) cout << myname << "Applying viewers." << endl;
+  for ( Index ivwr=0; ivwr<nvwr; ++ivwr ) {
     string vwrName = adcViewerNames[ivwr];
     const std::unique_ptr<AdcChannelTool>& pvwr = adcViewers[ivwr];
+    // The prepare kernel or the raw source derivation provides the ROI summary.
+    if ( vwrName == "adcRoiViewer" && resmod.haveIntVector("roiTick0s") &&
+         (prepareOption() == OptPrepareFused || rawSource() != nullptr) ) continue;
     if ( dbg > 2 ) cout << "Applying viewer " << vwrName << endl;
+    StageScope perf(this, "vwr_", icha, ievt, vwrName);
     DataMap resvwr = pvwr->view(acd);
     resmod += resvwr;
     if ( dbg > 2 ) cout << "Viewer returned status " << resvwr.status() << endl;
   }
+  // In validation mode, compare the kernel ROI summary with that from the viewer.
+  if ( reskern.haveIntVector("roiTick0s") ) {
+    int ndiff = FembRoiFinder::compareSummary(reskern, resmod);
+    if ( ndiff ) {
+      cout << myname << "WARNING: Prepare kernel ROI summary has " << ndiff
+           << " differences for channel " << icha << ", event " << ievt << endl;
+    }
+    resmod.setInt("prepareDiffRoiSummaryCount", ndiff);
+  }
+  // Without viewers, the ROI summary is evaluated here.
+  if ( doRoi() && ! resmod.haveIntVector("roiTick0s") ) FembRoiFinder::summarize(acd, resmod);
   res += resmod;
   if ( dbg >= 2 ) {
     cout << myname << "Begin display of processing result. ----------------" << endl;
@@ -402,17 +866,21 @@ processChannelEvent(Index icha, Index ievt) {
     ftt.data().ped0 = ievt==0 ? acd.pedestal : processChannelEvent(icha, 0).getFloat("pedestal");
     ftt.data().qexp = 0.001*pulseQe;
     ftt.data().ievt = ievt;
+    StageScope perf(this, "tickModFill", icha, ievt);
+    perf.addSamples(acd.samples.size());
     DataMap rest = ftt.fill(acd);
     res.extend(rest);
   }
+  // Values for the pulse tree.
+  PulseValues pvals;
   // Process the ROIs.
   bool haverois = resmod.haveInt("roiCount");
   Index nroi = haverois ? resmod.getInt("roiCount") : 0;
   if ( nroi ) {
-    vector<float> sigAreas[2];   // Calibrated area for each signal
-    vector<float> sigHeights[2]; // Calibrated height for each signal
-    vector<float> sigCals[2];    // Calibrated charge (height or area depending on calib option)
-    vector<float> sigDevs[2];    // Deviation of calibrated value from expected value
+    vector<float> (&sigAreas)[2] = scr.sigAreas;
+    vector<float> (&sigHeights)[2] = scr.sigHeights;
+    vector<float> (&sigCals)[2] = scr.sigCals;
+    vector<float> (&sigDevs)[2] = scr.sigDevs;
     int sigNundr[2] = {0, 0};
     int sigNover[2] = {0, 0};
     float areaMin[2] = {1.e9, 1.e9};
@@ -442,7 +910,8 @@ processChannelEvent(Index icha, Index ievt) {
     // Also count the number of ROIs with under and overflow bins.
     // All are done separately for each sign.
     float expSig = 0.001*pulseQe;
-    vector<bool> roiIsPos(nroi, false);
+    vector<bool>& roiIsPos = scr.roiIsPos;
+    roiIsPos.assign(nroi, false);
     if ( dbg >= 3 ) cout << myname << "Processing " << nroi << " ROIs." << endl;
     for ( Index iroi=iroi1; iroi<iroi2; ++iroi ) {
       if ( dbg >= 4 ) cout << myname << "Processing ROI " << iroi << endl;
@@ -456,17 +925,19 @@ processChannelEvent(Index icha, Index ievt) {
         cout << myname << "  Max height: " << sigmax << endl;
         cout << myname << "        Area: " << area << endl;
       }
-      vector<bool> isPoss;
-      // Build vector of signs.
+      bool isPoss[2];
+      Index nsgn = 0;
+      // Build list of signs.
       // For peak ROIs, there is only one based on the area.
       // For tickmod ROIS, we have both signs
-      if ( doPeakRoi() ) isPoss.push_back(area >= 0.0);
+      if ( doPeakRoi() ) isPoss[nsgn++] = area >= 0.0;
       else if ( doTickModRoi() ) {
-        isPoss.push_back(false);
-        isPoss.push_back(true);
+        isPoss[nsgn++] = false;
+        isPoss[nsgn++] = true;
       }
       // Loop over signs.
-      for ( bool isPos : isPoss ) {
+      for ( Index ksgn=0; ksgn<nsgn; ++ksgn ) {
+        bool isPos = isPoss[ksgn];
         roiIsPos[iroi] = isPos;
         float sign = isPos ? 1.0 : -1.0;
         area *= sign;
@@ -579,12 +1050,13 @@ processChannelEvent(Index icha, Index ievt) {
       // The period is # ticks between each adjacent pair of peaks of the same sign.
       const DataMap::IntVector& roiTick0s = resmod.getIntVector("roiTick0s");
       if ( roiTick0s.size()) {
-        vector<int> roiPeriods;
+        DataMap::IntVector& roiPeriods = scr.roiPeriods;
+        roiPeriods.clear();
         string vecname = isgn ? "roiTickMaxs" : "roiTickMins";
         const DataMap::IntVector& roiTicks = resmod.getIntVector(vecname);
         Index tickLast = 0;
         Index count = 0;
-        map<Index, Index> countPeriod;
+        vector<Index>& countPeriod = scr.periodCounts;
         Index periodMax = 0;
         for ( Index iroi=iroi1; iroi<iroi2; ++iroi ) {
           if ( roiIsPos[iroi] != isgn ) continue;
@@ -592,7 +1064,7 @@ processChannelEvent(Index icha, Index ievt) {
           if ( tickLast ) {
             Index period = tick - tickLast;
             roiPeriods.push_back(period);
-            if ( countPeriod.find(period) == countPeriod.end() ) countPeriod[period] = 0;
+            if ( period >= countPeriod.size() ) countPeriod.resize(period + 1, 0);
             ++countPeriod[period];
             ++count;
             if ( periodMax == 0 ) periodMax = period;
@@ -600,7 +1072,8 @@ processChannelEvent(Index icha, Index ievt) {
           }
           tickLast = tick;
         }
-        float periodMaxFraction = countPeriod[periodMax]/float(count);
+        float periodMaxFraction = (periodMax < countPeriod.size() ? countPeriod[periodMax] : 0)/float(count);
+        for ( int period : roiPeriods ) countPeriod[period] = 0;
         string periodName = "roiPeriod" + ssgn;
         string periodsName = "roiPeriods" + ssgn;
         string periodMaxName = "roiPeriodMaxFraction" + ssgn;
@@ -614,41 +1087,49 @@ processChannelEvent(Index icha, Index ievt) {
       if ( sigHeights[isgn].size() ) {
         string vecname = isgn ? "roiTickMaxs" : "roiTickMins";
         const DataMap::IntVector& roiTicks = resmod.getIntVector(vecname);
-        map<AdcIndex, Index> adcCounts;   // map of counts for each ADC code
+        vector<Index>& adcCounts = scr.adcCounts;   // Counts for each ADC code
+        vector<AdcIndex>& adcCodes = scr.adcCodes;
+        adcCodes.clear();
         for ( Index iroi=iroi1; iroi<iroi2; ++iroi ) {
           if ( roiIsPos[iroi] != isgn ) continue;
           Index tick = roiTicks[iroi] + roiTick0s[iroi];
-          AdcCount adcCode = acd.raw[tick];
-          if ( adcCounts.find(adcCode) == adcCounts.end() ) adcCounts[adcCode] = 0;
+          AdcIndex adcCode = acd.raw[tick];
+          if ( adcCode >= adcCounts.size() ) adcCounts.resize(std::max<AdcIndex>(adcCode + 1, 4096), 0);
+          if ( adcCounts[adcCode] == 0 ) adcCodes.push_back(adcCode);
           adcCounts[adcCode] += 1;
         }
         Index maxCount = 0;
         Index sumCount = 0;
         Index stickyCount = 0;
-        for ( auto ent : adcCounts ) {
-          const AdcIndex adcCode = ent.first;
-          const Index count = ent.second;
+        for ( AdcIndex adcCode : adcCodes ) {
+          const Index count = adcCounts[adcCode];
           if ( count > maxCount ) maxCount = count;
           sumCount += count;
           const AdcIndex adcCodeMod = adcCode%64;
           if ( adcCodeMod == 63 ) stickyCount += count;
+          adcCounts[adcCode] = 0;
         }
         float s1 = sumCount > 0 ? float(maxCount)/float(sumCount) : -1.0;
         float s2 = sumCount > 0 ? float(stickyCount)/float(sumCount) : -1.0;
         res.setFloat("stickyFraction1" + ssgn, s1);
         res.setFloat("stickyFraction2" + ssgn, s2);
+        pvals.stk1[isgn] = s1;
+        pvals.stk2[isgn] = s2;
       }
       // Record the # of ROIS with underflow and overflow bins.
       string unam = "sigNUnderflow" + ssgn;
       string onam = "sigNOverflow" + ssgn;
       res.setInt(unam, sigNundr[isgn]);
       res.setInt(onam, sigNover[isgn]);
+      pvals.nsat[isgn] = isgn ? sigNover[isgn] : sigNundr[isgn];
       // Record deviations if this signal is calibrated.
       if ( isCalib() ) {
         string varname = "roiSigCal" + ssgn;
         res.setFloatVector(varname, sigCals[isgn]);
         varname = "roiSigDev" + ssgn;
         res.setFloatVector(varname, sigDevs[isgn]);
+        pvals.qcal[isgn] = &sigCals[isgn];
+        pvals.cdev[isgn] = &sigDevs[isgn];
       }
       // Record mean and RMS of the calibrated signal.
       if ( isCalib() ) {
@@ -666,6 +1147,8 @@ processChannelEvent(Index icha, Index ievt) {
         float sigRms = sqrt(xxmean - xmean*xmean);
         res.setFloat("roiSigCalMean" + ssgn, sigMean);
         res.setFloat("roiSigCalRms" + ssgn,  sigRms);
+        pvals.cmea[isgn] = sigMean;
+        pvals.crms[isgn] = sigRms;
       }
     }  // End loop over isgn
   } else if ( haverois ) {
@@ -674,6 +1157,45 @@ processChannelEvent(Index icha, Index ievt) {
   } else if ( doRoi() ) {
     cout << myname << "ERROR: It appears no ROI finder was run (no roiCount in result)." << endl;
   }
+  if ( m_pulseStream ) fillPulseTree(icha, ievt, pulseQe, acd.pedestal, pvals);
+  if ( perfMonitor() != nullptr ) {
+    Index nalloc = FembBufferPool<AdcChannelData>::allocationCount() +
+                   FembBufferPool<RoiScratch>::allocationCount() - nalloc0;
+    perfEvent.addAllocs(nalloc + countChanges(caps0, capacities(acd, scr)));
+  }
+  return res;
+}
+
+//**********************************************************************
+
+const DataMap& FembTestAnalyzer::viewChannelEvent(Index icha, Index ievt) {
+  const string myname = "FembTestAnalyzer::viewChannelEvent: ";
+  const DataMap& res0 = processChannelEvent(icha, ievt);
+  if ( ! isHeadless() || res0.status() ) return res0;
+  DataMap& res = chanevtResults[icha][ievt];
+  if ( res.haveInt("viewersApplied") ) return res;
+  if ( adcViewers.size() == 0 && getViewers() ) {
+    cout << myname << "Viewers are not available." << endl;
+    return res;
+  }
+  // Replay the channel-event and apply the viewers.
+  FembBufferPool<AdcChannelData>::Handle pacd = FembBufferPool<AdcChannelData>::acquire();
+  AdcChannelData& acd = *pacd;
+  resetChannelData(acd);
+  DataMap resmod;
+  DataMap reskern;
+  if ( prepareChannelEvent(icha, ievt, acd, resmod, reskern) ) {
+    cout << myname << "Unable to prepare channel " << icha << ", event " << ievt << endl;
+    return res;
+  }
+  for ( Index ivwr=0; ivwr<adcViewers.size(); ++ivwr ) {
+    string vwrName = adcViewerNames[ivwr];
+    // The ROI summary is already in the result.
+    if ( vwrName == "adcRoiViewer" ) continue;
+    StageScope perf(this, "vwr_", icha, ievt, vwrName);
+    res += adcViewers[ivwr]->view(acd);
+  }
+  res.setInt("viewersApplied", 1);
   return res;
 }
 
@@ -688,6 +1210,7 @@ const DataMap& FembTestAnalyzer::getChannelResponse(Index icha, SignOption isgn,
   }
   DataMap& res = chanResponseResults[ityp][icha];
   if ( res.haveInt("channel") ) return res;
+  StageScope perf(this, useArea ? "responseArea" : "responseHeight", icha);
   const DuneFembReader* prdr = reader();
   if ( prdr == nullptr ) {
     cout << myname << "No reader found." << endl;
@@ -1079,7 +1602,10 @@ const DataMap& FembTestAnalyzer::getChannelResponse(Index icha, SignOption isgn,
     pfit0 = pfit;
     Index npar = pfit->GetNpar();
     //pgf->Fit(pfit, "", "", xfmin, x[2]);
-    pgfFit->Fit(pfit, "Q", "", xfmin, xfmax);
+    {
+      FembTraceRecorder::Span span(traceRecorder(), "fit", femb(), icha, -1, sfit);
+      pgfFit->Fit(pfit, "Q", "", xfmin, xfmax);
+    }
     pgf->GetListOfFunctions()->Add(pfit);
     gain = pfit->GetParameter(0);
     if ( fitAdcMin ) adcmin = pfit->GetParameter(pfit->GetParNumber("adcmin"));
@@ -1102,7 +1628,10 @@ const DataMap& FembTestAnalyzer::getChannelResponse(Index icha, SignOption isgn,
       prefit = new TF1("fgain", "[0]*x");
       prefit->SetParName(0, "gain");
       prefit->SetParameter(0, gain);
-      pgfFit->Fit(prefit, "Q", "", xfmin, xfmax);
+      {
+        FembTraceRecorder::Span span(traceRecorder(), "fit", femb(), icha, -1, "Refit");
+        pgfFit->Fit(prefit, "Q", "", xfmin, xfmax);
+      }
       pgf->GetListOfFunctions()->Add(pfit);
       pfit = prefit;
       res.setFloat("refitXmin" + styp + signLabel, xfmin);
@@ -1339,16 +1868,8 @@ const DataMap& FembTestAnalyzer::processChannel(Index icha) {
     cout << myname << "ADC processing tools are missing." << endl;
     return res.setStatus(3);
   }
-  vector<SignOption> isgns;
-  if ( true ) {
-    isgns.push_back(OptBothSigns);
-  } else {
-    isgns.push_back(OptPositive);
-    isgns.push_back(OptNegative);
-  }
-  vector<bool> useAreas;
-  useAreas.push_back(false);
-  if ( ! doTickModRoi() ) useAreas.push_back(true);
+  vector<SignOption> isgns = responseSignOptions();
+  vector<bool> useAreas = responseUseAreas();
   if ( true ) {
     for ( SignOption isgn : isgns ) {
       for ( bool useArea : useAreas ) {
@@ -1387,17 +1908,96 @@ const DataMap& FembTestAnalyzer::processChannel(Index icha) {
     res.setFloat("pedMax", pedMax);
     res.setGraph(gnamp, pgp);
   }
+  if ( checkpoint() != nullptr ) {
+    ostringstream ssout;
+    ssout << setprecision(9);
+    for ( string name : checkpointValueNames() ) {
+      if ( res.haveFloat(name) ) ssout << name << " " << res.getFloat(name) << "\n";
+      else if ( res.haveInt(name) ) ssout << name << " " << res.getInt(name) << "\n";
+    }
+    if ( checkpoint()->writeRecord(checkpointRecordName(icha), ssout.str()) ) {
+      cout << myname << "WARNING: Unable to checkpoint channel " << icha << endl;
+    }
+  }
   return res;
 }
 
 //**********************************************************************
 
+int FembTestAnalyzer::processResponses() {
+  const string myname = "FembTestAnalyzer::processResponses: ";
+  if ( reader() == nullptr ) {
+    cout << myname << "Reader is not defined." << endl;
+    return 1;
+  }
+  if ( ! haveTools() ) {
+    cout << myname << "ADC processing tools are missing." << endl;
+    return 2;
+  }
+  Index ncha = nChannel();
+  Index nevt = nEvent();
+  // The reader and ADC tools are not thread safe, so the channel-events
+  // are processed here, serially and in the usual order. The fits below
+  // then only read the cached event results.
+  for ( Index icha=0; icha<ncha; ++icha ) {
+    for ( Index ievt=0; ievt<nevt; ++ievt ) processChannelEvent(icha, ievt);
+  }
+  if ( ! doResponseFit() ) return 0;
+  vector<SignOption> isgns = responseSignOptions();
+  vector<bool> useAreas = responseUseAreas();
+  bool doArea = useAreas.size() > 1;
+  // TMinuit keeps global state; Minuit2 may be used from multiple threads.
+  // Histograms are owned by the result maps and so are kept out of gDirectory.
+  ROOT::EnableThreadSafety();
+  string minimizerSave = ROOT::Math::MinimizerOptions::DefaultMinimizerType();
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer("Minuit2");
+  bool addDirSave = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(false);
+  cout << myname << "Fitting " << ncha << " channels with " << threadCount()
+       << " thread" << (threadCount() == 1 ? "" : "s") << "." << endl;
+  Index nfail = 0;
+  {
+    FembWorkStealingPool pool(threadCount());
+    // Each task writes only its own slot in chanResponseResults, so the
+    // results do not depend on the scheduling.
+    // The area fit takes its range from the height fit and so is
+    // submitted by the height task when it completes.
+    for ( Index icha=0; icha<ncha; ++icha ) {
+      for ( SignOption isgn : isgns ) {
+        pool.submit([this, &pool, icha, isgn, doArea]() {
+          getChannelResponse(icha, isgn, false);
+          if ( doArea ) {
+            pool.submit([this, icha, isgn]() {
+              getChannelResponse(icha, isgn, true);
+            });
+          }
+        });
+      }
+    }
+    nfail = pool.wait();
+    if ( dbg > 0 ) cout << myname << "Steal count: " << pool.stealCount() << endl;
+  }
+  TH1::AddDirectory(addDirSave);
+  ROOT::Math::MinimizerOptions::SetDefaultMinimizer(minimizerSave.c_str());
+  if ( nfail ) {
+    cout << myname << "ERROR: " << nfail << " fit task"
+         << (nfail == 1 ? "" : "s") << " failed." << endl;
+    return 3;
+  }
+  return 0;
+}
+
+//**********************************************************************
+
 const DataMap& FembTestAnalyzer::processAll(int a_tickPeriod) {
   const string myname = "FembTestAnalyzer::processAll: ";
   if ( allResult.haveInt("ncha") ) return allResult;
+  FembPerfMonitor::Clock::time_point perfStart = FembPerfMonitor::Clock::now();
   if ( a_tickPeriod >= 0 ) setTickPeriod(a_tickPeriod);
   Index ncha = nChannel();
   allResult.setInt("ncha", ncha);
+  // Fit the channel responses in parallel.
+  if ( threadCount() > 1 ) processResponses();
   // Process all channels and check for errors.
   for ( Index icha=0; icha<ncha; ++icha ) {
     cout << myname << "Channel " << icha << endl;
@@ -1707,13 +2307,44 @@ const DataMap& FembTestAnalyzer::processAll(int a_tickPeriod) {
     ph->SetLineWidth(2);
     allResult.setHist(ph->GetName(), ph, true);
   }
+  // Stage timing summary.
+  if ( perfMonitor() != nullptr ) {
+    double dt = std::chrono::duration<double>(FembPerfMonitor::Clock::now() - perfStart).count();
+    perfMonitor()->record("processAll", FembPerfMonitor::noChannel(), dt);
+    cout << myname << "Stage timing for FEMB " << femb() << " (times are inclusive):" << endl;
+    perfMonitor()->print(myname);
+    allResult += perfMonitor()->summary();
+  }
+  if ( traceRecorder() != nullptr ) traceRecorder()->flush();
   return allResult;
 }
 
 //**********************************************************************
 
+vector<FembTestAnalyzer::SignOption> FembTestAnalyzer::responseSignOptions() const {
+  vector<SignOption> isgns;
+  if ( true ) {
+    isgns.push_back(OptBothSigns);
+  } else {
+    isgns.push_back(OptPositive);
+    isgns.push_back(OptNegative);
+  }
+  return isgns;
+}
+
+//**********************************************************************
+
+vector<bool> FembTestAnalyzer::responseUseAreas() const {
+  vector<bool> useAreas;
+  useAreas.push_back(false);
+  if ( ! doTickModRoi() ) useAreas.push_back(true);
+  return useAreas;
+}
+
+//**********************************************************************
+
 bool FembTestAnalyzer::haveTools() const {
-  return adcModifiers.size() && adcViewers.size();
+  return (adcModifiers.size() || rawSource() != nullptr) && (isHeadless() || adcViewers.size());
 }
 
 //**********************************************************************
@@ -1729,62 +2360,118 @@ string FembTestAnalyzer::gainUnit() const {
 FembTestPulseTree* FembTestAnalyzer::pulseTree(bool useAll) {
   const string myname = "FembTestAnalyzer::pulseTree: ";
   if ( m_ptreePulse != nullptr ) return m_ptreePulse.get();
+  if ( nChannelEventProcessed() == 0 ) {
+    if ( streamPulseTree() ) return nullptr;
+    if ( useAll ) processAll();
+  } else {
+    if ( ! isCalib() ) {
+      cout << myname << "Must have calibration for pulse tree." << endl;
+      return nullptr;
+    }
+    if ( useAll ) processAll();
+    m_ptreePulse.reset(new FembTestPulseTree(pulseTreeFileName()));
+    if ( m_columnExport ) m_ptreePulse->exportColumns(columnFileName(pulseTreeFileName()));
+    // Fill from the cached results of the channel-events processed earlier.
+    Index ncha = nChannel();
+    Index nevt = nEvent();
+    for ( Index icha=0; icha<ncha; ++icha ) {
+      for ( Index ievt=0; ievt<nevt; ++ievt ) {
+        const DataMap& res = processChannelEvent(icha, ievt);
+        PulseValues vals;
+        for ( Index isgn=0; isgn<2; ++isgn ) {
+          string ssgn = isgn ? "Pos" : "Neg";
+          vals.nsat[isgn] = res.getInt(isgn ? "sigNOverflowPos" : "sigNUnderflowNeg");
+          vals.stk1[isgn] = res.getFloat("stickyFraction1" + ssgn);
+          vals.stk2[isgn] = res.getFloat("stickyFraction2" + ssgn);
+          vals.cmea[isgn] = res.getFloat("roiSigCalMean" + ssgn);
+          vals.crms[isgn] = res.getFloat("roiSigCalRms" + ssgn);
+          vals.qcal[isgn] = &res.getFloatVector("roiSigCal" + ssgn);
+          vals.cdev[isgn] = &res.getFloatVector("roiSigDev" + ssgn);
+        }
+        fillPulseTree(icha, ievt, res.getFloat("nElectron"), res.getFloat("pedestal"), vals);
+      }
+    }
+  }
+  {
+    FembTraceRecorder::Span span(traceRecorder(), "pulseTreeWrite", femb());
+    m_ptreePulse->write();
+  }
+  if ( traceRecorder() != nullptr ) traceRecorder()->flush();
+  return m_ptreePulse.get();
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::streamPulseTree() {
+  const string myname = "FembTestAnalyzer::streamPulseTree: ";
+  if ( m_pulseStream ) return 0;
   if ( ! isCalib() ) {
     cout << myname << "Must have calibration for pulse tree." << endl;
-    return nullptr;
+    return 1;
   }
   if ( ! haveTools() ) {
     cout << myname << "ADC processing tools are missing." << endl;
-    return nullptr;
+    return 2;
   }
-  if ( useAll ) processAll();
+  if ( nChannelEventProcessed() != 0 || m_ptreePulse != nullptr ) {
+    cout << myname << "Streaming must be enabled before processing begins." << endl;
+    return 3;
+  }
+  m_ptreePulse.reset(new FembTestPulseTree(pulseTreeFileName()));
+  if ( m_columnExport ) m_ptreePulse->exportColumns(columnFileName(pulseTreeFileName()));
+  m_pulseStream = true;
+  return 0;
+}
+
+//**********************************************************************
+
+string FembTestAnalyzer::pulseTreeFileName() const {
   ostringstream ssnam;
   ssnam << "femb_test_pulse_femb" << femb() << "_g" << gainIndex()
           << "_s" << shapingIndex()
           << "_p" << (extPulse() ? "ext" : "int");
   if ( ! extClock() ) ssnam << "_cint";
-  string snam = ssnam.str() + ".root";
-  m_ptreePulse.reset(new FembTestPulseTree(snam));
-  Index ncha = nChannel();
-  Index nevt = nEvent();
-  FembTestPulseData data;
+  return ssnam.str() + ".root";
+}
+
+//**********************************************************************
+
+string FembTestAnalyzer::columnFileName(string treeFileName) {
+  string::size_type ipos = treeFileName.rfind(".root");
+  if ( ipos != string::npos ) treeFileName.erase(ipos);
+  return treeFileName + ".fcol";
+}
+
+//**********************************************************************
+
+void FembTestAnalyzer::
+fillPulseTree(Index icha, Index ievt, float nele, float pede, const PulseValues& vals) {
+  if ( m_ptreePulse == nullptr || nele == 0.0 ) return;
+  StageScope perf(this, "pulseTreeFill", icha, ievt);
+  FembTestPulseData& data = m_ptreePulse->m_data;
   data.femb = femb();
   data.gain = gainIndex();
   data.shap = shapingIndex();
   data.extp = extPulse();
-  for ( Index icha=0; icha<ncha; ++icha ) {
-    data.chan = icha;
-    DataMap res0 = processChannelEvent(icha, 0);
-    data.ped0 = res0.getFloat("pedestal");
-    for ( Index ievt=0; ievt<nevt; ++ievt ) {
-      DataMap res = processChannelEvent(icha, ievt);
-      data.pede = res.getFloat("pedestal");
-      float nele = res.getFloat("nElectron");
-      if ( nele == 0.0 ) continue;
-      data.qexp = -0.001*nele;
-      data.sevt = -ievt;
-      data.nsat = res.getInt("sigNUnderflowNeg");
-      data.stk1 = res.getFloat("stickyFraction1Neg");
-      data.stk2 = res.getFloat("stickyFraction2Neg");
-      data.qcal = res.getFloatVector("roiSigCalNeg");
-      data.cmea = res.getFloat("roiSigCalMeanNeg");
-      data.crms = res.getFloat("roiSigCalRmsNeg");
-      data.cdev = res.getFloatVector("roiSigDevPos");
-      m_ptreePulse->fill(data);
-      data.qexp = 0.001*nele;
-      data.sevt = ievt;
-      data.nsat = res.getInt("sigNOverflowPos");
-      data.stk1 = res.getFloat("stickyFraction1Pos");
-      data.stk2 = res.getFloat("stickyFraction2Pos");
-      data.qcal = res.getFloatVector("roiSigCalPos");
-      data.cmea = res.getFloat("roiSigCalMeanPos");
-      data.crms = res.getFloat("roiSigCalRmsPos");
-      data.cdev = res.getFloatVector("roiSigDevPos");
-      m_ptreePulse->fill(data);
-    }
+  data.chan = icha;
+  data.ped0 = ievt == 0 ? pede : processChannelEvent(icha, 0).getFloat("pedestal");
+  data.pede = pede;
+  for ( Index isgn=0; isgn<2; ++isgn ) {
+    float sign = isgn ? 1.0 : -1.0;
+    data.qexp = sign*0.001*nele;
+    data.sevt = isgn ? int(ievt) : -int(ievt);
+    data.nsat = vals.nsat[isgn];
+    data.stk1 = vals.stk1[isgn];
+    data.stk2 = vals.stk2[isgn];
+    data.cmea = vals.cmea[isgn];
+    data.crms = vals.crms[isgn];
+    if ( vals.qcal[isgn] != nullptr ) data.qcal.assign(vals.qcal[isgn]->begin(), vals.qcal[isgn]->end());
+    else data.qcal.clear();
+    // Both entries record the positive deviations, as the tree always has.
+    if ( vals.cdev[1] != nullptr ) data.cdev.assign(vals.cdev[1]->begin(), vals.cdev[1]->end());
+    else data.cdev.clear();
+    m_ptreePulse->fill(false);
   }
-  m_ptreePulse->write();
-  return m_ptreePulse.get();
 }
 
 //**********************************************************************
@@ -1805,88 +2492,132 @@ FembTestTickModTree* FembTestAnalyzer::tickModTree(bool useAll) {
   if ( ! extClock() ) ssnam << "_cint";
   string snam = ssnam.str() + ".root";
   m_ptreeTickMod.reset(new FembTestTickModTree(snam));
+  if ( m_columnExport ) m_ptreeTickMod->exportColumns(columnFileName(snam));
   return m_ptreeTickMod.get();
 }
 
 //**********************************************************************
 
-int FembTestAnalyzer::writeCalibFcl() {
-  const string myname = "FembTestAnalyzer::writeCalibFcl: ";
+int FembTestAnalyzer::calibTable(FembCalibTable& cal) {
+  const string myname = "FembTestAnalyzer::calibTable: ";
   if ( ! isNoCalib() ) {
     cout << myname << "Invalid calibration option: " << calibOptionName() << endl;
     return 1;
   }
-  string sclass = "FembLinearCalibration";
-  string baseName = "calibFromFemb";
-  ostringstream ssnam;
-  ssnam << baseName << "_" << "g" << gainIndex() << "s" << shapingIndex();
-  if ( ! isCold() ) ssnam << "_warm";
-  if ( ! extPulse() ) ssnam << "_intPulse";
-  if ( ! extClock() ) ssnam << "_intClock";
-  string dirName = ssnam.str();
-  bool dirMissing = gSystem->AccessPathName(dirName.c_str());
-  if ( dirMissing ) {
-    if ( gSystem->mkdir(dirName.c_str()) ) {
-      cout << myname << "Unable to create calibration fcl directory " << dirName << endl;
-      return 2;
-    }
-    cout << myname << "Created directory " << dirName << endl;
-  }
-  ssnam << "_femb" << femb();
-  string toolName = ssnam.str();
-  string fclName = dirName + "/" + toolName + ".fcl";
-  ofstream fout(fclName.c_str());
-  ostringstream ssgain, ssamin;
   string gainName = "fitGainHeight";
   vector<string> aminNames = {"adcminWithPed", "lowSaturatedRawAdcMax"};
   vector<string> checkNames = aminNames;
   checkNames.push_back(gainName);
+  FembCalibTable::FloatVector gains;
+  FembCalibTable::IntVector adcMins;
   for ( Index icha=0; icha<nChannel(); ++icha ) {
-    const DataMap& res = processChannel(icha);
+    std::map<string, float> vals;
     for ( string name : checkNames ) {
-      if ( ! res.haveFloat(name) ) {
+      if ( channelValue(icha, name, vals[name]) ) {
         cout << myname << "Result does not have float " << name
              << " for channel " << icha << endl;
-        return 1;
+        return 2;
       }
     }
-    if ( icha ) {
-      ssgain << ",";
-      ssamin << ",";
-    }
-    if ( 10*(icha/10) == icha ) {
-      ssgain << "\n    ";
-      ssamin << "\n    ";
-    } else {
-      ssgain << " ";
-      ssamin << " ";
-    }
-    float gain = res.getFloat(gainName);
+    float gain = vals[gainName];
     float gaininv = gain > 0.0 ? 1.0/gain : 0.0;
-    ssgain << gaininv;
+    gains.push_back(gaininv);
     float adcMin = 0;
     for ( string aminName : aminNames ) {
-      float val = res.getFloat(aminName);
+      float val = vals[aminName];
       if ( val > adcMin ) adcMin = val;
     }
-    ssamin << int(adcMin + 2);
-  }
-  fout << "tools." << toolName << ": {" << endl;
-  fout << "  tool_type: " << sclass << endl;
-  fout << "  LogLevel: 0" << endl;
-  fout << "  Units: ke" << endl;
-  fout << "  FembID: " << femb() << endl;
-  fout << "  Gains: [";
-  fout << ssgain.str() << endl;
-  fout << "  ]" << endl;
-  fout << "  AdcMin: 0" << endl;
-  fout << "  AdcMins: [";
-  fout << ssamin.str() << endl;
-  fout << "  ]" << endl;
-  fout << "  AdcMax: 4095" << endl;
-  fout << "  AdcMaxs: []" << endl;
-  fout << "}" << endl;
+    adcMins.push_back(int(adcMin + 2));
+  }
+  cal = FembCalibTable();
+  cal.setFemb(femb());
+  cal.setUnits("ke");
+  cal.setAdcRange(0, 4095);
+  cal.setGains(gains);
+  cal.setAdcMins(adcMins);
+  cal.setAdcMaxs(FembCalibTable::IntVector());
+  return 0;
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::channelValue(Index icha, string name, float& val) {
+  val = 0.0;
+  if ( icha >= nChannel() ) return 1;
+  // The checkpoint is not used if the channel is already processed or if
+  // the channel data must be retained.
+  if ( checkpoint() != nullptr && ! retainChannelData() &&
+       ! chanResults[icha].haveInt("channel") ) {
+    if ( m_chkValues.size() < nChannel() ) m_chkValues.resize(nChannel());
+    std::map<string, float>& chkvals = m_chkValues[icha];
+    if ( chkvals.size() == 0 ) {
+      string text;
+      if ( checkpoint()->readRecord(checkpointRecordName(icha), text) == 0 ) {
+        istringstream ssin(text);
+        string chkname;
+        float chkval;
+        while ( ssin >> chkname >> chkval ) chkvals[chkname] = chkval;
+      }
+    }
+    std::map<string, float>::const_iterator ival = chkvals.find(name);
+    if ( ival != chkvals.end() ) {
+      val = ival->second;
+      return 0;
+    }
+  }
+  const DataMap& res = processChannel(icha);
+  if ( res.haveFloat(name) ) {
+    val = res.getFloat(name);
+    return 0;
+  }
+  if ( res.haveInt(name) ) {
+    val = res.getInt(name);
+    return 0;
+  }
+  return 2;
+}
+
+//**********************************************************************
+
+FembCalibDatabase::Key FembTestAnalyzer::calibKey() const {
+  FembCalibDatabase::Key key;
+  key.femb = femb();
+  key.gain = gainIndex();
+  key.shap = shapingIndex();
+  key.isCold = isCold();
+  key.extPulse = extPulse();
+  key.extClock = extClock();
+  return key;
+}
+
+//**********************************************************************
+
+int FembTestAnalyzer::writeCalibFcl() {
+  const string myname = "FembTestAnalyzer::writeCalibFcl: ";
+  if ( ! isNoCalib() ) {
+    cout << myname << "Invalid calibration option: " << calibOptionName() << endl;
+    return 1;
+  }
+  string dirName = calibFclDirName();
+  FembCalibTable cal;
+  if ( calibTable(cal) ) return 1;
+  bool dirMissing = gSystem->AccessPathName(dirName.c_str());
+  if ( dirMissing ) {
+    // The directory may be created by another analyzer, e.g. in FembCampaign.
+    if ( gSystem->mkdir(dirName.c_str()) && gSystem->AccessPathName(dirName.c_str()) ) {
+      cout << myname << "Unable to create calibration fcl directory " << dirName << endl;
+      return 2;
+    }
+    cout << myname << "Created directory " << dirName << endl;
+  }
+  string toolName = calibFclToolName();
+  string fclName = dirName + "/" + toolName + ".fcl";
+  ofstream fout(fclName.c_str());
+  fout << cal.fclText(toolName);
+  fout.close();
   cout << myname << "Calibration written to " << fclName << endl;
+  // Pooled calibrators hold the calibration read when they were created.
+  FembToolPool::instance("dunefemb.fcl").invalidate("fembCalibrator");
   return 0;
 }
 
@@ -2338,7 +3069,7 @@ TPadManipulator* FembTestAnalyzer::draw(string sopt, int icha, int ievt) {
   // Plots for event ievt in channel icha
   } else if ( icha >= 0 && ievt >= 0 ) {
     if ( sopt == "raw" ) {
-      const DataMap& res = processChannelEvent(icha, ievt);
+      const DataMap& res = viewChannelEvent(icha, ievt);
       TH1* ph = res.getHist("raw");
       if ( ph != nullptr ) {
         man.add(ph, "");
@@ -2347,7 +3078,7 @@ TPadManipulator* FembTestAnalyzer::draw(string sopt, int icha, int ievt) {
         return draw(&man);
       }
     } else if ( sopt == "prep" ) {
-      const DataMap& res = processChannelEvent(icha, ievt);
+      const DataMap& res = viewChannelEvent(icha, ievt);
       TH1* ph = res.getHist("prepared");
       if ( ph != nullptr ) {
         man.add(ph, "");
@@ -6,6 +6,11 @@
 #include "DuneFembReader.h"
 #include "FembTestPulseTree.h"
 #include "FembTestTickModTree.h"
+#include "FembPrepareKernel.h"
+#include "FembPerfMonitor.h"
+#include "FembTraceRecorder.h"
+#include "FembCheckpoint.h"
+#include "FembCalibDatabase.h"
 #include "dune/DuneInterface/Data/DataMap.h"
 #include "dune/DuneInterface/Tool/AdcChannelTool.h"
 #include "dune/DuneCommon/TPadManipulator.h"
@@ -38,6 +43,12 @@ public:
   //   OptBothSigns - both positive and negative signals
   enum SignOption { OptNoSign, OptNegative, OptPositive, OptBothSigns };
 
+  // Sample preparation options.
+  //      OptPrepareTools - sample filler or calibrator, ROI finder and ROI viewer tools
+  //      OptPrepareFused - FembPrepareKernel replaces those tools
+  //   OptPrepareValidate - run both and report differences (tool results are kept)
+  enum PrepareOption { OptPrepareTools, OptPrepareFused, OptPrepareValidate };
+
 public:
 
   // # of signal type indices.
@@ -56,7 +67,10 @@ public:
 public:
 
   // Ctor from a FEMB sample set.
-  // opt = 100*doDraw + 10*ropt + popt where
+  // opt = 1000*headless + 100*doDraw + 10*ropt + popt where
+  //   headless indicates viewers (plots) are not run when channel-events are
+  //     processed. They are run on request by replaying the channel-event
+  //     (see viewChannelEvent).
   //   doDraw indicates to draw canvas with each succesful call to draw(...)
   //   ropt is the ROI option (see enum above)
   //   popt is the processing option (see enum above) and:
@@ -73,6 +87,9 @@ public:
                    std::string a_tspat ="", bool a_isCold =true,
                    bool extPulse =true, bool extClock =true);
 
+  // Dtor. The modifiers are returned to the tool pool and the viewers deleted.
+  ~FembTestAnalyzer();
+
   // Find a sample.
   // If dir.size(), then the sample file is file pattern tspat in that directory.
   // Otherwise femb, gain, shap, isCold and extPulse are used.
@@ -82,6 +99,57 @@ public:
   // Set the tick period used in the tickmod tree.
   int setTickPeriod(Index val);
 
+  // Set the number of threads used to fit the channel responses.
+  // For values above one, processAll first processes all channel-events
+  // serially and then runs the fits in parallel (see processResponses).
+  Index setThreadCount(Index val) { return m_nthread = val > 0 ? val : 1; }
+
+  // Set the sample preparation option.
+  PrepareOption setPrepareOption(PrepareOption val) { return m_popt = val; }
+
+  // Enable or disable the stage timers and counters.
+  // If enabled, processAll displays a summary and adds it to allResult.
+  bool setPerfMonitor(bool val);
+
+  // Record trace spans for channel-events, tools, reads, fits and tree writes
+  // and write them to a Chrome trace-event JSON file at the end of processAll.
+  // A blank name disables tracing.
+  int setTraceFile(std::string fname);
+
+  // Retain the raw data, pedestal and ROIs for each channel-event so that a
+  // calibrated analyzer can be derived from this one (see setRawSource).
+  // Must be set before processing begins. Returns 0 for success.
+  int setRetainChannelData(bool val);
+
+  // Derive the channel-events of this calibrated analyzer from those
+  // retained by uncalibrated analyzer praw instead of reading the data.
+  // The raw samples, pedestals and ROI boundaries from praw are reused and
+  // the calibration from praw (see calibTable) is applied in memory. Other
+  // analyzer parameters should match those of praw.
+  // Retention is enabled for praw if it has not yet started processing.
+  // Returns 0 for success.
+  int setRawSource(FembTestAnalyzer* praw);
+
+  // Checkpoint the channel results in pchk. When a channel is processed,
+  // the values named by checkpointValueNames are written to the record
+  // PREFIX_chNNN. channelValue and calibTable take the values from that
+  // record if it exists, so channels completed in an earlier run are not
+  // processed again. processAll does not use the records: it always
+  // processes every channel. A null pchk disables checkpointing.
+  void setCheckpoint(FembCheckpoint* pchk, std::string prefix);
+
+  // Open the pulse tree and fill it as each channel-event is processed, so
+  // that no second pass over the results is needed. Must be called before
+  // processing begins. Entries still in memory are written when the tree
+  // is deleted. Returns 0 for success.
+  int streamPulseTree();
+
+  // If true, the pulse and tickmod trees are also exported to columnar
+  // files with the same names and extension .fcol (see FembColumnWriter).
+  // Must be set before the trees are created.
+  bool setColumnExport(bool val) { return m_columnExport = val; }
+  bool columnExport() const { return m_columnExport; }
+
   // Return the reader for the current sample.
   DuneFembReader* reader() const { return m_reader.get(); }
 
@@ -99,6 +167,7 @@ public:
   bool doTickModRoi() const { return roiOption() == OptRoiTickMod; }
   string calibName(bool capitalize =false) const;
   bool doDraw() const { return m_doDraw; }
+  bool isHeadless() const { return m_headless; }
   int femb() const { return m_femb; }
   std::string tspat() const { return m_tspat; }
   bool isCold() const { return m_isCold; }
@@ -110,10 +179,27 @@ public:
 
   // Other getters.
   // If useAll is true, processAll is called before building tree.
+  // If no channel-event has been processed, the pulse tree is filled
+  // during processing (see streamPulseTree). Otherwise it is filled from
+  // the cached channel-event results.
   bool haveTools() const;     // This will be false if tools are not found in initialization.
   FembTestPulseTree* pulseTree(bool useAll =true);
   FembTestTickModTree* tickModTree(bool useAll =true);
   Index tickPeriod() const { return m_tickPeriod; }
+  Index threadCount() const { return m_nthread; }
+  PrepareOption prepareOption() const { return m_popt; }
+  FembPerfMonitor* perfMonitor() const { return m_perf.get(); }
+  FembTraceRecorder* traceRecorder() const { return m_trace.get(); }
+  bool retainChannelData() const { return m_retain; }
+  FembTestAnalyzer* rawSource() const { return m_prawSource; }
+  FembCheckpoint* checkpoint() const { return m_pchk; }
+  std::string checkpointRecordName(Index icha) const;
+
+  // Channel values written to the checkpoint.
+  static const std::vector<std::string>& checkpointValueNames();
+
+  // Return the retained data for a channel-event or null if absent.
+  const AdcChannelData* retainedChannelData(Index icha, Index ievt) const;
 
   // The unit for gain are signal/ke.
   std::string gainUnit() const;
@@ -159,15 +245,43 @@ public:
   // Error bars are the RMS of each measurement (not the RMS of the mean).
   const DataMap& processChannelEvent(Index icha, Index ievt);
 
+  // Return the result for a channel-event including the viewer output.
+  // In headless mode, the channel-event is read and prepared again and the
+  // viewers are applied. Otherwise this is the same as processChannelEvent.
+  const DataMap& viewChannelEvent(Index icha, Index ievt);
+
   // Process a channel.
   const DataMap& getChannelResponse(Index icha, SignOption isgn, bool useArea =true);
   DataMap getChannelDeviations(Index icha);
   const DataMap& processChannel(Index icha);
 
+  // Fit the responses for all channels and types in chanResponseResults.
+  // The channel-events are processed first. The fits are then scheduled
+  // on a work-stealing pool with threadCount() threads. The area fit for
+  // a channel and sign is started only after the corresponding height fit.
+  // Returns 0 for success.
+  int processResponses();
+
   // Process all channels.
   // If period > 0, the tick period is first set to that value.
   const DataMap& processAll(int period =-1);
 
+  // Evaluate the height calibration from the channel results of this
+  // uncalibrated analyzer, i.e. the FembLinearCalibration written by writeCalibFcl.
+  // Returns 0 for success.
+  int calibTable(FembCalibTable& cal);
+
+  // Return a float or int channel result from the checkpoint or, if it is not
+  // there, from processChannel. Returns 0 for success.
+  int channelValue(Index icha, std::string name, float& val);
+
+  // Calibration database key for this sample.
+  FembCalibDatabase::Key calibKey() const;
+
+  // Directory and tool names for the calibration FCL written by writeCalibFcl.
+  std::string calibFclDirName() const { return calibKey().fclDirName(); }
+  std::string calibFclToolName() const { return calibKey().fclToolName(); }
+
   // Write calibration info to FCL.
   int writeCalibFcl();
 
@@ -196,6 +310,7 @@ private:
   CalibOption m_copt;
   RoiOption m_ropt;
   bool m_doDraw;
+  bool m_headless;
   int m_femb;
   std::string m_tspat;
   bool m_isCold;
@@ -211,6 +326,20 @@ private:
   TickModTreePtr m_ptreeTickMod;
   Index m_tickPeriod;
   Index m_nChannelEventProcessed;
+  Index m_nthread;
+  PrepareOption m_popt;
+  std::unique_ptr<FembPrepareKernel> m_prepareKernel;
+  std::unique_ptr<FembPerfMonitor> m_perf;
+  std::unique_ptr<FembTraceRecorder> m_trace;
+  bool m_retain;
+  std::vector<std::vector<AdcChannelData>> m_retained;   // [icha][ievt]
+  FembTestAnalyzer* m_prawSource;
+  std::unique_ptr<FembPrepareKernel> m_calibKernel;
+  FembCheckpoint* m_pchk;
+  std::string m_chkPrefix;
+  std::vector<std::map<std::string, float>> m_chkValues;   // [icha]
+  bool m_pulseStream;
+  bool m_columnExport;
 
   // Parameters.
   // These are deduced from the signal unit (ADC counts, ke, ...)
@@ -224,11 +353,61 @@ private:
   // Separate so it can be called after gain and shaping have been determined.
   void getTools();
 
+  // Fetch the viewers. Returns 0 for success.
+  int getViewers();
+
+  // Return modifiers to the tool pool (see FembToolPool).
+  static void releaseTools(std::vector<std::unique_ptr<AdcChannelTool>>& tools,
+                           const std::vector<std::string>& names);
+
+  // Read the data for a channel-event and apply the modifiers (or the
+  // prepare kernel). In validation mode, reskern holds the kernel result.
+  // Returns 0 for success.
+  int prepareChannelEvent(Index icha, Index ievt, AdcChannelData& acd,
+                          DataMap& resmod, DataMap& reskern);
+
+  // Prepare a channel-event from the data retained by the raw source.
+  // Returns 0 for success.
+  int deriveChannelEvent(Index icha, Index ievt, AdcChannelData& acd, DataMap& resmod);
+
+  // Values for the pulse tree entries of a channel-event, indexed by sign
+  // (0 for negative, 1 for positive). Missing values are zero or null.
+  struct PulseValues {
+    int nsat[2] = {0, 0};
+    float stk1[2] = {0.0, 0.0};
+    float stk2[2] = {0.0, 0.0};
+    float cmea[2] = {0.0, 0.0};
+    float crms[2] = {0.0, 0.0};
+    const std::vector<float>* qcal[2] = {nullptr, nullptr};
+    const std::vector<float>* cdev[2] = {nullptr, nullptr};
+  };
+
+  // Name of the pulse tree file.
+  std::string pulseTreeFileName() const;
+
+  // Name of the columnar file for a tree file.
+  static std::string columnFileName(std::string treeFileName);
+
+  // Add the pulse tree entries for a channel-event.
+  void fillPulseTree(Index icha, Index ievt, float nele, float pede, const PulseValues& vals);
+
   // Make pattern substitutions on tool names.
   //  %GAIN% --> gainIndex()
   //  %SHAP% --> shapingIndex()
   void fixToolNames(std::vector<std::string>& names) const;
 
+  // Sign options and signal types (height/area) for which the channel
+  // response is evaluated in processChannel.
+  std::vector<SignOption> responseSignOptions() const;
+  std::vector<bool> responseUseAreas() const;
+
+  // Return if a modifier is replaced by the prepare kernel.
+  static bool isPrepareTool(std::string modName);
+
+  // Return the prepare kernel, building it from the tool configurations
+  // on the first call. Returns null if the configuration is not found.
+  const FembPrepareKernel* prepareKernel();
+
 };
 
 #endif
@@ -1,6 +1,7 @@
 // FembTestPulseTree.cxx
 
 #include "FembTestPulseTree.h"
+#include "FembColumnWriter.h"
 
 #include "TFile.h"
 #include "TTree.h"
@@ -66,6 +67,7 @@ FembTestPulseTree::~FembTestPulseTree() {
     m_ptree = nullptr;
     if ( pdirSave != nullptr ) pdirSave->cd();
   }
+  if ( m_pcols != nullptr ) m_pcols->close();
 }
 
 //**********************************************************************
@@ -89,7 +91,30 @@ void FembTestPulseTree::clear() {
 //**********************************************************************
 
 void FembTestPulseTree::fill(bool doClear) {
-  if ( tree() != nullptr ) tree()->Fill();
+  if ( tree() != nullptr ) {
+    tree()->Fill();
+    if ( m_pcols != nullptr ) {
+      FembColumnWriter& cols = *m_pcols;
+      Index icol = 0;
+      cols.set(icol++, m_data.femb);
+      cols.set(icol++, m_data.gain);
+      cols.set(icol++, m_data.shap);
+      cols.set(icol++, m_data.extp);
+      cols.set(icol++, m_data.chan);
+      cols.set(icol++, m_data.ped0);
+      cols.set(icol++, m_data.qexp);
+      cols.set(icol++, m_data.sevt);
+      cols.set(icol++, m_data.pede);
+      cols.set(icol++, m_data.cmea);
+      cols.set(icol++, m_data.crms);
+      cols.set(icol++, m_data.cdev);
+      cols.set(icol++, m_data.stk1);
+      cols.set(icol++, m_data.stk2);
+      cols.set(icol++, m_data.nsat);
+      cols.set(icol++, m_data.qcal);
+      cols.endRow();
+    }
+  }
   if ( doClear ) clear();
   m_needWrite = true;
 }
@@ -100,11 +125,45 @@ void FembTestPulseTree::write() {
   TDirectory* pdirSave = gDirectory;
   file()->Write();
   if ( pdirSave != nullptr ) pdirSave->cd();
+  if ( m_pcols != nullptr ) m_pcols->flush();
   m_needWrite = false;
 }
 
 //**********************************************************************
 
+int FembTestPulseTree::exportColumns(string fname) {
+  const string myname = "FembTestPulseTree::exportColumns: ";
+  if ( m_pcols != nullptr ) {
+    cout << myname << "Columns are already exported to " << m_pcols->fileName() << endl;
+    return 1;
+  }
+  std::unique_ptr<FembColumnWriter> pcols(new FembColumnWriter(fname));
+  if ( ! pcols->isOpen() ) return 2;
+  // The order must match that in fill.
+  using Col = FembColumnWriter;
+  pcols->addColumn("femb", Col::UInt32);
+  pcols->addColumn("gain", Col::UInt32);
+  pcols->addColumn("shap", Col::UInt32);
+  pcols->addColumn("extp", Col::Bool8);
+  pcols->addColumn("chan", Col::UInt32);
+  pcols->addColumn("ped0", Col::Float32);
+  pcols->addColumn("qexp", Col::Float32);
+  pcols->addColumn("sevt", Col::Int32);
+  pcols->addColumn("pede", Col::Float32);
+  pcols->addColumn("cmea", Col::Float32);
+  pcols->addColumn("crms", Col::Float32);
+  pcols->addColumn("cdev", Col::Float32, true);
+  pcols->addColumn("stk1", Col::Float32);
+  pcols->addColumn("stk2", Col::Float32);
+  pcols->addColumn("nsat", Col::Int32);
+  pcols->addColumn("qcal", Col::Float32, true);
+  if ( pcols->columnCount() != 16 ) return 3;
+  m_pcols = std::move(pcols);
+  return 0;
+}
+
+//**********************************************************************
+
 void FembTestPulseTree::fill(const FembTestPulseData& data) {
   m_data = data;
   fill(false);
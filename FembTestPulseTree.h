@@ -10,10 +10,12 @@
 #define FembTestPulseTree_H
 
 #include <string>
+#include <memory>
 #include "FembTestPulseData.h"
 
 class TFile;
 class TTree;
+class FembColumnWriter;
 
 class FembTestPulseTree {
 
@@ -44,8 +46,15 @@ public:
   // Write the tree to the file.
   void write();
 
+  // Also write each entry to the columnar file fname (see FembColumnWriter).
+  // The jagged fields cdev and qcal are stored as offsets and values.
+  // The file is completed when this object is deleted.
+  // Returns 0 for success.
+  int exportColumns(std::string fname);
+
   // Getters.
   TFile* file() { return m_pfile; }
+  FembColumnWriter* columnWriter() { return m_pcols.get(); }
   TTree* tree() { return m_ptree; }
   const FembTestPulseData& data() const { return m_data; }
 
@@ -61,6 +70,7 @@ private:
   TFile* m_pfile;
   TTree* m_ptree;
   bool m_needWrite;
+  std::unique_ptr<FembColumnWriter> m_pcols;
 
 };
 
@@ -8,6 +8,8 @@
 #ifndef FembTestTickModData_H
 #define FembTestTickModData_H
 
+#include <vector>
+
 class FembTestTickModData {
 
 public:
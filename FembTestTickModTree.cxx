@@ -2,6 +2,7 @@
 
 #include "FembTestTickModTree.h"
 #include "StickyCodeMetrics.h"
+#include "FembColumnWriter.h"
 #include "TFile.h"
 #include "TROOT.h"
 #include "TDirectory.h"
@@ -14,6 +15,74 @@ using std::cout;
 using std::endl;
 using std::ostringstream;
 
+namespace {
+
+using Index = FembTestTickModTree::Index;
+
+// Sums for each tickmod and the samples of each tickmod stored
+// contiguously at [itmd*stride, itmd*stride + count[itmd]).
+struct TickModSums {
+  Index stride = 0;
+  vector<int> count;
+  vector<double> qsum;
+  vector<double> qqsum;
+  vector<int> nsat;
+  vector<short> radc;
+  vector<float> qcal;
+};
+
+// Accumulate the tickmod sums walking the waveform once in tick order.
+// Within each period the samples and the sums are both contiguous, so
+// the sum loop vectorizes. NTMD is the period if known at compile time
+// and zero otherwise.
+template<Index NTMD>
+void accumulateTickMods(const AdcChannelData& acd, Index ntmdArg, TickModSums& sums) {
+  const Index ntmd = NTMD > 0 ? NTMD : ntmdArg;
+  if ( ntmd == 0 ) return;
+  Index ntck = acd.samples.size();
+  Index nraw = acd.raw.size();
+  bool haveFlags = acd.flags.size() >= ntck;
+  Index nper = (ntck + ntmd - 1)/ntmd;
+  sums.stride = nper;
+  sums.count.assign(ntmd, 0);
+  sums.qsum.assign(ntmd, 0.0);
+  sums.qqsum.assign(ntmd, 0.0);
+  sums.nsat.assign(ntmd, 0);
+  sums.radc.assign(size_t(ntmd)*nper, -1);
+  sums.qcal.assign(size_t(ntmd)*nper, 0.0);
+  const float* psam = acd.samples.data();
+  double* pqsum = sums.qsum.data();
+  double* pqqsum = sums.qqsum.data();
+  int* pnsat = sums.nsat.data();
+  for ( Index iper=0; iper<nper; ++iper ) {
+    Index itck0 = iper*ntmd;
+    Index nt = ntck - itck0 < ntmd ? ntck - itck0 : ntmd;
+    const float* pq = psam + itck0;
+    for ( Index itmd=0; itmd<nt; ++itmd ) {
+      float qcal = pq[itmd];
+      pqsum[itmd] += qcal;
+      pqqsum[itmd] += qcal*qcal;
+    }
+    if ( haveFlags ) {
+      const AdcFlag* pflg = acd.flags.data() + itck0;
+      for ( Index itmd=0; itmd<nt; ++itmd ) {
+        AdcFlag flag = pflg[itmd];
+        pnsat[itmd] += flag == AdcUnderflow || flag == AdcOverflow;
+      }
+    }
+    // Transpose into the tickmod-major sample arrays.
+    for ( Index itmd=0; itmd<nt; ++itmd ) {
+      Index itck = itck0 + itmd;
+      size_t ipos = size_t(itmd)*nper + iper;
+      sums.qcal[ipos] = pq[itmd];
+      if ( itck < nraw ) sums.radc[ipos] = acd.raw[itck];
+    }
+    for ( Index itmd=0; itmd<nt; ++itmd ) ++sums.count[itmd];
+  }
+}
+
+}  // end unnamed namespace
+
 //**********************************************************************
 
 FembTestTickModTree::FembTestTickModTree(string fname, string sopt)
@@ -86,6 +155,7 @@ FembTestTickModTree::~FembTestTickModTree() {
     m_needWrite = false;
     if ( pdirSave != nullptr ) pdirSave->cd();
   }
+  if ( m_pcols != nullptr ) m_pcols->close();
 }
 
 //**********************************************************************
@@ -183,7 +253,42 @@ TTree* FembTestTickModTree::getTree(Index icha) {
 // For now, we only fill the current tree.
 
 void FembTestTickModTree::fill(bool doClear) {
-  if ( treeWrite() != nullptr && chanWrite() == m_data.chan ) treeWrite()->Fill();
+  if ( treeWrite() != nullptr && chanWrite() == m_data.chan ) {
+    treeWrite()->Fill();
+    if ( m_pcols != nullptr ) {
+      FembColumnWriter& cols = *m_pcols;
+      Index icol = 0;
+      cols.set(icol++, m_data.femb);
+      cols.set(icol++, m_data.gain);
+      cols.set(icol++, m_data.shap);
+      cols.set(icol++, m_data.extp);
+      cols.set(icol++, m_data.ntmd);
+      cols.set(icol++, m_data.chan);
+      cols.set(icol++, m_data.ped0);
+      cols.set(icol++, m_data.qexp);
+      cols.set(icol++, m_data.ievt);
+      cols.set(icol++, m_data.itmx);
+      cols.set(icol++, m_data.itmn);
+      cols.set(icol++, m_data.effq);
+      cols.set(icol++, m_data.effp);
+      cols.set(icol++, m_data.pede);
+      cols.set(icol++, m_data.itmd);
+      cols.set(icol++, m_data.cmea);
+      cols.set(icol++, m_data.crms);
+      cols.set(icol++, m_data.sadc);
+      cols.set(icol++, m_data.adcm);
+      cols.set(icol++, m_data.adcn);
+      cols.set(icol++, m_data.efft);
+      cols.set(icol++, m_data.sfmx);
+      cols.set(icol++, m_data.sf00);
+      cols.set(icol++, m_data.sf01);
+      cols.set(icol++, m_data.sf63);
+      cols.set(icol++, m_data.nsat);
+      cols.set(icol++, m_data.radc);
+      cols.set(icol++, m_data.qcal);
+      cols.endRow();
+    }
+  }
   if ( doClear ) clear();
   m_needWrite = true;
 }
@@ -200,14 +305,16 @@ void FembTestTickModTree::fill(const FembTestTickModData& data) {
 DataMap FembTestTickModTree::fill(AdcChannelData& acd) {
   // Save the data to restore after filling.
   FembTestTickModData dataSave = m_data;
-  Index ntck = acd.samples.size();
-  Index nraw = acd.raw.size();
   Index ntmd = data().ntmd;
   int itqmin = -1;
   int itqmax = -1;
   double qmin = 1.e10;
   double qmax = -1.e10;
   int chan = acd.channel;
+  // Accumulate the tickmod sums in one pass over the waveform.
+  TickModSums sums;
+  if ( ntmd == 497 ) accumulateTickMods<497>(acd, ntmd, sums);
+  else accumulateTickMods<0>(acd, ntmd, sums);
   // Create vector of tree entries for this channel data.
   vector<FembTestTickModData> ents(ntmd, m_data);
   // Fill add data except peak positions for each tickmod.
@@ -215,34 +322,20 @@ DataMap FembTestTickModTree::fill(AdcChannelData& acd) {
     FembTestTickModData& data = ents[itmd];
     data.chan = chan;
     data.pede = acd.pedestal;
-    data.radc.clear();
-    data.qcal.clear();
     data.itmd = itmd;
-    data.nsat = 0;
-    int qcnt = 0;
-    double qsum = 0.0;
-    double qqsum = 0.0;
-    AdcCountVector adcs;
-    for ( Index itck=itmd; itck<ntck; itck+=ntmd ) {
-      short radc = itck<nraw ? acd.raw[itck] : -1;
-      data.radc.push_back(radc);
-      float qcal = acd.samples[itck];
-      AdcFlag flag = acd.flags[itck];
-      AdcCount adc = acd.raw[itck];
-      ++qcnt;
-      qsum += qcal;
-      qqsum += qcal*qcal;
-      data.qcal.push_back(qcal);
-      if ( flag == AdcUnderflow || flag==AdcOverflow ) ++data.nsat;
-      adcs.push_back(adc);
-    }
-    double qmea = qsum/qcnt;
+    data.nsat = sums.nsat[itmd];
+    int qcnt = sums.count[itmd];
+    const short* pradc = sums.radc.data() + itmd*sums.stride;
+    const float* pqcal = sums.qcal.data() + itmd*sums.stride;
+    data.radc.assign(pradc, pradc + qcnt);
+    data.qcal.assign(pqcal, pqcal + qcnt);
+    double qmea = sums.qsum[itmd]/qcnt;
     double qmea2 = qmea*qmea;
-    double qqmea = qqsum/qcnt;
+    double qqmea = sums.qqsum[itmd]/qcnt;
     double qrms = qqmea > qmea2 ? sqrt(qqmea - qmea2) : 0.0;
     data.cmea = qmea;
     data.crms = qrms;
-    StickyCodeMetrics sm(adcs);
+    StickyCodeMetrics sm(pradc, pradc + qcnt);
     data.sadc = sm.maxAdc();
     data.adcm = sm.meanAdc();
     data.adcn = sm.meanAdc2();
@@ -260,8 +353,8 @@ DataMap FembTestTickModTree::fill(AdcChannelData& acd) {
     }
     int ngood = 0;
     float efflim = 2.5;
-    for ( float qcal : data.qcal ) {
-      if ( fabs(qcal - qmea) < efflim ) ++ngood;
+    for ( int iq=0; iq<qcnt; ++iq ) {
+      if ( fabs(pqcal[iq] - qmea) < efflim ) ++ngood;
     }
     data.efft = qcnt > 0 ? float(ngood)/qcnt : 0.0;
   }
@@ -302,11 +395,57 @@ void FembTestTickModTree::write() {
   }
   file()->Write();
   if ( pdirSave != nullptr ) pdirSave->cd();
+  if ( m_pcols != nullptr ) m_pcols->flush();
   m_needWrite = false;
 }
 
 //**********************************************************************
 
+int FembTestTickModTree::exportColumns(string fname) {
+  const string myname = "FembTestTickModTree::exportColumns: ";
+  if ( m_pcols != nullptr ) {
+    cout << myname << "Columns are already exported to " << m_pcols->fileName() << endl;
+    return 1;
+  }
+  std::unique_ptr<FembColumnWriter> pcols(new FembColumnWriter(fname));
+  if ( ! pcols->isOpen() ) return 2;
+  // The order must match that in fill.
+  using Col = FembColumnWriter;
+  pcols->addColumn("femb", Col::UInt32);
+  pcols->addColumn("gain", Col::UInt32);
+  pcols->addColumn("shap", Col::UInt32);
+  pcols->addColumn("extp", Col::Bool8);
+  pcols->addColumn("ntmd", Col::Int32);
+  pcols->addColumn("chan", Col::UInt32);
+  pcols->addColumn("ped0", Col::Float32);
+  pcols->addColumn("qexp", Col::Float32);
+  pcols->addColumn("ievt", Col::UInt32);
+  pcols->addColumn("itmx", Col::UInt32);
+  pcols->addColumn("itmn", Col::UInt32);
+  pcols->addColumn("effq", Col::Float32);
+  pcols->addColumn("effp", Col::Float32);
+  pcols->addColumn("pede", Col::Float32);
+  pcols->addColumn("itmd", Col::Int32);
+  pcols->addColumn("cmea", Col::Float32);
+  pcols->addColumn("crms", Col::Float32);
+  pcols->addColumn("sadc", Col::Float32);
+  pcols->addColumn("adcm", Col::Float32);
+  pcols->addColumn("adcn", Col::Float32);
+  pcols->addColumn("efft", Col::Float32);
+  pcols->addColumn("sfmx", Col::Float32);
+  pcols->addColumn("sf00", Col::Float32);
+  pcols->addColumn("sf01", Col::Float32);
+  pcols->addColumn("sf63", Col::Float32);
+  pcols->addColumn("nsat", Col::Int32);
+  pcols->addColumn("radc", Col::Int16, true);
+  pcols->addColumn("qcal", Col::Float32, true);
+  if ( pcols->columnCount() != 28 ) return 3;
+  m_pcols = std::move(pcols);
+  return 0;
+}
+
+//**********************************************************************
+
 const FembTestTickModData*
 FembTestTickModTree::read(Index icha, Index ient, bool copy) {
   const string myname = "FembTestTickModTree::data: ";
@@ -11,12 +11,14 @@
 #define FembTestTickModTree_H
 
 #include <string>
+#include <memory>
 #include "FembTestTickModData.h"
 #include "dune/DuneInterface/Data/DataMap.h"
 #include "TTree.h"
 #include "TFile.h"
 
 class AdcChannelData;
+class FembColumnWriter;
 
 class FembTestTickModTree {
 
@@ -78,9 +80,17 @@ public:
   // Write the trees to the file.
   void write();
 
+  // Also write each entry filled into a channel tree to the columnar file
+  // fname (see FembColumnWriter). All channels go to the one table. The
+  // jagged fields radc and qcal are stored as offsets and values.
+  // The file is completed when this object is deleted.
+  // Returns 0 for success.
+  int exportColumns(std::string fname);
+
   // Getters.
   bool haveFile() const { return m_pfile != nullptr && m_pfile->IsOpen(); }
   TFile* file() { return m_pfile; }
+  FembColumnWriter* columnWriter() { return m_pcols.get(); }
   bool haveTree(Index icha) const { return icha < m_trees.size() && m_trees[icha] != nullptr; }
   const TTree* tree(Index icha) const { return haveTree(icha) ? m_trees[icha] : nullptr; }
   TTree* tree(Index icha)             { return haveTree(icha) ? m_trees[icha] : nullptr; }
@@ -100,6 +110,7 @@ private:
   bool m_needWrite;
   TTree* m_ptreeWrite;
   Index m_chanWrite;
+  std::unique_ptr<FembColumnWriter> m_pcols;
 
 };
 
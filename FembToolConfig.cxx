@@ -0,0 +1,61 @@
+// FembToolConfig.cxx
+
+#include "FembToolConfig.h"
+#include "fhiclcpp/make_ParameterSet.h"
+#include "cetlib/filepath_maker.h"
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <exception>
+
+using std::string;
+using std::cout;
+using std::endl;
+
+using Name = FembToolConfig::Name;
+
+//**********************************************************************
+
+const FembToolConfig& FembToolConfig::instance(Name fclName) {
+  static std::mutex instanceMutex;
+  static std::map<Name, std::unique_ptr<FembToolConfig>> instances;
+  std::lock_guard<std::mutex> lock(instanceMutex);
+  std::unique_ptr<FembToolConfig>& pcfg = instances[fclName];
+  if ( ! pcfg ) pcfg.reset(new FembToolConfig(fclName));
+  return *pcfg;
+}
+
+//**********************************************************************
+
+FembToolConfig::FembToolConfig(Name a_fclName)
+: m_fclName(a_fclName), m_isValid(false) {
+  const string myname = "FembToolConfig::ctor: ";
+  fhicl::ParameterSet psTop;
+  try {
+    cet::filepath_lookup policy("FHICL_FILE_PATH");
+    m_filePath = policy(m_fclName);
+    fhicl::make_ParameterSet(m_fclName, policy, psTop);
+  } catch ( std::exception& exc ) {
+    cout << myname << "Unable to read " << m_fclName << ": " << exc.what() << endl;
+    return;
+  }
+  fhicl::ParameterSet psTools;
+  if ( ! psTop.get_if_present<fhicl::ParameterSet>("tools", psTools) ) {
+    cout << myname << "No tools found in " << m_fclName << endl;
+    return;
+  }
+  for ( Name toolName : psTools.get_pset_names() ) {
+    m_pars[toolName] = psTools.get<fhicl::ParameterSet>(toolName);
+  }
+  m_isValid = true;
+}
+
+//**********************************************************************
+
+const fhicl::ParameterSet* FembToolConfig::toolPars(Name toolName) const {
+  ParMap::const_iterator ient = m_pars.find(toolName);
+  if ( ient == m_pars.end() ) return nullptr;
+  return &ient->second;
+}
+
+//**********************************************************************
@@ -0,0 +1,60 @@
+// FembToolConfig.h
+//
+// Read-only access to the tool configurations in a top-level FCL file
+// such as dunefemb.fcl. This lets code that reimplements a tool natively
+// use the same parameters (thresholds, ranges, ...) as the tool.
+//
+// The file is found using FHICL_FILE_PATH and is parsed once per process.
+
+#ifndef FembToolConfig_H
+#define FembToolConfig_H
+
+#include <string>
+#include <map>
+#include "fhiclcpp/ParameterSet.h"
+
+class FembToolConfig {
+
+public:
+
+  using Name = std::string;
+  using ParMap = std::map<Name, fhicl::ParameterSet>;
+
+  // Return the configuration for an FCL file.
+  static const FembToolConfig& instance(Name fclName ="dunefemb.fcl");
+
+  // Ctor from an FCL file name.
+  explicit FembToolConfig(Name fclName);
+
+  // Return if the file was found and parsed.
+  bool isValid() const { return m_isValid; }
+
+  // Return the configuration for a tool or null if it is not defined.
+  const fhicl::ParameterSet* toolPars(Name toolName) const;
+
+  // Return a parameter for a tool or def if the tool or parameter is not found.
+  template<typename T>
+  T get(Name toolName, Name key, T def) const {
+    const fhicl::ParameterSet* pps = toolPars(toolName);
+    if ( pps == nullptr ) return def;
+    T val = def;
+    if ( ! pps->get_if_present<T>(key, val) ) return def;
+    return val;
+  }
+
+  // Getters.
+  Name fclName() const { return m_fclName; }
+
+  // Path of the file found using FHICL_FILE_PATH. Blank if not found.
+  Name filePath() const { return m_filePath; }
+
+private:
+
+  Name m_fclName;
+  Name m_filePath;
+  bool m_isValid;
+  ParMap m_pars;
+
+};
+
+#endif
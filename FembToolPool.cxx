@@ -0,0 +1,136 @@
+// FembToolPool.cxx
+
+#include "FembToolPool.h"
+#include "FembToolConfig.h"
+#include "dune/ArtSupport/DuneToolManager.h"
+#include "dune/DuneInterface/Tool/AdcChannelTool.h"
+#include <iostream>
+#include <iomanip>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::lock_guard;
+using std::mutex;
+
+using Index = FembToolPool::Index;
+using Name = FembToolPool::Name;
+using ToolPtr = FembToolPool::ToolPtr;
+
+//**********************************************************************
+
+FembToolPool& FembToolPool::instance(Name fclName) {
+  static mutex instanceMutex;
+  static std::map<Name, FembToolPool*>* pinstances = new std::map<Name, FembToolPool*>;
+  lock_guard<mutex> lock(instanceMutex);
+  FembToolPool*& ppool = (*pinstances)[fclName];
+  if ( ppool == nullptr ) ppool = new FembToolPool(fclName);
+  return *ppool;
+}
+
+//**********************************************************************
+
+FembToolPool::FembToolPool(Name fclName)
+: m_fclName(fclName), m_maxIdle(16), m_ncreate(0), m_nreuse(0) { }
+
+//**********************************************************************
+
+ToolPtr FembToolPool::acquire(Name toolName) {
+  const string myname = "FembToolPool::acquire: ";
+  lock_guard<mutex> lock(m_mutex);
+  Entry& ent = entry(toolName);
+  ToolPtr ptool;
+  if ( ent.idle.size() ) {
+    ptool = std::move(ent.idle.back());
+    ent.idle.pop_back();
+    ++m_nreuse;
+  } else {
+    DuneToolManager* ptm = DuneToolManager::instance(m_fclName);
+    if ( ptm == nullptr ) {
+      cout << myname << "Unable to retrieve tool manager." << endl;
+      return nullptr;
+    }
+    ptool = ptm->getPrivate<AdcChannelTool>(toolName);
+    if ( ! ptool ) return nullptr;
+    ++m_ncreate;
+  }
+  m_inUse[ptool.get()] = ent.generation;
+  return ptool;
+}
+
+//**********************************************************************
+
+void FembToolPool::release(Name toolName, ToolPtr ptool) {
+  if ( ! ptool ) return;
+  lock_guard<mutex> lock(m_mutex);
+  std::map<const AdcChannelTool*, Index>::iterator iuse = m_inUse.find(ptool.get());
+  // Instances not from this pool are deleted.
+  if ( iuse == m_inUse.end() ) return;
+  Index gen = iuse->second;
+  m_inUse.erase(iuse);
+  Entry& ent = entry(toolName);
+  if ( gen != ent.generation ) return;
+  if ( ent.idle.size() >= m_maxIdle ) return;
+  ent.idle.push_back(std::move(ptool));
+}
+
+//**********************************************************************
+
+Index FembToolPool::invalidate(Name prefix) {
+  lock_guard<mutex> lock(m_mutex);
+  Index ndrop = 0;
+  for ( auto& ient : m_entries ) {
+    if ( ient.first.compare(0, prefix.size(), prefix) != 0 ) continue;
+    Entry& ent = ient.second;
+    ++ent.generation;
+    ndrop += ent.idle.size();
+    ent.idle.clear();
+  }
+  return ndrop;
+}
+
+//**********************************************************************
+
+void FembToolPool::setMaxIdle(Index val) {
+  lock_guard<mutex> lock(m_mutex);
+  m_maxIdle = val;
+  for ( auto& ient : m_entries ) {
+    std::vector<ToolPtr>& idle = ient.second.idle;
+    if ( idle.size() > val ) idle.resize(val);
+  }
+}
+
+//**********************************************************************
+
+Index FembToolPool::idleCount() const {
+  lock_guard<mutex> lock(m_mutex);
+  Index nidle = 0;
+  for ( const auto& ient : m_entries ) nidle += ient.second.idle.size();
+  return nidle;
+}
+
+//**********************************************************************
+
+void FembToolPool::print() const {
+  lock_guard<mutex> lock(m_mutex);
+  cout << "Tool pool for " << m_fclName << ": " << m_ncreate << " created, "
+       << m_nreuse << " reused, " << m_inUse.size() << " in use." << endl;
+  for ( const auto& ient : m_entries ) {
+    cout << setw(40) << ient.first << setw(4) << ient.second.idle.size() << " idle" << endl;
+  }
+}
+
+//**********************************************************************
+
+FembToolPool::Entry& FembToolPool::entry(Name toolName) {
+  Name& key = m_keys[toolName];
+  if ( key.empty() ) {
+    // The configuration is parsed once per process, so the key does not change.
+    const fhicl::ParameterSet* pps = FembToolConfig::instance(m_fclName).toolPars(toolName);
+    key = toolName + "#" + (pps == nullptr ? "none" : pps->id().to_string());
+  }
+  return m_entries[key];
+}
+
+//**********************************************************************
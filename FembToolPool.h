@@ -0,0 +1,109 @@
+// FembToolPool.h
+//
+// Process-wide pool of private AdcChannelTool instances.
+//
+// acquire returns an idle instance of a tool if there is one and otherwise
+// creates one with the DuneToolManager. release returns the instance to
+// the pool when its user (e.g. a FembTestAnalyzer) is done with it, so
+// later users get a ready instance instead of constructing the tool and
+// its configuration again. An instance is held by one user at a time.
+//
+// Instances are keyed by the resolved tool name (e.g. fembCalibratorG2S2)
+// and the ID (content hash) of the tool configuration in the FCL file, so
+// a tool whose configuration differs is never reused. Tools that read
+// other files when they are constructed, e.g. the calibration FCL read by
+// the fembCalibrator tools, must be dropped with invalidate when those
+// files change. FembTestAnalyzer::writeCalibFcl does this for the
+// calibrators.
+//
+// The pool is thread safe. Tools are created one at a time because the
+// tool manager is not thread safe. Instances are not shared, so they may
+// be used concurrently by different threads.
+//
+// Only tools that carry no state from one call to the next, e.g. the
+// pedestal fit, sample filler, calibrators and signal finders, should be
+// pooled. Viewers such as adcRoiViewer accumulate state and do their
+// end-of-job work in their destructors, so they are created privately for
+// each user instead.
+//
+// The pools are not deleted at exit so that tools are not destroyed after
+// their plugin libraries are unloaded.
+
+#ifndef FembToolPool_H
+#define FembToolPool_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+class AdcChannelTool;
+
+class FembToolPool {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using ToolPtr = std::unique_ptr<AdcChannelTool>;
+
+  // Return the pool for an FCL file.
+  static FembToolPool& instance(Name fclName ="dunefemb.fcl");
+
+  // Ctor from the FCL file name.
+  explicit FembToolPool(Name fclName);
+
+  // Delete copy and assignment.
+  FembToolPool(const FembToolPool&) =delete;
+  FembToolPool& operator=(const FembToolPool&) =delete;
+
+  // Return an instance of a tool or null if it cannot be created.
+  ToolPtr acquire(Name toolName);
+
+  // Return an instance obtained with acquire to the pool.
+  void release(Name toolName, ToolPtr ptool);
+
+  // Drop the idle instances of the tools whose names start with prefix.
+  // Instances in use are dropped when they are released.
+  // Returns the number of instances dropped.
+  Index invalidate(Name prefix);
+
+  // Maximum number of idle instances kept for each tool.
+  void setMaxIdle(Index val);
+  Index maxIdle() const { return m_maxIdle; }
+
+  // Counts.
+  Index createCount() const { return m_ncreate; }
+  Index reuseCount() const { return m_nreuse; }
+  Index idleCount() const;
+
+  // Display the pool.
+  void print() const;
+
+  // Getters.
+  Name fclName() const { return m_fclName; }
+
+private:
+
+  // Idle instances and generation for a tool.
+  struct Entry {
+    Index generation = 0;
+    std::vector<ToolPtr> idle;
+  };
+
+  // Return the entry for a tool. Called with the mutex held.
+  Entry& entry(Name toolName);
+
+  Name m_fclName;
+  Index m_maxIdle;
+  Index m_ncreate;
+  Index m_nreuse;
+  std::map<Name, Name> m_keys;        // Key NAME#CONFIGID for each tool name
+  std::map<Name, Entry> m_entries;    // [key]
+  std::map<const AdcChannelTool*, Index> m_inUse;   // Generation of instances in use
+  mutable std::mutex m_mutex;
+
+};
+
+#endif
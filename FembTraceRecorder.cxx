@@ -0,0 +1,154 @@
+// FembTraceRecorder.cxx
+
+#include "FembTraceRecorder.h"
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <unistd.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::ofstream;
+using std::lock_guard;
+using std::mutex;
+
+using Index = FembTraceRecorder::Index;
+using Name = FembTraceRecorder::Name;
+
+namespace {
+
+// Each recorder has a distinct ID so a thread does not reuse the buffer
+// of a deleted recorder at the same address.
+std::atomic<Index> nextRecorderId(1);
+
+// Last recorder used by this thread and its buffer.
+thread_local Index tlRecorderId = 0;
+thread_local void* tlBuffer = nullptr;
+
+// Write a JSON string.
+void writeString(std::ostream& out, const string& str) {
+  out << '"';
+  for ( char ch : str ) {
+    if ( ch == '"' || ch == '\\' ) out << '\\' << ch;
+    else if ( ch >= 0 && ch < 0x20 ) out << ' ';
+    else out << ch;
+  }
+  out << '"';
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembTraceRecorder::Span::
+Span(FembTraceRecorder* prec, const char* name, int femb, int chan, int event, const Name& suffix)
+: m_prec(prec), m_name(name), m_femb(femb), m_chan(chan), m_event(event) {
+  if ( m_prec == nullptr ) return;
+  m_suffix = suffix;
+  m_start = Clock::now();
+}
+
+//**********************************************************************
+
+FembTraceRecorder::Span::~Span() {
+  if ( m_prec == nullptr ) return;
+  Clock::time_point stop = Clock::now();
+  Event evt;
+  evt.cat = m_name;
+  evt.name = evt.cat + m_suffix;
+  evt.ts = std::chrono::duration<double, std::micro>(m_start - m_prec->m_start).count();
+  evt.dur = std::chrono::duration<double, std::micro>(stop - m_start).count();
+  evt.femb = m_femb;
+  evt.chan = m_chan;
+  evt.event = m_event;
+  m_prec->record(std::move(evt));
+}
+
+//**********************************************************************
+
+FembTraceRecorder::FembTraceRecorder(Name fname)
+: m_fname(fname), m_id(nextRecorderId++), m_start(Clock::now()) { }
+
+//**********************************************************************
+
+FembTraceRecorder::~FembTraceRecorder() { }
+
+//**********************************************************************
+
+FembTraceRecorder::Buffer& FembTraceRecorder::buffer() {
+  if ( tlRecorderId == m_id ) return *static_cast<Buffer*>(tlBuffer);
+  lock_guard<mutex> lock(m_mutex);
+  m_buffers.emplace_back(new Buffer);
+  Buffer& buf = *m_buffers.back();
+  buf.tid = m_buffers.size();
+  buf.events.reserve(4096);
+  tlRecorderId = m_id;
+  tlBuffer = &buf;
+  return buf;
+}
+
+//**********************************************************************
+
+void FembTraceRecorder::record(Event&& evt) {
+  buffer().events.push_back(std::move(evt));
+}
+
+//**********************************************************************
+
+double FembTraceRecorder::now() const {
+  return std::chrono::duration<double, std::micro>(Clock::now() - m_start).count();
+}
+
+//**********************************************************************
+
+Index FembTraceRecorder::eventCount() const {
+  lock_guard<mutex> lock(m_mutex);
+  Index nevt = 0;
+  for ( const std::unique_ptr<Buffer>& pbuf : m_buffers ) nevt += pbuf->events.size();
+  return nevt;
+}
+
+//**********************************************************************
+
+int FembTraceRecorder::flush() {
+  const string myname = "FembTraceRecorder::flush: ";
+  lock_guard<mutex> lock(m_mutex);
+  ofstream fout(m_fname.c_str());
+  if ( ! fout ) {
+    cout << myname << "Unable to open " << m_fname << endl;
+    return 1;
+  }
+  int pid = getpid();
+  Index nevt = 0;
+  fout << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  const char* sep = "\n";
+  for ( const std::unique_ptr<Buffer>& pbuf : m_buffers ) {
+    fout << sep << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+         << ", \"tid\": " << pbuf->tid << ", \"args\": {\"name\": \"thread " << pbuf->tid << "\"}}";
+    sep = ",\n";
+    for ( const Event& evt : pbuf->events ) {
+      fout << sep << "{\"name\": ";
+      writeString(fout, evt.name);
+      fout << ", \"cat\": ";
+      writeString(fout, evt.cat);
+      fout << ", \"ph\": \"X\", \"ts\": " << std::fixed << evt.ts << ", \"dur\": " << evt.dur
+           << std::defaultfloat << ", \"pid\": " << pid << ", \"tid\": " << pbuf->tid << ", \"args\": {";
+      const char* asep = "";
+      if ( evt.femb >= 0 ) { fout << asep << "\"femb\": " << evt.femb; asep = ", "; }
+      if ( evt.chan >= 0 ) { fout << asep << "\"channel\": " << evt.chan; asep = ", "; }
+      if ( evt.event >= 0 ) { fout << asep << "\"event\": " << evt.event; asep = ", "; }
+      fout << "}}";
+      ++nevt;
+    }
+  }
+  fout << "\n]}" << endl;
+  if ( ! fout ) {
+    cout << myname << "Error writing " << m_fname << endl;
+    return 2;
+  }
+  cout << myname << "Wrote " << nevt << " spans to " << m_fname << endl;
+  return 0;
+}
+
+//**********************************************************************
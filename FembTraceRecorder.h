@@ -0,0 +1,103 @@
+// FembTraceRecorder.h
+//
+// Records timed spans of the FEMB analysis and writes them in the Chrome
+// trace-event JSON format, which can be opened with chrome://tracing or
+// the Perfetto UI (ui.perfetto.dev).
+//
+// Each thread appends to its own buffer, so recording takes no lock after
+// the first span on a thread. flush must only be called when no other
+// thread is recording, e.g. after a thread pool has finished.
+//
+// Spans are tagged with FEMB, channel and event. Negative values are omitted.
+
+#ifndef FembTraceRecorder_H
+#define FembTraceRecorder_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+
+class FembTraceRecorder {
+
+public:
+
+  using Index = unsigned int;
+  using Name = std::string;
+  using Clock = std::chrono::steady_clock;
+
+  // One complete span.
+  struct Event {
+    Name name;
+    Name cat;
+    double ts;     // Start time [us] since the recorder was created
+    double dur;    // Duration [us]
+    int femb;
+    int chan;
+    int event;
+  };
+
+  // Records a span from construction to destruction.
+  // The name is name + suffix and the category is name.
+  class Span {
+  public:
+    Span(FembTraceRecorder* prec, const char* name, int femb =-1, int chan =-1,
+         int event =-1, const Name& suffix =Name());
+    ~Span();
+    Span(const Span&) =delete;
+    Span& operator=(const Span&) =delete;
+  private:
+    FembTraceRecorder* m_prec;
+    const char* m_name;
+    Name m_suffix;
+    int m_femb;
+    int m_chan;
+    int m_event;
+    Clock::time_point m_start;
+  };
+
+  // Ctor from the output file name.
+  explicit FembTraceRecorder(Name fname);
+
+  // Dtor.
+  ~FembTraceRecorder();
+
+  // Delete copy and assignment.
+  FembTraceRecorder(const FembTraceRecorder&) =delete;
+  FembTraceRecorder& operator=(const FembTraceRecorder&) =delete;
+
+  // Add a span for the calling thread.
+  void record(Event&& evt);
+
+  // Return the time [us] since the recorder was created.
+  double now() const;
+
+  // Write all spans recorded so far to the output file.
+  // Returns 0 for success.
+  int flush();
+
+  // Getters.
+  Name fileName() const { return m_fname; }
+  Index eventCount() const;
+
+private:
+
+  // Buffer for one thread.
+  struct Buffer {
+    Index tid;
+    std::vector<Event> events;
+  };
+
+  Name m_fname;
+  Index m_id;
+  Clock::time_point m_start;
+  mutable std::mutex m_mutex;   // Protects m_buffers (not their content)
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+
+  // Return the buffer for the calling thread.
+  Buffer& buffer();
+
+};
+
+#endif
@@ -0,0 +1,145 @@
+// FembWorkStealingPool.cxx
+
+#include "FembWorkStealingPool.h"
+#include <iostream>
+#include <exception>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+
+using Index = FembWorkStealingPool::Index;
+
+namespace {
+
+// Pool and index for the calling worker thread.
+thread_local const FembWorkStealingPool* tlpool = nullptr;
+thread_local Index tliwkr = FembWorkStealingPool::badIndex();
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+FembWorkStealingPool::FembWorkStealingPool(Index nthread)
+: m_nqueued(0), m_nunfinished(0), m_nfail(0), m_nsteal(0), m_next(0), m_stop(false) {
+  if ( nthread == 0 ) nthread = std::thread::hardware_concurrency();
+  if ( nthread == 0 ) nthread = 1;
+  // The queues are complete before any worker starts: workers read their
+  // count while the later workers are being added.
+  for ( Index iwkr=0; iwkr<nthread; ++iwkr ) m_queues.emplace_back(new Queue);
+  m_workers.reserve(nthread);
+  for ( Index iwkr=0; iwkr<nthread; ++iwkr ) {
+    m_workers.emplace_back(&FembWorkStealingPool::run, this, iwkr);
+  }
+}
+
+//**********************************************************************
+
+FembWorkStealingPool::~FembWorkStealingPool() {
+  wait();
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cvWork.notify_all();
+  for ( std::thread& thr : m_workers ) thr.join();
+}
+
+//**********************************************************************
+
+void FembWorkStealingPool::submit(Task task) {
+  Index nwkr = size();
+  Index iwkr = tlpool == this ? tliwkr : m_next++%nwkr;
+  ++m_nunfinished;
+  {
+    // Take the lock so a worker cannot miss the notification between
+    // checking the count and going to sleep. The count is incremented
+    // before the task is visible so a thief cannot decrement it first.
+    lock_guard<mutex> lock(m_mutex);
+    ++m_nqueued;
+    Queue& que = *m_queues[iwkr];
+    lock_guard<mutex> qlock(que.mutex);
+    que.tasks.push_back(std::move(task));
+  }
+  m_cvWork.notify_one();
+}
+
+//**********************************************************************
+
+Index FembWorkStealingPool::wait() {
+  unique_lock<mutex> lock(m_mutex);
+  m_cvDone.wait(lock, [this]{ return m_nunfinished == 0; });
+  return m_nfail.exchange(0);
+}
+
+//**********************************************************************
+
+Index FembWorkStealingPool::workerIndex() {
+  return tliwkr;
+}
+
+//**********************************************************************
+
+bool FembWorkStealingPool::fetch(Index iwkr, Task& task) {
+  // Own queue, newest first.
+  {
+    Queue& que = *m_queues[iwkr];
+    lock_guard<mutex> lock(que.mutex);
+    if ( que.tasks.size() ) {
+      task = std::move(que.tasks.back());
+      que.tasks.pop_back();
+      return true;
+    }
+  }
+  // Steal the oldest task from another queue.
+  Index nwkr = size();
+  for ( Index ioff=1; ioff<nwkr; ++ioff ) {
+    Queue& que = *m_queues[(iwkr + ioff)%nwkr];
+    lock_guard<mutex> lock(que.mutex);
+    if ( que.tasks.size() ) {
+      task = std::move(que.tasks.front());
+      que.tasks.pop_front();
+      ++m_nsteal;
+      return true;
+    }
+  }
+  return false;
+}
+
+//**********************************************************************
+
+void FembWorkStealingPool::run(Index iwkr) {
+  const string myname = "FembWorkStealingPool::run: ";
+  tlpool = this;
+  tliwkr = iwkr;
+  while ( true ) {
+    Task task;
+    if ( ! fetch(iwkr, task) ) {
+      unique_lock<mutex> lock(m_mutex);
+      m_cvWork.wait(lock, [this]{ return m_stop || m_nqueued > 0; });
+      if ( m_stop && m_nqueued == 0 ) break;
+      continue;
+    }
+    --m_nqueued;
+    try {
+      task();
+    } catch ( std::exception& exc ) {
+      cout << myname << "ERROR: Task raised exception: " << exc.what() << endl;
+      ++m_nfail;
+    } catch ( ... ) {
+      cout << myname << "ERROR: Task raised an unknown exception." << endl;
+      ++m_nfail;
+    }
+    if ( --m_nunfinished == 0 ) {
+      lock_guard<mutex> lock(m_mutex);
+      m_cvDone.notify_all();
+    }
+  }
+  tlpool = nullptr;
+  tliwkr = badIndex();
+}
+
+//**********************************************************************
@@ -0,0 +1,90 @@
+// FembWorkStealingPool.h
+//
+// Thread pool where each worker owns a task queue and idle workers
+// steal from the others.
+//
+// Tasks submitted from a worker are pushed on that worker's queue and
+// are popped LIFO by the owner so that dependent work (e.g. the area fit
+// that follows a height fit) runs soon and on the same thread.
+// Thieves take the oldest task (FIFO) from the queue of another worker.
+// Tasks submitted from outside the pool are distributed round-robin.
+//
+// Tasks should not throw. Any exception is caught, reported and counted.
+
+#ifndef FembWorkStealingPool_H
+#define FembWorkStealingPool_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+class FembWorkStealingPool {
+
+public:
+
+  using Index = unsigned int;
+  using Task = std::function<void()>;
+
+  // Ctor from the number of worker threads.
+  // If nthread is zero, the hardware concurrency is used.
+  explicit FembWorkStealingPool(Index nthread =0);
+
+  // Dtor. Waits for all tasks to complete and joins the workers.
+  ~FembWorkStealingPool();
+
+  // Delete copy and assignment.
+  FembWorkStealingPool(const FembWorkStealingPool&) =delete;
+  FembWorkStealingPool& operator=(const FembWorkStealingPool&) =delete;
+
+  // Submit a task.
+  void submit(Task task);
+
+  // Wait until all submitted tasks, including those submitted by other
+  // tasks, have completed.
+  // Returns the number of tasks that raised an exception since the last wait.
+  Index wait();
+
+  // Number of worker threads.
+  Index size() const { return m_queues.size(); }
+
+  // Number of tasks stolen from another worker.
+  Index stealCount() const { return m_nsteal; }
+
+  // Index of the calling worker in its pool or badIndex() if the caller
+  // is not a pool worker.
+  static Index workerIndex();
+  static Index badIndex() { return Index(-1); }
+
+private:
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Worker loop.
+  void run(Index iwkr);
+
+  // Fetch a task for worker iwkr: own queue first, then steal.
+  bool fetch(Index iwkr, Task& task);
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_workers;
+  std::mutex m_mutex;                 // Guards sleeping and completion.
+  std::condition_variable m_cvWork;   // Signaled when tasks are queued.
+  std::condition_variable m_cvDone;   // Signaled when the pool drains.
+  std::atomic<Index> m_nqueued;       // Tasks in the queues.
+  std::atomic<Index> m_nunfinished;   // Tasks queued or running.
+  std::atomic<Index> m_nfail;
+  std::atomic<Index> m_nsteal;
+  std::atomic<Index> m_next;          // Round robin for external submits.
+  bool m_stop;
+
+};
+
+#endif
@@ -1,9 +1,9 @@
 // StickyCodeMetrics.cxx
 
 #include "StickyCodeMetrics.h"
-#include <map>
+#include <vector>
 
-using std::map;
+using std::vector;
 
 namespace {
 using Index = unsigned int;
@@ -11,19 +11,34 @@ using Index = unsigned int;
 
 //**********************************************************************
 
-StickyCodeMetrics::StickyCodeMetrics(const AdcCountVector& adcs) {
-  map<AdcCount, Index> counts;
+StickyCodeMetrics::StickyCodeMetrics(const AdcCountVector& adcs)
+: StickyCodeMetrics(adcs.data(), adcs.data() + adcs.size()) { }
+
+//**********************************************************************
+
+StickyCodeMetrics::StickyCodeMetrics(const AdcCount* begin, const AdcCount* end) {
+  // Count the codes in a flat histogram over the range of the codes.
+  AdcCount adcmin = 0;
+  AdcCount adcmax = -1;
+  for ( const AdcCount* padc=begin; padc!=end; ++padc ) {
+    AdcCount adc = *padc;
+    if ( adcmax < adcmin ) adcmin = adcmax = adc;
+    else if ( adc < adcmin ) adcmin = adc;
+    else if ( adc > adcmax ) adcmax = adc;
+  }
+  vector<Index> counts(adcmax >= adcmin ? adcmax - adcmin + 1 : 0, 0);
   int maxadc = -1;
   Index maxCount = 0;
   Index nmod0 = 0;
   Index nmod1 = 0;
   Index nmod63 = 0;
   Index adcsum = 0;
-  for ( AdcCount adc : adcs ) {
-    if ( counts.find(adc) == counts.end() ) counts[adc] = 0;
-    ++counts[adc];
-    if ( counts[adc] > maxCount ) {
-      maxCount = counts[adc];
+  for ( const AdcCount* padc=begin; padc!=end; ++padc ) {
+    AdcCount adc = *padc;
+    Index count = ++counts[adc - adcmin];
+    // The first code to reach the maximum count is kept.
+    if ( count > maxCount ) {
+      maxCount = count;
       maxadc = adc;
     }
     AdcCount adcmod = adc%64;
@@ -34,15 +49,15 @@ StickyCodeMetrics::StickyCodeMetrics(const AdcCountVector& adcs) {
   }
   Index adcCount2 = 0;
   Index adcsum2 = 0;
-  for ( auto ent : counts ) {
-    AdcCount adc = ent.first;
-    Index count = ent.second;
+  for ( Index ibin=0; ibin<counts.size(); ++ibin ) {
+    AdcCount adc = adcmin + ibin;
+    Index count = counts[ibin];
     if ( adc != maxadc ) {
       adcCount2 += count;
       adcsum2 += count*adc;
     }
   }
-  double count = adcs.size();
+  double count = end - begin;
   double count2 = adcCount2;
   m_maxAdc = maxadc;
   m_meanAdc = count>0 ? adcsum/count : -1.0;
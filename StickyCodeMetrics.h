@@ -29,6 +29,9 @@ public:
   // These typically are for a narrow range of input signals.
   StickyCodeMetrics(const AdcCountVector& adcs);
 
+  // Ctor from the range [begin, end) of an array of ADC codes.
+  StickyCodeMetrics(const AdcCount* begin, const AdcCount* end);
+
   // Metrics.
   int maxAdc() const { return m_maxAdc; }
   int meanAdc() const { return m_meanAdc; }
@@ -0,0 +1,420 @@
+// bench_dunefemb.cxx
+//
+// Benchmarks for the dunefemb hot paths on synthetic data from
+// FembDataGenerator. Build and run with
+//
+//   make bench
+//
+// or run bench_dunefemb directly with options
+//   --events N       events in the dataset (default 10)
+//   --channels N     channels in the dataset (default 128)
+//   --ticks N        ticks per waveform (default 19499)
+//   --dir DIR        directory for the synthetic data (default bench_data)
+//   --out FILE       JSON output (default bench_output.json)
+//   --baseline FILE  compare with the results in an earlier output
+//   --tolerance X    allowed fractional rate drop before a regression is flagged (default 0.10)
+//   --only STR       run only benchmarks whose name contains STR
+//   --no-analyzer    skip the FembTestAnalyzer benchmarks (which need the dunetpc tools)
+//
+// Each benchmark reports the count of processed items (channel-events,
+// waveforms, finds, ...), the elapsed time, the item rate, the data rate
+// (MB/s of raw ADC data) and the peak RSS of the process so far.
+// The JSON output has one result per line so it can be used as a baseline.
+// The exit status is 1 if any rate is below the baseline by more than the
+// tolerance.
+
+#include "DuneFembReader.h"
+#include "DuneFembFinder.h"
+#include "FembDataGenerator.h"
+#include "FembTestTickModTree.h"
+#include "FembTestTickModViewer.h"
+#include "FembTestAnalyzer.h"
+#include "StickyCodeMetrics.h"
+#include "dune/DuneInterface/AdcChannelData.h"
+#include "TROOT.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/resource.h>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::setw;
+using std::vector;
+using std::ofstream;
+using std::ifstream;
+using std::ostringstream;
+
+//**********************************************************************
+
+namespace {
+
+using Index = unsigned int;
+using Entry = DuneFembReader::Entry;
+using Clock = std::chrono::steady_clock;
+
+// Result of one benchmark.
+struct Result {
+  string name;
+  string status = "ok";
+  string unit;             // Name of the counted items
+  double count = 0.0;
+  double bytes = 0.0;
+  double seconds = 0.0;
+  double rssMB = 0.0;
+  double rate() const { return seconds > 0.0 ? count/seconds : 0.0; }
+  double mbps() const { return seconds > 0.0 ? 1.e-6*bytes/seconds : 0.0; }
+};
+
+// Peak resident set size of this process [MB].
+double peakRssMB() {
+  struct rusage ru;
+  if ( getrusage(RUSAGE_SELF, &ru) ) return 0.0;
+  return ru.ru_maxrss/1024.0;
+}
+
+// Timer that fills a result when stopped.
+class Timer {
+public:
+  Timer(Result& res) : m_res(res), m_start(Clock::now()) { }
+  void stop() {
+    m_res.seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+    m_res.rssMB = peakRssMB();
+  }
+private:
+  Result& m_res;
+  Clock::time_point m_start;
+};
+
+// Fill samples, flags and pedestal for a raw waveform.
+void prepare(AdcChannelData& acd) {
+  AdcCountVector adcs = acd.raw;
+  std::nth_element(adcs.begin(), adcs.begin() + adcs.size()/2, adcs.end());
+  acd.pedestal = adcs.size() ? adcs[adcs.size()/2] : 0.0;
+  Index nsam = acd.raw.size();
+  acd.samples.resize(nsam);
+  acd.flags.assign(nsam, AdcGood);
+  for ( Index isam=0; isam<nsam; ++isam ) {
+    AdcCount adc = acd.raw[isam];
+    acd.samples[isam] = adc - acd.pedestal;
+    if ( adc <= 0 ) acd.flags[isam] = AdcUnderflow;
+    if ( adc >= 4095 ) acd.flags[isam] = AdcOverflow;
+  }
+}
+
+// Write the results as JSON, one result for each line.
+int writeJson(string fname, const FembDataGenerator::Config& cfg, const vector<Result>& ress) {
+  ofstream fout(fname.c_str());
+  if ( ! fout ) return 1;
+  fout << "{\n";
+  fout << "  \"config\": {\"channels\": " << cfg.nChannel << ", \"events\": " << cfg.nEvent
+       << ", \"ticks\": " << cfg.nTick << "},\n";
+  fout << "  \"results\": [\n";
+  for ( Index ires=0; ires<ress.size(); ++ires ) {
+    const Result& res = ress[ires];
+    fout << "    {\"name\": \"" << res.name << "\", \"status\": \"" << res.status
+         << "\", \"unit\": \"" << res.unit << "\", \"count\": " << res.count
+         << ", \"seconds\": " << res.seconds << ", \"rate\": " << res.rate()
+         << ", \"mbps\": " << res.mbps() << ", \"rssMB\": " << res.rssMB << "}"
+         << (ires + 1 < ress.size() ? "," : "") << "\n";
+  }
+  fout << "  ]\n}\n";
+  return fout ? 0 : 2;
+}
+
+// Return the value of a field in a result line or blank.
+string jsonField(const string& line, string name) {
+  string key = "\"" + name + "\": ";
+  string::size_type ipos = line.find(key);
+  if ( ipos == string::npos ) return "";
+  ipos += key.size();
+  if ( line[ipos] == '"' ) {
+    string::size_type jpos = line.find('"', ipos + 1);
+    return jpos == string::npos ? "" : line.substr(ipos + 1, jpos - ipos - 1);
+  }
+  string::size_type jpos = line.find_first_of(",}", ipos);
+  return line.substr(ipos, jpos - ipos);
+}
+
+// Read the rates from a baseline file.
+std::map<string, double> readBaseline(string fname) {
+  std::map<string, double> rates;
+  ifstream fin(fname.c_str());
+  string line;
+  while ( std::getline(fin, line) ) {
+    string name = jsonField(line, "name");
+    if ( name.empty() || jsonField(line, "status") != "ok" ) continue;
+    rates[name] = atof(jsonField(line, "rate").c_str());
+  }
+  return rates;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int main(int argc, char** argv) {
+  const string myname = "bench_dunefemb: ";
+  FembDataGenerator::Config cfg;
+  cfg.nEvent = 10;
+  string dir = "bench_data";
+  string outName = "bench_output.json";
+  string baseName;
+  double tolerance = 0.10;
+  string only;
+  bool doAnalyzer = true;
+  for ( int iarg=1; iarg<argc; ++iarg ) {
+    string arg = argv[iarg];
+    string val = iarg + 1 < argc ? argv[iarg+1] : "";
+    if      ( arg == "--events" )   { cfg.nEvent = atoi(val.c_str()); ++iarg; }
+    else if ( arg == "--channels" ) { cfg.nChannel = atoi(val.c_str()); ++iarg; }
+    else if ( arg == "--ticks" )    { cfg.nTick = atoi(val.c_str()); ++iarg; }
+    else if ( arg == "--dir" )      { dir = val; ++iarg; }
+    else if ( arg == "--out" )      { outName = val; ++iarg; }
+    else if ( arg == "--baseline" ) { baseName = val; ++iarg; }
+    else if ( arg == "--tolerance" ) { tolerance = atof(val.c_str()); ++iarg; }
+    else if ( arg == "--only" )     { only = val; ++iarg; }
+    else if ( arg == "--no-analyzer" ) doAnalyzer = false;
+    else {
+      cout << myname << "Invalid argument: " << arg << endl;
+      return 2;
+    }
+  }
+  gROOT->SetBatch(true);
+  auto selected = [&only](string name) { return only.empty() || name.find(only) != string::npos; };
+  vector<Result> ress;
+  Index ncha = cfg.nChannel;
+  Index nevt = cfg.nEvent;
+  double wfBytes = double(cfg.nTick)*sizeof(unsigned short);
+
+  // Synthetic data. The analyzers find it through DuneFembFinder.
+  FembDataGenerator gen(cfg);
+  FembDataGenerator::Dataset ds;
+  {
+    Result res;
+    res.name = "generate";
+    res.unit = "waveforms";
+    Timer tim(res);
+    if ( gen.writeCampaign(dir, {ds.femb}, {ds.gain}, {ds.shap}, true, false, ds.extPulse, ! ds.extPulse) ) {
+      cout << myname << "Unable to write synthetic data to " << dir << endl;
+      return 2;
+    }
+    tim.stop();
+    res.count = ncha*nevt;
+    res.bytes = res.count*wfBytes;
+    ress.push_back(res);
+  }
+  setenv("DUNEFEMB_DATA", dir.c_str(), 1);
+  string fname = dir + "/wib_synthetic/" + FembDataGenerator::timestamp(ds.femb, ds.isCold) + "/" +
+                 FembDataGenerator::datasetDirName(ds) + "/" + FembDataGenerator::datasetFileName(ds);
+
+  // Reader: open and index.
+  std::unique_ptr<DuneFembReader> prdr;
+  {
+    Result res;
+    res.name = "reader_open";
+    res.unit = "entries";
+    Timer tim(res);
+    prdr.reset(new DuneFembReader(fname));
+    tim.stop();
+    res.count = prdr->nEntry();
+    if ( prdr->tree() == nullptr ) res.status = "failed";
+    ress.push_back(res);
+    if ( prdr->tree() == nullptr ) return 2;
+  }
+  DuneFembReader& rdr = *prdr;
+
+  // Reader: find entries for channel-events in a scattered order.
+  if ( selected("reader_find") ) {
+    Result res;
+    res.name = "reader_find";
+    res.unit = "finds";
+    Index nfind = std::min<Index>(200, ncha*nevt);
+    Timer tim(res);
+    for ( Index ifnd=0; ifnd<nfind; ++ifnd ) {
+      Index idx = (7919*ifnd)%(ncha*nevt);
+      if ( rdr.find(idx/ncha, idx%ncha) == DuneFembReader::badEntry() ) res.status = "failed";
+    }
+    tim.stop();
+    res.count = nfind;
+    ress.push_back(res);
+  }
+
+  // Reader: read all waveforms.
+  if ( selected("reader_read") ) {
+    Result res;
+    res.name = "reader_readWaveform";
+    res.unit = "channel-events";
+    AdcChannelData acd;
+    Timer tim(res);
+    for ( Entry ient=0; ient<rdr.nEntry(); ++ient ) {
+      if ( rdr.readWaveform(ient, &acd) ) res.status = "failed";
+    }
+    tim.stop();
+    res.count = rdr.nEntry();
+    res.bytes = res.count*wfBytes;
+    ress.push_back(res);
+  }
+
+  // Sticky code metrics for each waveform.
+  if ( selected("sticky") ) {
+    Result res;
+    res.name = "sticky_metrics";
+    res.unit = "waveforms";
+    AdcChannelData acd;
+    double asum = 0.0;
+    for ( Entry ient=0; ient<rdr.nEntry(); ++ient ) {
+      rdr.readWaveform(ient, &acd);
+      Clock::time_point start = Clock::now();
+      StickyCodeMetrics scm(acd.raw);
+      res.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+      asum += scm.maxFraction();
+    }
+    res.rssMB = peakRssMB();
+    res.count = rdr.nEntry();
+    res.bytes = res.count*wfBytes;
+    if ( asum < 0.0 ) res.status = "failed";
+    ress.push_back(res);
+  }
+
+  // Tickmod tree fill and viewer.
+  if ( selected("tickmod") ) {
+    string tmName = dir + "/bench_tickmod.root";
+    FembTestTickModTree tmt(tmName, "RECREATE");
+    Result res;
+    res.name = "tickmod_fill";
+    res.unit = "channel-events";
+    AdcChannelData acd;
+    for ( Index icha=0; icha<ncha; ++icha ) {
+      tmt.addTree(icha);
+      for ( Index ievt=0; ievt<nevt; ++ievt ) {
+        rdr.read(ievt, icha, &acd);
+        prepare(acd);
+        tmt.data().femb = ds.femb;
+        tmt.data().gain = ds.gain;
+        tmt.data().shap = ds.shap;
+        tmt.data().extp = ds.extPulse;
+        tmt.data().ntmd = cfg.period;
+        tmt.data().chan = icha;
+        tmt.data().ievt = ievt;
+        Clock::time_point start = Clock::now();
+        DataMap tmres = tmt.fill(acd);
+        res.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        if ( tmres.getInt("tickmodPeriod") != int(cfg.period) ) res.status = "failed";
+      }
+    }
+    tmt.write();
+    res.rssMB = peakRssMB();
+    res.count = ncha*nevt;
+    res.bytes = res.count*wfBytes;
+    ress.push_back(res);
+    Result vres;
+    vres.name = "tickmod_viewer";
+    vres.unit = "plots";
+    Timer tim(vres);
+    FembTestTickModViewer tmv(tmt, 0, ncha);
+    tmv.doDraw(false);
+    vector<string> sels = {"all", "all_nosat", "all_sig", "all_evt3_ped"};
+    vector<string> sopts = {"adc", "qcal", "mod64", "sfmx"};
+    for ( string sel : sels ) {
+      tmv.selection(sel);
+      for ( string sopt : sopts ) {
+        if ( tmv.pad(sopt, sel) == nullptr ) vres.status = "failed";
+        ++vres.count;
+      }
+    }
+    tim.stop();
+    ress.push_back(vres);
+  }
+
+  // Analyzer channel-event processing for each calibration and ROI option
+  // and the response fits.
+  if ( doAnalyzer ) {
+    for ( Index copt=0; copt<3; ++copt ) {
+      for ( Index ropt=0; ropt<3; ++ropt ) {
+        ostringstream ssnam;
+        ssnam << "analyzer_process_c" << copt << "r" << ropt;
+        Result res;
+        res.name = ssnam.str();
+        res.unit = "channel-events";
+        bool doResponse = copt == 0 && ropt == 1;
+        if ( ! selected(res.name) && ! (doResponse && selected("analyzer_response")) ) continue;
+        int opt = 1000 + 10*ropt + copt;
+        FembTestAnalyzer fta(opt, ds.femb, ds.gain, ds.shap, "", ds.isCold, ds.extPulse, ds.extClock);
+        if ( fta.reader() == nullptr || ! fta.haveTools() ) {
+          res.status = "skipped";
+          ress.push_back(res);
+          continue;
+        }
+        Timer tim(res);
+        for ( Index icha=0; icha<fta.nChannel(); ++icha ) {
+          for ( Index ievt=0; ievt<fta.nEvent(); ++ievt ) {
+            if ( fta.processChannelEvent(icha, ievt).status() ) res.status = "failed";
+          }
+        }
+        tim.stop();
+        res.count = fta.nChannel()*fta.nEvent();
+        res.bytes = res.count*wfBytes;
+        ress.push_back(res);
+        if ( doResponse ) {
+          Result fres;
+          fres.name = "analyzer_response";
+          fres.unit = "channels";
+          Timer ftim(fres);
+          for ( Index icha=0; icha<fta.nChannel(); ++icha ) {
+            fta.getChannelResponse(icha, FembTestAnalyzer::OptPositive, false);
+          }
+          ftim.stop();
+          fres.count = fta.nChannel();
+          ress.push_back(fres);
+        }
+      }
+    }
+  }
+
+  // Report.
+  std::map<string, double> baseRates;
+  if ( baseName.size() ) baseRates = readBaseline(baseName);
+  Index nreg = 0;
+  cout << endl;
+  cout << std::left << setw(26) << "Benchmark" << std::right << setw(9) << "Status"
+       << setw(14) << "Rate" << "  " << std::left << setw(16) << "Unit" << std::right
+       << setw(10) << "MB/s" << setw(10) << "RSS MB" << setw(10) << "Baseline" << endl;
+  for ( const Result& res : ress ) {
+    cout << std::left << setw(26) << res.name << std::right << setw(9) << res.status
+         << setw(14) << std::fixed << std::setprecision(1) << res.rate()
+         << "  " << std::left << setw(16) << res.unit << std::right
+         << setw(10) << res.mbps() << setw(10) << res.rssMB;
+    auto ibas = baseRates.find(res.name);
+    if ( ibas != baseRates.end() && res.status == "ok" ) {
+      double ratio = ibas->second > 0.0 ? res.rate()/ibas->second : 1.0;
+      cout << setw(9) << std::setprecision(2) << ratio << "x";
+      if ( ratio < 1.0 - tolerance ) {
+        cout << "  REGRESSION";
+        ++nreg;
+      }
+    }
+    cout << endl;
+  }
+  cout.unsetf(std::ios_base::floatfield);
+  if ( writeJson(outName, cfg, ress) ) {
+    cout << myname << "Unable to write " << outName << endl;
+    return 2;
+  }
+  cout << myname << "Results written to " << outName << endl;
+  if ( nreg ) {
+    cout << myname << "Regression count: " << nreg << endl;
+    return 1;
+  }
+  return 0;
+}
+
+//**********************************************************************
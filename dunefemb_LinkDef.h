@@ -0,0 +1,15 @@
+// dunefemb_LinkDef.h
+//
+// Classes with ROOT dictionaries in libdunefemb. The tickmod tree stores
+// FembTestTickModData as an object branch.
+
+#ifdef __CLING__
+
+#pragma link off all globals;
+#pragma link off all classes;
+#pragma link off all functions;
+
+#pragma link C++ class FembTestTickModData+;
+#pragma link C++ class FembTestPulseData+;
+
+#endif
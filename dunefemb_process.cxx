@@ -0,0 +1,262 @@
+// dunefemb_process.cxx
+//
+// Native batch processing of FEMB test data, i.e. what is otherwise done
+// interactively with FembTestAnalyzer or FembCampaign after rootlogon.C
+// has loaded (and, the first time, compiled) the local classes.
+// Build with
+//
+//   make dunefemb-process
+//
+// Process one dataset:
+//   dunefemb-process --femb N [options]
+//     --gain G         preamp gain index (default 2)
+//     --shap S         shaping index (default 2)
+//     --opt N          analyzer option (default 1010, see FembTestAnalyzer)
+//     --tspat PAT      timestamp pattern
+//     --warm           use data taken warm (default is cold)
+//     --int-pulse      use the internal pulser (default is external)
+//     --int-clock      use the internal clock
+//     --period N       tick period for the tickmod tree (default 0 for no tree)
+//     --pulse-tree     stream the pulse tree (requires a calibrated option)
+//     --columns        also export the trees to columnar files
+//     --calib          write the calibration FCL (requires an uncalibrated option)
+//     --summary NAME   write the summary NAME.json and page NAME.html
+//     --threads N      threads for the response fits (default 1)
+//     --trace FILE     write a trace-event JSON file
+//     --perf           display the performance summary
+//
+// Run a campaign:
+//   dunefemb-process --campaign CHKDIR [options]
+//     --fembs LIST     comma-separated FEMBs (default all)
+//     --gains LIST     comma-separated gains (default all)
+//     --shaps LIST     comma-separated shapings (default all)
+//     --threads N      threads (default 0 for the hardware concurrency)
+//     --memory MB      memory limit (default 0 for no limit)
+//     --plotdir DIR    directory for the report plots
+//     --calibdb FILE   calibration database
+//
+// Survey the pedestals and noise (see FembPedestalSurvey):
+//   dunefemb-process --survey FILE [options]
+//     --fembs, --gains, --shaps and --threads as for a campaign
+//     --no-baseline    only use the no-pulse events
+//     --spectra DIR    write the noise spectra of each dataset to DIR
+//
+// Common options:
+//     --data DIR       top data directory (sets DUNEFEMB_DATA)
+//     --services FCL   load art services with ArtServiceHelper
+//
+// The exit status is 0 for success, 1 if processing fails and 2 for
+// invalid arguments.
+
+#include "FembTestAnalyzer.h"
+#include "FembCampaign.h"
+#include "FembSummaryExporter.h"
+#include "FembPedestalSurvey.h"
+#include "dune/ArtSupport/ArtServiceHelper.h"
+#include "TROOT.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+
+using std::string;
+using std::cout;
+using std::endl;
+using std::vector;
+using std::istringstream;
+
+using Index = unsigned int;
+using IndexVector = vector<Index>;
+
+//**********************************************************************
+
+namespace {
+
+// Split a comma-separated list of indices.
+IndexVector indexList(string sval) {
+  IndexVector vals;
+  istringstream ssin(sval);
+  string sent;
+  while ( std::getline(ssin, sent, ',') ) {
+    if ( sent.size() ) vals.push_back(atoi(sent.c_str()));
+  }
+  return vals;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int main(int argc, char** argv) {
+  const string myname = "dunefemb-process: ";
+  int femb = -1;
+  int gain = 2;
+  int shap = 2;
+  int opt = 1010;
+  string tspat;
+  bool isCold = true;
+  bool extPulse = true;
+  bool extClock = true;
+  Index period = 0;
+  bool doPulseTree = false;
+  bool doColumns = false;
+  bool doCalib = false;
+  string summaryName;
+  int nthread = -1;
+  string traceName;
+  bool doPerf = false;
+  string chkdir;
+  IndexVector fembs;
+  IndexVector gains;
+  IndexVector shaps;
+  double maxMemory = 0.0;
+  string plotdir;
+  string calibdb;
+  bool haveCalibdb = false;
+  string surveyName;
+  string spectrumDir;
+  bool useBaselines = true;
+  string datadir;
+  string servicesFcl;
+  for ( int iarg=1; iarg<argc; ++iarg ) {
+    string arg = argv[iarg];
+    bool haveVal = iarg + 1 < argc;
+    string val = haveVal ? argv[iarg+1] : "";
+    bool needVal = true;
+    if      ( arg == "--femb" )     femb = atoi(val.c_str());
+    else if ( arg == "--gain" )     gain = atoi(val.c_str());
+    else if ( arg == "--shap" )     shap = atoi(val.c_str());
+    else if ( arg == "--opt" )      opt = atoi(val.c_str());
+    else if ( arg == "--tspat" )    tspat = val;
+    else if ( arg == "--period" )   period = atoi(val.c_str());
+    else if ( arg == "--threads" )  nthread = atoi(val.c_str());
+    else if ( arg == "--trace" )    traceName = val;
+    else if ( arg == "--summary" )  summaryName = val;
+    else if ( arg == "--campaign" ) chkdir = val;
+    else if ( arg == "--survey" )   surveyName = val;
+    else if ( arg == "--spectra" )  spectrumDir = val;
+    else if ( arg == "--fembs" )    fembs = indexList(val);
+    else if ( arg == "--gains" )    gains = indexList(val);
+    else if ( arg == "--shaps" )    shaps = indexList(val);
+    else if ( arg == "--memory" )   maxMemory = atof(val.c_str());
+    else if ( arg == "--plotdir" )  plotdir = val;
+    else if ( arg == "--calibdb" )  { calibdb = val; haveCalibdb = true; }
+    else if ( arg == "--data" )     datadir = val;
+    else if ( arg == "--services" ) servicesFcl = val;
+    else {
+      needVal = false;
+      if      ( arg == "--warm" )       isCold = false;
+      else if ( arg == "--int-pulse" )  extPulse = false;
+      else if ( arg == "--int-clock" )  extClock = false;
+      else if ( arg == "--pulse-tree" ) doPulseTree = true;
+      else if ( arg == "--columns" )    doColumns = true;
+      else if ( arg == "--calib" )      doCalib = true;
+      else if ( arg == "--perf" )       doPerf = true;
+      else if ( arg == "--no-baseline" ) useBaselines = false;
+      else {
+        cout << myname << "Invalid argument: " << arg << endl;
+        return 2;
+      }
+    }
+    if ( needVal ) {
+      if ( ! haveVal ) {
+        cout << myname << "Missing value for " << arg << endl;
+        return 2;
+      }
+      ++iarg;
+    }
+  }
+  bool doCampaign = chkdir.size() > 0;
+  bool doSurvey = surveyName.size() > 0;
+  if ( ! doCampaign && ! doSurvey && femb < 0 ) {
+    cout << myname << "One of --femb, --campaign or --survey must be given." << endl;
+    return 2;
+  }
+  gROOT->SetBatch(true);
+  if ( datadir.size() ) setenv("DUNEFEMB_DATA", datadir.c_str(), 1);
+  if ( servicesFcl.size() ) ArtServiceHelper::load(servicesFcl);
+
+  // Survey.
+  if ( doSurvey ) {
+    FembPedestalSurvey::Config cfg;
+    cfg.useBaselines = useBaselines;
+    if ( spectrumDir.size() ) cfg.spectrumLength = 512;
+    FembPedestalSurvey fps("", cfg);
+    fps.setFembs(fembs);
+    fps.setGains(gains);
+    fps.setShapings(shaps);
+    if ( fps.findDatasets() == 0 ) {
+      cout << myname << "No datasets found." << endl;
+      return 1;
+    }
+    Index nfail = fps.run(nthread < 0 ? 0 : nthread);
+    fps.print();
+    if ( fps.writeTable(surveyName) ) return 1;
+    if ( spectrumDir.size() && fps.writeSpectra(spectrumDir) ) return 1;
+    if ( nfail ) {
+      cout << myname << nfail << " datasets failed." << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // Campaign.
+  if ( doCampaign ) {
+    FembCampaign fc(chkdir);
+    fc.setFembs(fembs);
+    fc.setGains(gains);
+    fc.setShapings(shaps);
+    if ( plotdir.size() ) fc.setPlotDir(plotdir);
+    if ( haveCalibdb ) fc.setCalibDatabaseName(calibdb);
+    if ( fc.findDatasets() == 0 ) {
+      cout << myname << "No datasets found." << endl;
+      return 1;
+    }
+    Index nfail = fc.run(nthread < 0 ? 0 : nthread, maxMemory);
+    fc.print();
+    if ( nfail ) {
+      cout << myname << nfail << " jobs failed or were blocked." << endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // Single dataset.
+  FembTestAnalyzer fta(opt, femb, gain, shap, tspat, isCold, extPulse, extClock);
+  if ( fta.reader() == nullptr || fta.reader()->tree() == nullptr ) {
+    cout << myname << "Dataset not found." << endl;
+    return 1;
+  }
+  if ( ! fta.haveTools() ) {
+    cout << myname << "ADC processing tools are missing." << endl;
+    return 1;
+  }
+  if ( nthread > 0 ) fta.setThreadCount(nthread);
+  if ( doPerf ) fta.setPerfMonitor(true);
+  if ( traceName.size() && fta.setTraceFile(traceName) ) return 1;
+  fta.setColumnExport(doColumns);
+  if ( period > 0 && fta.setTickPeriod(period) ) return 1;
+  if ( doPulseTree && fta.streamPulseTree() ) return 1;
+  const DataMap& res = fta.processAll();
+  if ( res.status() ) {
+    cout << myname << "Processing returned status " << res.status() << endl;
+    return 1;
+  }
+  cout << myname << "Processed " << fta.nChannelEventProcessed() << " channel-events." << endl;
+  if ( doCalib && fta.writeCalibFcl() ) {
+    cout << myname << "Unable to write the calibration FCL." << endl;
+    return 1;
+  }
+  if ( summaryName.size() ) {
+    FembSummaryExporter sumexp(&fta);
+    if ( sumexp.writeJson(summaryName + ".json") ||
+         FembSummaryExporter::writeHtml(summaryName + ".html", {summaryName + ".json"}) ) {
+      cout << myname << "Unable to write the summary." << endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//**********************************************************************
@@ -1,9 +1,13 @@
 // test_DuneFembReader.cxx
+//
+// Test DuneFembReader with a synthetic file from FembDataGenerator.
 
 #include "DuneFembReader.h"
+#include "FembDataGenerator.h"
 #include "dune/DuneInterface/AdcChannelData.h"
 #include <string>
 #include <iostream>
+#include <algorithm>
 
 using std::string;
 using std::cout;
@@ -41,12 +45,27 @@ int test_DuneFembReader() {
   using Entry = DuneFembReader::Entry;
   using Waveform = DuneFembReader::Waveform;
 
-  string fname = "/home/dladams/data/dune/femb/test/fembTest_gainenc_test_g3_s3_extpulse/gainMeasurement_femb_1-parseBinaryFile.root";
+  string fname = "test_DuneFembReader.root";
+  FembDataGenerator::Config cfg;
+  cfg.nEvent = 5;
+  cfg.deadChannels.push_back(26);
+  FembDataGenerator gen(cfg);
+  FembDataGenerator::Dataset ds;
+  ds.gain = 3;
+  ds.shap = 3;
+  ds.extPulse = true;
+  if ( gen.writeFile(fname, ds) ) {
+    cout << myname << "Unable to write " << fname << endl;
+    return 1;
+  }
   DuneFembReader rdr(fname);
   std::vector<Index> subruns = {4,   4,   4};
   std::vector<Index> chans =  {25,  26,  25};
   std::vector<Index> ents =  {537, 538, 537};
   int nerr = 0;
+  nerr += check(rdr.nEvent(), cfg.nEvent, "nEvent");
+  nerr += check(rdr.nChannel(), cfg.nChannel, "nChannel");
+  nerr += check(rdr.nEntry(), Entry(cfg.nEvent*cfg.nChannel), "nEntry");
   Index ntst = subruns.size();
   const Waveform* pwf = nullptr;
   for ( Index itst=0; itst<ntst; ++itst ) {
@@ -70,6 +89,10 @@ int test_DuneFembReader() {
     nerr += check(rdr.channel(), chan, "after read chan");
     pwf = rdr.waveform();
     nerr += check(pwf->size(), nsam, "after read waveform");
+    // Channel 26 is dead and so has no signal.
+    unsigned short adcmin = *std::min_element(pwf->begin(), pwf->end());
+    unsigned short adcmax = *std::max_element(pwf->begin(), pwf->end());
+    nerr += check(adcmax == adcmin, chan == 26, "dead channel");
   }
   cout << myname << "Error count: " << nerr << endl;
   return nerr;
@@ -0,0 +1,115 @@
+// test_FembRoiFinder.cxx
+//
+// Check that the AVX2 and scalar versions of FembRoiFinder give the same
+// ROIs and summaries and that these agree with a simple reference.
+
+#include "FembRoiFinder.h"
+#include "dune/DuneInterface/AdcChannelData.h"
+#include "TRandom3.h"
+#include <string>
+#include <iostream>
+
+using std::string;
+using std::cout;
+using std::endl;
+
+//**********************************************************************
+
+namespace {
+
+template<typename T1, typename T2>
+int check(T1 t1, T2 t2, string msg ="") {
+  if ( t1 != t2 ) {
+    cout << "Failed";
+    if ( msg.size() ) cout << ": " << msg;
+    cout << ": " << t1 << " != " << t2;
+    cout << endl;
+    return 1;
+  }
+  if ( true ) {
+    cout << "Passed";
+    if ( msg.size() ) cout << ": " << msg;
+    cout << endl;
+  }
+  return 0;
+}
+
+// Reference threshold ROIs built from the signal flags.
+AdcRoiVector referenceRois(const AdcSignalVector& sams, float thr, unsigned int nbef, unsigned int naft) {
+  int nsam = sams.size();
+  std::vector<bool> keep(nsam, false);
+  for ( int isam=0; isam<nsam; ++isam ) {
+    if ( sams[isam] > thr || sams[isam] < -thr ) {
+      int isam1 = isam > int(nbef) ? isam - int(nbef) : 0;
+      int isam2 = isam + int(naft) < nsam ? isam + int(naft) : nsam - 1;
+      for ( int jsam=isam1; jsam<=isam2; ++jsam ) keep[jsam] = true;
+    }
+  }
+  AdcRoiVector rois;
+  for ( int isam=0; isam<nsam; ++isam ) {
+    if ( ! keep[isam] ) continue;
+    if ( isam == 0 || ! keep[isam-1] ) rois.emplace_back(isam, isam);
+    rois.back().second = isam;
+  }
+  return rois;
+}
+
+}  // end unnamed namespace
+
+//**********************************************************************
+
+int test_FembRoiFinder() {
+  const string myname = "test_FembRoiFinder: ";
+  using Index = FembRoiFinder::Index;
+  cout << myname << "AVX2 is " << (FembRoiFinder::haveAvx2() ? "" : "not ") << "available." << endl;
+  int nerr = 0;
+  TRandom3 rand(1234);
+  // Pulses every 497 ticks on a noisy baseline with some overflows.
+  Index nsam = 19499;
+  AdcChannelData acd;
+  acd.samples.resize(nsam);
+  acd.flags.resize(nsam, AdcGood);
+  for ( Index isam=0; isam<nsam; ++isam ) {
+    float sig = rand.Gaus(0.0, 10.0);
+    Index itmd = isam%497;
+    if ( itmd >= 100 && itmd < 110 ) sig += (isam/497)%2 ? 500.0 : -300.0;
+    acd.samples[isam] = sig;
+    if ( itmd == 105 && isam%7 == 0 ) acd.flags[isam] = AdcOverflow;
+  }
+  FembRoiFinder::Config cfg;
+  cfg.threshold = 120.0;
+  cfg.binsBefore = 7;
+  cfg.binsAfter = 10;
+  AdcRoiVector refRois = referenceRois(acd.samples, cfg.threshold, cfg.binsBefore, cfg.binsAfter);
+  // Threshold ROIs.
+  cfg.useSimd = false;
+  AdcChannelData acdScalar = acd;
+  DataMap resScalar = FembRoiFinder(cfg).update(acdScalar);
+  cfg.useSimd = true;
+  AdcChannelData acdSimd = acd;
+  DataMap resSimd = FembRoiFinder(cfg).update(acdSimd);
+  nerr += check(acdScalar.rois.size(), refRois.size(), "Scalar ROI count");
+  nerr += check(acdSimd.rois.size(), refRois.size(), "SIMD ROI count");
+  nerr += check(acdScalar.rois == refRois, true, "Scalar ROIs");
+  nerr += check(acdSimd.rois == refRois, true, "SIMD ROIs");
+  nerr += check(resSimd.getInt("roiCount"), int(refRois.size()), "Summary ROI count");
+  nerr += check(FembRoiFinder::compareSummary(resSimd, resScalar), 0u, "Threshold summaries");
+  // Regular ROIs.
+  cfg.mode = FembRoiFinder::RegularMode;
+  cfg.period = 497;
+  cfg.useSimd = false;
+  acdScalar = acd;
+  resScalar = FembRoiFinder(cfg).update(acdScalar);
+  cfg.useSimd = true;
+  acdSimd = acd;
+  resSimd = FembRoiFinder(cfg).update(acdSimd);
+  Index nroiExp = (nsam + cfg.period - 1)/cfg.period;
+  nerr += check(acdSimd.rois.size(), nroiExp, "Regular ROI count");
+  nerr += check(acdSimd.rois == acdScalar.rois, true, "Regular ROIs");
+  nerr += check(resSimd.getIntVector("roiNTicks").back(), int(nsam%cfg.period), "Short last ROI");
+  nerr += check(FembRoiFinder::compareSummary(resSimd, resScalar), 0u, "Regular summaries");
+  cout << myname << "Error count: " << nerr << endl;
+  return nerr;
+}
+
+//**********************************************************************